@@ -0,0 +1,330 @@
+/*
+ * engine_bench.cpp
+ *
+ * This file contains engine-bench, the micro-benchmarks of the tracing engine
+ * (libquadcore). Every benchmark feeds a synthetic stream of 8-byte accesses straight
+ * into the Engine, without Pin and without an application, and reports:
+ *
+ *	ns/access	the time per access (including the bytes of every access)
+ *	bindings	the producer/consumer bindings created
+ *	reads/s		the reads recorded in the bindings per second
+ *	shadow KB	the shadow memory at the end, which only grows (the peak)
+ *	binding KB	the memory of the bindings at the end (the peak)
+ *
+ * The state of the engine is global, so every benchmark runs in a child process
+ * which sends its results back through a pipe.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Platform.h"
+#include "Engine.h"
+
+using namespace std;
+
+Engine Quad_Engine;
+
+#define WORD_SIZE 8
+#define BASE_ADDRESS 0x10000000
+#define FIRST_FUNCTION 2		// 0 and 1 are the unknown function and the bottom of the stacks
+#define NUM_FUNCTIONS 64
+
+typedef struct
+{
+	ADDRINT addr;
+	ADDRINT func;
+	BOOL write;
+}
+BenchAccess;
+
+typedef struct
+{
+	double seconds;
+	UINT64 accesses;
+	EngineStatistics stats;
+}
+BenchResult;
+
+typedef VOID (*STREAM_FUNC)(vector<BenchAccess> &, UINT64);
+
+UINT64 Working_Set = 65536;	// words
+unsigned int Block_Size = 1;	// the granularity of the engine, bytes
+
+/* ===================================================================== */
+// the access streams, 'count' accesses each
+
+static unsigned int Seed = 12345;
+
+static unsigned int NextRandom()
+{
+	Seed = Seed * 1103515245 + 12345;
+	return (Seed >> 8) & 0xFFFFFF;
+}
+
+static VOID Add(vector<BenchAccess> &stream, ADDRINT word, ADDRINT func, BOOL write)
+{
+	BenchAccess access;
+
+	access.addr = BASE_ADDRESS + word * WORD_SIZE;
+	access.func = FIRST_FUNCTION + func;
+	access.write = write;
+	stream.push_back(access);
+}
+
+// a function writes the working set from start to end, the next one reads it, and so on
+VOID SequentialStream(vector<BenchAccess> &stream, UINT64 count)
+{
+	for (UINT64 i = 0; i < count; i++)
+	{
+		UINT64 pass = i / Working_Set;
+		Add(stream, i % Working_Set, pass % NUM_FUNCTIONS, pass % 2 == 0);
+	}
+}
+
+// like the sequential stream, but only one word of every 4 KB page
+VOID StridedStream(vector<BenchAccess> &stream, UINT64 count)
+{
+	for (UINT64 i = 0; i < count; i++)
+	{
+		UINT64 pass = i / Working_Set;
+		Add(stream, (i % Working_Set) * (4096 / WORD_SIZE), pass % NUM_FUNCTIONS, pass % 2 == 0);
+	}
+}
+
+// random words, by random functions, one write for every two reads
+VOID RandomStream(vector<BenchAccess> &stream, UINT64 count)
+{
+	for (UINT64 i = 0; i < count; i++)
+		Add(stream, NextRandom() % Working_Set, NextRandom() % NUM_FUNCTIONS, NextRandom() % 3 == 0);
+}
+
+// a linked list spread randomly over the working set, built by one function and walked by
+// the others, every word is visited once per walk
+VOID PointerChaseStream(vector<BenchAccess> &stream, UINT64 count)
+{
+	vector<UINT64> next(Working_Set);
+	UINT64 word = 0;
+
+	for (UINT64 w = 0; w < Working_Set; w++)
+		next[w] = w;
+	for (UINT64 w = Working_Set - 1; w > 0; w--)
+		swap(next[w], next[NextRandom() % w]);
+
+	for (UINT64 i = 0; i < count; i++)
+	{
+		UINT64 pass = i / Working_Set;
+		Add(stream, next[word], pass % NUM_FUNCTIONS, pass == 0);
+		word = next[word];
+	}
+}
+
+// one function writes a small block, all the others read it
+VOID BroadcastStream(vector<BenchAccess> &stream, UINT64 count)
+{
+	const UINT64 block = 256;
+	UINT64 i = 0;
+
+	while (i < count)
+	{
+		for (UINT64 w = 0; w < block && i < count; w++, i++)
+			Add(stream, w, 0, TRUE);
+		for (UINT64 c = 1; c < NUM_FUNCTIONS; c++)
+			for (UINT64 w = 0; w < block && i < count; w++, i++)
+				Add(stream, w, c, FALSE);
+	}
+}
+
+// two functions take turns writing a small buffer and reading what the other one wrote
+VOID PingPongStream(vector<BenchAccess> &stream, UINT64 count)
+{
+	const UINT64 buffer = 64;
+	UINT64 i = 0;
+
+	for (UINT64 turn = 0; i < count; turn++)
+	{
+		for (UINT64 w = 0; w < buffer && i < count; w++, i++)
+			Add(stream, w, turn % 2, FALSE);
+		for (UINT64 w = 0; w < buffer && i < count; w++, i++)
+			Add(stream, w, turn % 2, TRUE);
+	}
+}
+
+typedef struct
+{
+	const char *name;
+	STREAM_FUNC stream;
+}
+Benchmark;
+
+Benchmark Benchmarks[] = {
+	{ "sequential", SequentialStream },
+	{ "strided", StridedStream },
+	{ "random", RandomStream },
+	{ "pointer_chase", PointerChaseStream },
+	{ "broadcast", BroadcastStream },
+	{ "ping_pong", PingPongStream },
+	{ NULL, NULL }
+};
+
+/* ===================================================================== */
+
+static double Now()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// runs one benchmark in this process, non-zero on failure
+int RunBenchmark(const Benchmark &bench, UINT64 accesses, unsigned int shards, BenchResult &result)
+{
+	vector<BenchAccess> stream;
+	EngineOptions options;
+	double start;
+
+	stream.reserve(accesses);
+	bench.stream(stream, accesses);
+
+	Quad_Engine.defineFunction(0, "UNKNOWN");
+	Quad_Engine.defineFunction(1, "Out_of_the_main_function_scope");
+	for (unsigned int f = 0; f < NUM_FUNCTIONS; f++)
+	{
+		char name[32];
+		sprintf(name, "func%u", f);
+		Quad_Engine.defineFunction(FIRST_FUNCTION + f, name);
+	}
+
+	options.granularity = Block_Size;
+	Quad_Engine.setOptions(options);
+
+	// the profile is never written
+	if (Quad_Engine.start("/dev/null", bench.name, shards, 0))
+		return 1;
+
+	start = Now();
+	for (UINT64 i = 0; i < stream.size(); i++)
+		if (Quad_Engine.onAccess(stream[i].addr, WORD_SIZE, stream[i].func, NULL, stream[i].write))
+			return 1;
+	Quad_Engine.quiesce(PIN_ThreadId());
+	result.seconds = Now() - start;
+
+	result.accesses = stream.size();
+	Quad_Engine.statistics(result.stats);
+	Quad_Engine.stop();
+	return 0;
+}
+
+// runs one benchmark in a child process
+int ForkBenchmark(const Benchmark &bench, UINT64 accesses, unsigned int shards, BenchResult &result)
+{
+	int fds[2];
+	int status;
+	pid_t pid;
+
+	if (pipe(fds))
+		return 1;
+
+	pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0)
+	{
+		close(fds[0]);
+		if (RunBenchmark(bench, accesses, shards, result))
+			_exit(1);
+		if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	status = read(fds[0], &result, sizeof(result)) != sizeof(result);
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+	return status;
+}
+
+/* ===================================================================== */
+
+int usage()
+{
+	cerr << "Usage: engine-bench [options]" << endl
+		<< "Runs the micro-benchmarks of the QUAD tracing engine." << endl
+		<< "Options:" << endl
+		<< "  -filter <text>        only run the benchmarks of which the name contains <text>" << endl
+		<< "  -accesses <n>         the number of 8-byte accesses of every benchmark (default 1000000)" << endl
+		<< "  -working_set <n>      the number of words of the sequential, strided, random and pointer" << endl
+		<< "                        chasing streams (default 65536)" << endl
+		<< "  -shards <n>           number of analysis worker threads (default 0)" << endl
+		<< "  -granularity <n>      track the memory in blocks of <n> bytes (default 1)" << endl;
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	string filter;
+	UINT64 accesses = 1000000;
+	unsigned int shards = 0;
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+			return usage();
+		else if (!strcmp(argv[i], "-filter"))
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "-accesses"))
+			accesses = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-working_set"))
+			Working_Set = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-shards"))
+			shards = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-granularity"))
+			Block_Size = strtoul(argv[++i], NULL, 0);
+		else
+			return usage();
+	}
+
+	if (accesses == 0 || Working_Set < 2)
+		return usage();
+
+	cout << left << setw(16) << "benchmark" << right
+		<< setw(12) << "accesses" << setw(12) << "ns/access" << setw(12) << "bindings"
+		<< setw(14) << "reads/s" << setw(12) << "shadow KB" << setw(12) << "binding KB" << endl;
+
+	for (unsigned int b = 0; Benchmarks[b].name; b++)
+	{
+		BenchResult result;
+
+		if (string(Benchmarks[b].name).find(filter) == string::npos)
+			continue;
+
+		if (ForkBenchmark(Benchmarks[b], accesses, shards, result))
+		{
+			cerr << "The benchmark " << Benchmarks[b].name << " failed" << endl;
+			failed = 1;
+			continue;
+		}
+
+		cout << left << setw(16) << Benchmarks[b].name << right
+			<< setw(12) << result.accesses
+			<< setw(12) << fixed << setprecision(1) << result.seconds * 1e9 / result.accesses
+			<< setw(12) << result.stats.bindings
+			<< setw(14) << setprecision(0) << result.stats.communications / result.seconds
+			<< setw(12) << result.stats.shadowBytes / 1024
+			<< setw(12) << result.stats.bindingBytes / 1024 << endl;
+	}
+	return failed;
+}
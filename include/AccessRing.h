@@ -0,0 +1,115 @@
+/*
+ * AccessRing.h
+ *
+ * This file contains the AccessRing class. This class models the ring buffer in a
+ * shared memory file through which QUAD (the writer) hands the memory accesses of
+ * the application over to quad-analyzer (the reader), which runs in its own process.
+ *
+ * The ring consists of fixed size slots. A writer reserves slots by advancing 'head'
+ * atomically, fills them and then publishes every slot by setting its sequence
+ * number, so the threads of the application can write concurrently. The reader
+ * consumes the published slots in order and advances 'tail'. Names of functions and
+ * variables are sent once, with the characters in the slots following the record.
+ *
+ */
+
+#ifndef ACCESSRING_H_
+#define ACCESSRING_H_
+
+#include <string>
+#include "Platform.h"
+
+using namespace std;
+
+#define ACCESS_RING_MAGIC 0x44415551	// "QUAD"
+#define ACCESS_RING_VERSION 4
+#define ACCESS_RING_DEFAULT_SLOTS (1 << 20)
+
+// record types
+#define RING_READ 1		// 'size' bytes at 'addr' read by function 'func'
+#define RING_WRITE 2		// 'size' bytes at 'addr' written by function 'func'
+#define RING_FUNC_NAME 3	// the name of function 'addr', 'size' characters follow
+#define RING_VAR_NAME 4		// the name of variable 'addr', 'size' characters follow
+
+// results of AccessRing::read
+#define RING_RECORD 0
+#define RING_EMPTY 1
+#define RING_CLOSED 2		// the writer closed the ring or does not exist anymore
+
+typedef struct
+{
+	volatile UINT64 seq;	// 1 + the position of the slot when it is published
+	UINT32 type;
+	UINT32 size;
+	UINT64 addr;
+	UINT32 func;
+	UINT32 var;		// 0 if the variable is unknown
+}
+AccessRingSlot;
+
+#define RING_PAYLOAD_SIZE (sizeof(AccessRingSlot) - sizeof(UINT64))
+
+// the report options of the writer, so the analyzer writes the same reports as QUAD
+typedef struct
+{
+	UINT32 showBytes;
+	UINT32 showUnDVs;
+	UINT32 showRanges;
+	UINT32 rangesLimit;
+	UINT32 showVariables;
+	UINT32 variableCount;
+	UINT32 granularity;
+	UINT32 samplePages;
+	UINT32 sampleAccesses;
+	UINT32 unmaSketchBits;
+}
+AccessRingOptions;
+
+typedef struct
+{
+	UINT32 magic;
+	UINT32 version;
+	UINT64 slots;			// a power of two
+	volatile INT32 writerPid;	// 0 until a writer attached
+	volatile INT32 readerPid;
+	volatile UINT32 closed;		// set by the writer when the application finished
+	AccessRingOptions options;
+	char pad1[64];
+	volatile UINT64 head;		// the next slot to be reserved by a writer
+	char pad2[64];
+	volatile UINT64 tail;		// the next slot to be read
+	char pad3[64];
+}
+AccessRingHeader;
+
+class AccessRing
+{
+	private:
+		string m_path;
+		AccessRingHeader *m_header;
+		AccessRingSlot *m_slots;
+		size_t m_length;
+
+		AccessRing(const string &path, AccessRingHeader *header, size_t length);
+		bool reserve(UINT32 count, UINT64 *pos);
+
+	public:
+		~AccessRing();
+
+		// creates the ring file for the reader, NULL on failure
+		static AccessRing *create(const string &path, UINT64 slots);
+		// maps an existing ring file for a writer, NULL on failure
+		static AccessRing *attach(const string &path);
+
+		AccessRingHeader *header() { return m_header; }
+
+		// writer side, false if the reader does not exist anymore
+		bool writeAccess(ADDRINT addr, UINT32 size, UINT32 func, UINT32 var, bool write);
+		bool writeName(UINT32 type, UINT32 id, const string &name);
+		void close();
+
+		// reader side, returns RING_RECORD, RING_EMPTY or RING_CLOSED
+		int read(AccessRingSlot &record, string &name);
+};
+
+#endif /* ACCESSRING_H_ */
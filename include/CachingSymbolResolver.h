@@ -0,0 +1,69 @@
+/*****
+ *
+ * CachingSymbolResolver.h
+ *
+ * A SymbolResolver in front of another one, which remembers the variables resolved
+ * by every thread per instruction and address range. An instruction accessing the
+ * same variable again in the same frame (e.g. the elements of an array in a loop)
+ * gets the variable of the previous access without asking the resolver behind it.
+ *
+ * The memo of a thread is a direct-mapped table indexed by the instruction and the
+ * page of the address: a new access replaces the entry in its slot. An entry holds
+ * the range of addresses the resolver vouched for (the whole variable), and is only
+ * valid in a frame at the same depth of the call stack with the same signature. The
+ * signature of a frame combines the function and the stack pointer of every call
+ * on the stack, so the entries of a callee never match in its caller, and a function
+ * called again from the same place (in the same frame of the caller) hits the
+ * entries of its previous call.
+ *
+ *****/
+
+#ifndef CACHINGSYMBOLRESOLVER_H
+#define CACHINGSYMBOLRESOLVER_H
+
+#include "SymbolResolver.h"
+#include "ThreadTable.h"
+
+#include <vector>
+
+#define RESOLVER_CACHE_SLOTS	1024	// a power of two
+
+// the variable resolved by instruction 'ip' for the addresses [low, high), in the frame at 'depth' with 'signature'
+struct ResolvedAccess {
+     void*			ip;
+     void*			low;
+     void*			high;
+     unsigned int		depth;
+     unsigned long long		signature;
+     unsigned int		result;		// the result of resolveVariable
+     const VariableSymbol*	variable;
+};
+
+// the memo of a thread and the signatures of its frames, innermost last
+struct ResolverCache {
+     ResolvedAccess			slots[RESOLVER_CACHE_SLOTS];
+     std::vector<unsigned long long>	frames;
+};
+
+class CachingSymbolResolver : public SymbolResolver
+{
+private:
+     SymbolResolver			*resolver;
+     mutable ThreadTable<ResolverCache*>	caches;
+
+     ResolverCache*	getCache(const ExecutionContext &context, unsigned int *tid)					const;
+
+public:
+     // the resolver is not owned by the cache, it must outlive it
+     			CachingSymbolResolver(SymbolResolver *resolver);
+     virtual 		~CachingSymbolResolver();
+
+     virtual unsigned int enterFunction(const class ExecutionContext &context, void *addr);
+     virtual unsigned int leaveFunction(const class ExecutionContext &context, void *addr, void *ret_addr);
+     virtual unsigned int resolveFunction(const ExecutionContext& context, void *addr, const FunctionSymbol **function)			const;
+     virtual unsigned int resolveVariable(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable)	const;
+     virtual unsigned int resolveStaticVariable(void *ip, enum eRegister base, long displacement, size_t size, const VariableSymbol **variable)	const;
+     virtual size_t memoryUsage()																	const;
+};
+
+#endif // CACHINGSYMBOLRESOLVER_H
@@ -16,8 +16,7 @@
 #include <string>
 #include <vector>
 #include "Exception.h"
-
-#include <pin.H>
+#include "Platform.h"
 
 typedef struct
 {
@@ -37,9 +36,14 @@ private:
 		ULL Bytes;
 		ULL Values;
 		vector<Range> Ranges;
+		// the 95% confidence bounds of the estimates of a sampled profile, a high bound of 0 is unknown
+		bool Estimated;
+		ULL UnMALow, UnMAHigh;
+		ULL BytesLow, BytesHigh;
+		ULL ValuesLow, ValuesHigh;
 		
 public:
-	Channel(){;}
+	Channel():Estimated(false){;}
 	
 	Channel(string p, string c, vector<Range>& ranges, ULL unma, ULL bytes, ULL vals);
 	
@@ -53,6 +57,23 @@ public:
 	ULL getBytes(){return Bytes;}
 	void setValues(ULL values){Values = values;}
 	unsigned long int getValues() {return Values;}
+	void setBounds(ULL unmaLow, ULL unmaHigh, ULL bytesLow, ULL bytesHigh, ULL valuesLow, ULL valuesHigh)
+	{
+		Estimated = true;
+		UnMALow = unmaLow;
+		UnMAHigh = unmaHigh;
+		BytesLow = bytesLow;
+		BytesHigh = bytesHigh;
+		ValuesLow = valuesLow;
+		ValuesHigh = valuesHigh;
+	}
+	bool isEstimated() {return Estimated;}
+	ULL getUnMALow() {return UnMALow;}
+	ULL getUnMAHigh() {return UnMAHigh;}
+	ULL getBytesLow() {return BytesLow;}
+	ULL getBytesHigh() {return BytesHigh;}
+	ULL getValuesLow() {return ValuesLow;}
+	ULL getValuesHigh() {return ValuesHigh;}
 	
 	void setRanges(vector<Range>& ranges)
 	{
@@ -13,8 +13,11 @@
 #include <list>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "DwarfMachine.h"
+#include "SymbolCache.h"
 
 enum TypeType {
      TT_Base,
@@ -60,15 +63,35 @@ struct FunctionEntry {
      std::map<Dwarf_Off, struct VarEntry*>	variables;
 };
 
+// a compile unit: its types and global variables are indexed by accept, its functions only
+// by indexUnit, when an address in one of its ranges is first resolved
+struct UnitEntry {
+     Dwarf_Off						offset;		// of the CU DIE
+     Dwarf_Off						end;		// of the next CU header
+     std::vector<std::pair<Dwarf_Addr, Dwarf_Addr> >	ranges;		// the code [low, high), from .debug_aranges or the pcs of the CU
+     bool						indexed;
+     std::vector<struct FunctionEntry*>			functions;	// once indexed
+};
+
+// the top level DIEs of a CU visited by visitCU
+enum UnitPass {
+     UP_All,
+     UP_Globals,		// all but the functions
+     UP_Functions		// the functions only
+};
+
 class DwarfIndexer
 {
 private:
      std::map<Dwarf_Off, struct TypeEntry*>	types;
      std::map<Dwarf_Off, struct VarEntry*>	global_variables;
      std::map<Dwarf_Off, struct FunctionEntry*>	functions;
+     std::vector<UnitEntry*>			units;
      Dwarf_Addr					CU_lopc, CU_hipc;
      std::string				current_function_id;
      TypeEntry*					current_basetype;
+     enum UnitPass				unit_pass;
+     unsigned int				verbose;
 
      static Dwarf_Half		getDwarfTag(Dwarf_Die, Dwarf_Error);
      static std::string		getDwarfName(Dwarf_Die, Dwarf_Debug, Dwarf_Error);
@@ -84,11 +107,44 @@ private:
      void			fixIndirectVariableTypes();
      void			fixIndirectLocalVariableTypes(const struct FunctionEntry&);
      void			fixIndirectVariableType(struct VarEntry&);
+
+     static unsigned int	getAddressRanges(std::map<Dwarf_Off, std::vector<std::pair<Dwarf_Addr, Dwarf_Addr> > >&, Dwarf_Debug, Dwarf_Error);
+     unsigned int		visitUnitFunctions(UnitEntry&, Dwarf_Die, Dwarf_Debug, Dwarf_Error);
+     void			fixUnitTypes(const UnitEntry&);
+     void			dropUnit(const UnitEntry&);
+
+     static void		saveLocation(SymbolCacheWriter&, const DwarfScriptList&);
+     static void		saveVariable(SymbolCacheWriter&, const struct VarEntry&);
+     static void		loadLocation(SymbolCacheReader&, DwarfScriptList&);
+     static struct VarEntry*	loadVariable(SymbolCacheReader&, const std::string&);
+
+     static void		dumpLocation(const DwarfScriptList&, const char*);
+     void			dumpTypes()				const;
+     void			dumpGlobals()				const;
+     void			dumpFunction(const struct FunctionEntry&)	const;
 public:
-     DwarfIndexer();
+     // verbose 1 shows the warnings about the DWARF information and the number of units indexed,
+     // verbose 2 also every DIE visited and the entries indexed
+     DwarfIndexer(unsigned int verbose = 0);
      ~DwarfIndexer();
 
+     // indexes the types and global variables of all units, and the address ranges of the units,
+     // the functions only of the units without ranges
      unsigned int accept(Dwarf_Debug, Dwarf_Error);
+     // indexes the functions of the unit, if it is not indexed yet
+     unsigned int indexUnit(UnitEntry&, Dwarf_Debug, Dwarf_Error);
+     // parses the functions of a copy of the unit into this (partial) indexer, e.g. on another thread
+     // with its own Dwarf_Debug, without resolving their types
+     unsigned int parseUnit(UnitEntry&, Dwarf_Debug, Dwarf_Error);
+     // moves the functions of the unit parsed by 'partial' into this indexer and resolves their types,
+     // non-zero (and the parsed entries are deleted) if the unit is indexed already
+     unsigned int mergeUnit(UnitEntry&, DwarfIndexer &partial);
+     // writes the types, the global variables, the functions and the units to an index cache file,
+     // the units should all be indexed
+     void save(SymbolCacheWriter&)				const;
+     // reads an index written by save into this empty indexer, all units are indexed then. Non-zero if
+     // the file is damaged.
+     unsigned int load(SymbolCacheReader&);
      unsigned int accept(DwarfIndex&, Dwarf_Die, Dwarf_Debug, Dwarf_Error);
      unsigned int acceptChildren(DwarfIndex&, Dwarf_Die, Dwarf_Debug, Dwarf_Error);
      unsigned int visitCU(DwarfIndex&, Dwarf_Die, Dwarf_Debug, Dwarf_Error);
@@ -106,6 +162,13 @@ public:
      std::list<VarEntry>	getVariables()				const;
      static std::list<VarEntry>	getVariables(const FunctionEntry&);
      std::list<FunctionEntry>	getFunctions()				const;
+     // the functions and the global variables themselves, owned by the indexer (no copies)
+     const std::map<Dwarf_Off, struct FunctionEntry*>&	getFunctionTable()	const;
+     const std::map<Dwarf_Off, struct VarEntry*>&	getGlobalVariableTable()	const;
+     const std::vector<UnitEntry*>&			getUnitTable()		const;
+     // the address of a variable at a fixed location (a single DW_OP_addr at every pc),
+     // 0 on success, non-zero if its location depends on the context (e.g. TLS)
+     static unsigned int	getStaticAddress(const VarEntry&, Dwarf_Addr*);
 };
 
 #endif // DWARFINDEXER_H
@@ -12,8 +12,7 @@
 #include "dwarf.h"
 #include "ExecutionContext.h"
 #include <cstddef>
-#include <list>
-#include <stack>
+#include <vector>
 
 struct DwarfOperation {
 	unsigned char		opcode;
@@ -22,15 +21,34 @@ struct DwarfOperation {
 	unsigned long long	offset;
 };
 
-typedef std::list<DwarfOperation>		DwarfScript;
+typedef std::vector<DwarfOperation>		DwarfScript;
+
+// the common location expressions, recognized when they are indexed (DwarfMachine::compile)
+// so they are evaluated with at most one register read and an add instead of the machine
+enum eLocationKind {
+	LK_Interpreted,		// any other expression, run by the DwarfMachine
+	LK_Address,		// DW_OP_addr a: at address a
+	LK_Register,		// DW_OP_regN: in register N
+	LK_RegisterOffset,	// DW_OP_bregN k: at the value of register N + k
+	LK_FrameOffset		// DW_OP_fbreg k: at the frame base of the function + k
+};
+
+struct DwarfCompiledLocation {
+	enum eLocationKind	kind;
+	enum eRegister		reg;
+	unsigned long long	operand;	// a or k
+};
 
 struct DwarfLocationScript {
 	unsigned long long 	lowpc;
 	unsigned long long 	hipc;
 	DwarfScript		script;
+	DwarfCompiledLocation	compiled;
 };
 
-typedef std::list<DwarfLocationScript>		DwarfScriptList;
+typedef std::vector<DwarfLocationScript>	DwarfScriptList;
+
+#define DWARF_STACK_SIZE 64
 
 enum eMachineState
 {
@@ -72,8 +90,9 @@ private:
 	const DwarfScript		&script;
 	const struct FunctionEntry	*function;
 	enum eMachineState		state;
-	unsigned long long		instruction;
-	std::stack<StackValue>		stack;
+	unsigned long long		instruction;	// the index of the next operation in the script
+	StackValue			stack[DWARF_STACK_SIZE];
+	unsigned int			depth;
 
 	DwarfMachine(const class ExecutionContext&, const DwarfScript&, const struct FunctionEntry*);
 	~DwarfMachine();
@@ -104,7 +123,15 @@ private:
 	void op_deref();
 
 	void op_plus();
+
+	static unsigned int evaluate(const class ExecutionContext&, const DwarfLocationScript&, const struct FunctionEntry*, StackValue*);
 public:
+	// recognizes the common location expressions of 'location', once after reading them
+	static void compile(DwarfLocationScript &location);
+	// the entry of the location list valid at 'ip', 0 if there is none
+	static const DwarfLocationScript *findLocation(const DwarfScriptList&, void *ip);
+	// the frame base of the function, the value of the register if it is a register location
+	static unsigned int getFrameBase(const class ExecutionContext&, const struct FunctionEntry*, unsigned long*);
 	static unsigned int evaluateLocation(const class ExecutionContext&, const DwarfScriptList&, void**, enum eRegister*, const struct FunctionEntry*);
 	static unsigned int evaluateLocation(const class ExecutionContext&, const DwarfScriptList&, void**, enum eRegister*);
 	static unsigned int evaluate(const class ExecutionContext&, const DwarfScriptList&, const struct FunctionEntry*, StackValue*);
@@ -13,12 +13,51 @@
 #define DWARFSYMBOLRESOLVER_H
 
 #include "libdwarf.h"
+#include "Platform.h"
 #include "SymbolResolver.h"
+#include "ThreadTable.h"
 
 #include <map>
 #include <string>
-#include <stack>
 #include <list>
+#include <vector>
+
+// the addresses [low, high) of a function or a variable, the intervals of the resolver do not overlap
+template <class Entry>
+struct AddressInterval {
+     Dwarf_Addr		low;
+     Dwarf_Addr		high;
+     const Entry*	entry;
+};
+
+// the local variables with a location in the pcs [low, high) of a function
+struct RelevanceInterval {
+     Dwarf_Addr					low;
+     Dwarf_Addr					high;
+     std::vector<const struct VarEntry*>	variables;
+};
+
+// the local variables with a location at a pc of a function, pointing into the indexer
+struct RelevanceMap {
+     std::vector<const struct VarEntry*>	always;		// the variables with a location at every pc
+     std::vector<RelevanceInterval>		intervals;	// disjoint, sorted on low
+};
+
+// a function on the call stack of a thread, with the addresses of its local variables evaluated
+// when it called the next function (they are resolved live in the innermost function)
+struct LocalFrame {
+     const struct FunctionEntry*			function;
+     std::vector<AddressInterval<struct VarEntry> >	locals;		// disjoint, sorted on low
+};
+
+// the functions of a compile unit, filled in when an address of the unit is first resolved;
+// once 'ready' is set they do not change, so they are read without the lock
+struct ResolverUnit {
+     struct UnitEntry*					unit;
+     std::vector<AddressInterval<struct FunctionEntry> >	functions;	// sorted on low
+     std::map<const struct FunctionEntry*, RelevanceMap>	relevance;
+     volatile bool						ready;
+};
 
 class DwarfSymbolResolver : public SymbolResolver
 {
@@ -26,12 +65,24 @@ private:
      Dwarf_Debug					dwarf_handle;
      Dwarf_Error					dwarf_error;
      class DwarfIndexer*				indexer;
-     struct FunctionEntry*				current_function;
-     std::map<void*, std::stack<struct VarEntry> >	cache;
+     unsigned int					verbose;
+     mutable std::vector<ResolverUnit>			units;			// never resized after createUnitIntervals
+     std::vector<AddressInterval<ResolverUnit> >	unit_intervals;		// sorted on low
+     mutable PIN_LOCK					unit_lock;		// taken to index a unit
+     std::string					image;			// reopened by every index thread
+     unsigned int					index_thread_count;
+     volatile unsigned int				next_index_unit;	// the next unit for the index threads
+     volatile unsigned int				index_threads;		// the index threads still running
+     volatile bool					index_exit;
+     std::string					cache_path;		// the index cache file, "" without -symbol_cache
+     std::string					cache_key;
+     bool						cache_loaded;		// the index was read from cache_path
+     std::vector<AddressInterval<struct VarEntry> >	global_intervals;	// the globals at fixed addresses, sorted on low
+     std::list<const struct VarEntry*>			dynamic_globals;	// the globals evaluated on every access (e.g. TLS)
+     mutable ThreadTable<std::vector<LocalFrame> >	frames;			// the call stack of every thread
 
      mutable std::map<std::string, class FunctionSymbol*>	functionSymbols;
      mutable std::map<std::string, class VariableSymbol*>	variableSymbols;
-     std::map<std::string, std::map<unsigned long long, std::list<VarEntry> > >	relevance;
 
      DwarfSymbolResolver();
      ~DwarfSymbolResolver();
@@ -39,26 +90,49 @@ private:
      Dwarf_Debug*	getDwarfHandle();
      Dwarf_Error*	getDwarfError();
      void		createIndexer();
-     std::map<unsigned long long, std::list<VarEntry> >	createRelevanceMap(const struct FunctionEntry &);
-     void		createRelevanceMaps();
+     void		createUnitIntervals();
+     void		createGlobalIntervals();
+     void		createRelevanceMap(const struct FunctionEntry &, RelevanceMap &)	const;
+     void		createFunctionIntervals(ResolverUnit &)				const;
+     void		indexUnit(ResolverUnit &)					const;
 public:
-     static unsigned int createDwarfSymbolResolver(Elf *, DwarfSymbolResolver **);
+     // verbose is passed to the DwarfIndexer, with 2 the calls and returns are shown as well.
+     // With a cache_dir the index is read from the cache file of the binary in it, if there is one
+     static unsigned int createDwarfSymbolResolver(Elf *, DwarfSymbolResolver **, unsigned int verbose = 0, const char *cache_dir = 0);
      static unsigned int destroyDwarfSymbolResolver(DwarfSymbolResolver **);
 
 private:
      const class FunctionSymbol *toSymbol(const struct FunctionEntry &fe) const;
      const class VariableSymbol *toSymbol(const struct VarEntry &ve) const;
 
-     unsigned int findFunction(void *addr, struct FunctionEntry *fe)													const;
-     unsigned int findGlobalVariable(const class ExecutionContext &context, void *addr, size_t size, struct VarEntry *ve)						const; 
-     unsigned int findLocalVariable(const class ExecutionContext &context, void *addr, size_t size, const struct FunctionEntry &fe, struct VarEntry *ve)		const;
+     unsigned int findUnit(void *addr, const ResolverUnit **unit)													const;
+     unsigned int findFunction(void *addr, const struct FunctionEntry **fe)												const;
+     unsigned int findGlobalVariable(const class ExecutionContext &context, void *addr, size_t size, struct VarEntry *ve, void **low, void **high)			const; 
+     unsigned int findRelevantVariables(const struct FunctionEntry &fe, void *ip, const std::vector<const struct VarEntry*> **lists)					const;
+     unsigned int getFrameOffset(const struct FunctionEntry &fe, const struct VarEntry &ve, void *ip, enum eRegister *base, long long *offset)			const;
+     unsigned int findLocalVariable(const class ExecutionContext &context, void *addr, size_t size, const struct FunctionEntry &fe, struct VarEntry *ve, void **low, void **high) const;
+
+     std::vector<LocalFrame>& getFrames(const class ExecutionContext &context);
+     const std::vector<LocalFrame>& getFrames(const class ExecutionContext &context)											const;
 
-     void setCurrentFunction(const struct FunctionEntry &fe);
-     const struct FunctionEntry* getCurrentFunction()															const;
+     void storeLocalVariables(const class ExecutionContext &context, LocalFrame &frame);
 
-     void storeLocalVariables(const class ExecutionContext &context, const struct FunctionEntry &fe);
-     void removeLocalVariables(const struct FunctionEntry &fe);
+     static VOID	indexThread(VOID *arg);
+     void		runIndexThread();
 public:
+     // indexes the units in the background on 'threads' Pin internal threads, each with its own libelf and
+     // libdwarf handles of the image 'filename'. The threads start with the application, a unit resolved
+     // before they reach it is still indexed on demand.
+     unsigned int	startIndexThreads(const char *filename, unsigned int threads);
+     // stops the index threads after the unit they are indexing, e.g. before the process exits
+     void		stopIndexThreads();
+     // around a fork: the child must not inherit a unit half merged, and restarts the threads of the parent
+     void		quiesceIndexThreads();
+     void		resumeIndexThreads();
+     void		restartIndexThreads();
+     // writes the index to the cache file if it was not read from it, indexing the units not resolved yet
+     unsigned int	saveIndexCache();
+
      virtual unsigned int enterFunction(const class ExecutionContext &context, void *addr);
      virtual unsigned int leaveFunction(const class ExecutionContext &context, void *addr, void *ret_addr);
      // this method resolves a function from an address within the target,
@@ -71,6 +145,13 @@ public:
      // returns zero on success, non-zero on failure.
      // NOTE: if the context is modified while this method is executing, the result will be undefined.
      virtual unsigned int resolveVariable(const class ExecutionContext &context, void *addr, size_t size, const class VariableSymbol **variable)			const;
+     // the range of a variable is where it is in memory, in the frame of the access for a local
+     virtual unsigned int resolveVariableRange(const class ExecutionContext &context, void *addr, size_t size, const class VariableSymbol **variable, void **low, void **high) const;
+     // resolves the local variables of the function at ip at a fixed offset of the stack or frame pointer,
+     // there is no variable at the operand (1) only if another variable confirms that 'base' points in the frame
+     virtual unsigned int resolveStaticVariable(void *ip, enum eRegister base, long displacement, size_t size, const class VariableSymbol **variable)	const;
+     // a rough estimate of the memory used by the caches, the symbols and the relevance maps
+     virtual size_t memoryUsage()																		const;
 };
 
 #endif // DWARFSYMBOLRESOLVER_H
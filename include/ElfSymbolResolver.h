@@ -13,6 +13,7 @@
 #ifndef ELFSYMBOLRESOLVER_H
 #define ELFSYMBOLRESOLVER_H
 
+#include <string>
 #include <vector>
 using namespace std;
 
@@ -22,9 +23,11 @@ using namespace std;
 class ElfFunctionSymbol : public FunctionSymbol
 {
 private:
-     char 	symbol_name[128];
+     string	symbol_name;
      void	*symbol_address;
      size_t	symbol_size;
+
+     friend class ElfSymbolResolver;	// writes the full names to the symbol cache
 public:
 		ElfFunctionSymbol(const ElfFunctionSymbol&);
 		ElfFunctionSymbol(const char *name, void* addr, size_t size);
@@ -39,9 +42,11 @@ public:
 class ElfVariableSymbol : public VariableSymbol
 {
 private:
-     char 	symbol_name[128];
+     string	symbol_name;
      void	*symbol_address;
      size_t	symbol_size;
+
+     friend class ElfSymbolResolver;	// writes the full names to the symbol cache
 public:
 		ElfVariableSymbol(const ElfVariableSymbol&);
 		ElfVariableSymbol(const char *name, void* addr, size_t size);
@@ -56,7 +61,7 @@ public:
      virtual unsigned int getType(const Type **type)		const;
 };
 
-class ElfSymbolResolver
+class ElfSymbolResolver : public SymbolResolver
 {
 private:
      vector<ElfFunctionSymbol*> functions;
@@ -64,15 +69,23 @@ private:
 
      unsigned int addFunction(ElfFunctionSymbol *fs);
      unsigned int addVariable(ElfVariableSymbol *vs);
+     unsigned int loadCache(const string &path, const string &key);
+     unsigned int saveCache(const string &path, const string &key)	const;
 
     		 ElfSymbolResolver();
 public:
      virtual 	~ElfSymbolResolver();
 
-     static unsigned int createElfSymbolResolver(ElfSymbolResolver **resolver, const char *filename);
+     // with a cache_dir the symbols are read from the cache file of the binary in it, or written to it
+     static unsigned int createElfSymbolResolver(ElfSymbolResolver **resolver, const char *filename, const char *cache_dir = 0);
+
+     // the symbol table has no local variables, there are no frames to follow
+     virtual unsigned int enterFunction(const class ExecutionContext &context, void *addr);
+     virtual unsigned int leaveFunction(const class ExecutionContext &context, void *addr, void *ret_addr);
 
      virtual unsigned int resolveFunction(const ExecutionContext& context, void *addr, const FunctionSymbol **function)			const;
      virtual unsigned int resolveVariable(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable)	const;
+     virtual unsigned int resolveVariableRange(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable, void **low, void **high) const;
 };
 
 #endif // ELFSYMBOLRESOLVER_H
@@ -0,0 +1,140 @@
+/*
+ * Engine.h
+ *
+ * This file contains the Engine class, the interface of the QUAD tracing engine
+ * (libquadcore). The engine keeps the shadow memory and the bindings between the
+ * producers and the consumers of the data, and writes the QDU graph, the XML profile
+ * and the summary of the monitor list. The front-ends (the QUAD Pin tool, quad-analyzer
+ * and quad-replay) only feed it with the functions and the memory accesses of an
+ * application.
+ *
+ * The state of the engine is global, a process has only one Engine.
+ *
+ */
+
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include "Platform.h"
+
+using namespace std;
+
+class VariableSymbol;
+
+// what to show in the reports
+class EngineOptions
+{
+	public:
+		EngineOptions();
+
+		BOOL bbFuncCount;		// annotate the nodes with the number of calls
+		BOOL showBytes;			// print 'Bytes' on the edges
+		BOOL showUnDVs;			// print 'UnDVs' on the edges
+		BOOL showRanges;		// print the address ranges on the edges
+		int rangesLimit;		// the maximum number of ranges on an edge
+		BOOL showVariables;		// print the names of the exchanged variables on the edges
+		unsigned int variableCount;	// the maximum number of variables on an edge
+		unsigned int granularity;	// the size of the blocks tracked by the shadow memory, a power of two
+		unsigned int samplePages;	// only analyze 1 of every so many pages, the reports are scaled up
+		unsigned int sampleAccesses;	// only analyze 1 of every so many accesses (see Engine::samples)
+		unsigned int unmaSketchBits;	// estimate UnMA with HyperLogLog sketches of 2^bits registers, 0 is exact
+};
+
+// the memory used by the engine, the shadow memory is never freed so it only grows
+typedef struct
+{
+	UINT64 shadowBytes;	// the shadow memory with the last writer of every byte
+	UINT64 bindingBytes;	// the bindings between producers and consumers (without their sets of addresses)
+	UINT64 unmaBytes;	// the sets of unique addresses of the bindings
+	UINT64 bindings;	// the number of producer/consumer bindings (per shard, before they are merged)
+	UINT64 communications;	// the reads recorded in the bindings
+}
+EngineStatistics;
+
+// how far the analysis is degraded to stay within the memory limit
+enum EngineDegradation
+{
+	ENGINE_FULL,		// everything is analyzed
+	ENGINE_NO_UNMA_SETS,	// the unique addresses are not collected anymore, UnMA is a lower bound
+	ENGINE_STOPPED		// the accesses are not analyzed anymore, the reports are partial
+};
+
+class Engine
+{
+	public:
+		Engine();
+
+		// creates the XML profile and the worker threads ('shards' analysis workers,
+		// 'reportThreads' threads for the reports), non-zero on failure
+		int start(const string &xmlFile, const string &application, unsigned int shards, unsigned int reportThreads);
+		void setOptions(const EngineOptions &options);
+		const EngineOptions &options() const;
+
+		// the names of the functions (and basic blocks) used in the reports
+		void defineFunction(ADDRINT id, const string &name);
+		const string &functionName(ADDRINT id);
+		const map<ADDRINT, string> &functions() const;
+		// 'name' is a basic block of 'function'
+		void defineBasicBlock(const string &name, const string &function);
+		// a global variable of the application
+		void defineGlobalSymbol(const string &name, ADDRINT start, ADDRINT size);
+		// writes the summary of 'function' in the monitor list report
+		void monitor(const string &function);
+		// a line of text noted in the reports, e.g. how the profile was taken
+		void addNote(const string &note);
+
+		// the call stacks of the threads of the application, the bottom of every stack is 'func'
+		void setBottomFunction(ADDRINT func);
+		void onEnter(THREADID tid, ADDRINT func, BOOL counted);
+		void onExit(THREADID tid, UINT32 frames);
+		ADDRINT currentFunction(THREADID tid);
+		const vector<ADDRINT> &callStack(THREADID tid);
+
+		// the memory accesses, by the current function of thread 'tid' or by 'func'.
+		// non-zero is returned if the memory is exhausted.
+		int onWrite(THREADID tid, ADDRINT addr, UINT32 size, const VariableSymbol *symbol);
+		int onRead(THREADID tid, ADDRINT addr, UINT32 size, const VariableSymbol *symbol);
+		int onAccess(ADDRINT addr, UINT32 size, ADDRINT func, const VariableSymbol *symbol, BOOL write);
+		// whether an access of thread 'tid' is sampled, the front-ends skip the accesses which are not
+		// (before resolving their function and variable). With access sampling every call counts as an access.
+		BOOL samples(THREADID tid, ADDRINT addr, UINT32 size);
+		// the function which wrote 'addr' last, 0 if it was not written so far
+		ADDRINT lastWriter(ADDRINT addr);
+
+		// in the parent right before a fork, the workers finish the accesses of thread 'tid'
+		void quiesce(THREADID tid);
+		// in a followed child right after a fork, the child continues with the shadow memory of its
+		// parent and new workers, bindings and call counts. 'suffix' is inserted in the names of its reports.
+		void restart(const string &suffix, const string &xmlFile, const string &application);
+
+		// finishes the analysis and prepares the reports in parallel, this has to be done
+		// while the internal threads are still running (under Pin: before the Fini callbacks)
+		int prepareReport();
+		// writes QDUGraph.dot, the XML profile and the monitor list summary
+		int report();
+		// stops the worker threads without writing reports
+		void stop();
+
+		// the memory and the bindings of the engine so far, the accesses still queued
+		// for the workers are not included (see quiesce)
+		void statistics(EngineStatistics &stats);
+		// the memory of the engine, QUAD in total uses 'bytes' at most (0 is unlimited)
+		void setMemoryLimit(UINT64 bytes);
+		// compares the memory of the engine plus 'otherBytes' (e.g. the symbol tables of the
+		// front-end) with the limit: above it the unique addresses are not collected anymore,
+		// above 125% of it the analysis stops. Returns the current degradation. The engine
+		// also checks itself whenever a shard grew by 1 MB, with the last 'otherBytes'.
+		EngineDegradation checkMemory(UINT64 otherBytes);
+
+	private:
+		BOOL m_started;
+		EngineOptions m_options;
+		UINT64 m_memoryLimit;
+		UINT64 m_otherBytes;	// the last 'otherBytes' of checkMemory
+		EngineDegradation m_degradation;
+};
+
+#endif /* ENGINE_H_ */
@@ -73,6 +73,10 @@ public:
      // this method copies a block of 'size' bytes from 'buffer' to the target address 'addr'.
      // this method returns the number of successfully copied bytes.
      virtual unsigned int	setMemory(char *addr, size_t size, char *buffer)			= 0;
+
+     // this method retrieves the number of the thread executing in the context into *id.
+     // returns zero on success, non-zero on failure.
+     virtual unsigned int	getThreadId(unsigned int *id)					const	= 0;
 };
 
 #endif // EXECUTIONCONTEXT_H
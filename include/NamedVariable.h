@@ -0,0 +1,47 @@
+/*
+ * NamedVariable.h
+ *
+ * This file contains the variables of the application in the standalone utilities
+ * (quad-analyzer and quad-replay). The accesses they read only carry the number of
+ * their variable, the names are defined by separate records of the ring buffer or
+ * the trace, before the first access with the number.
+ *
+ */
+
+#ifndef NAMEDVARIABLE_H_
+#define NAMEDVARIABLE_H_
+
+#include <cstring>
+#include <string>
+
+#include "Platform.h"
+#include "Symbols.h"
+
+using namespace std;
+
+// a variable of the application, of which only the name is known
+class NamedVariable : public VariableSymbol {
+	private:
+		string name;
+	public:
+		NamedVariable(const string &n):name(n){}
+
+		VariableSymbol* clone() { return new NamedVariable(name); }
+		const VariableSymbol *clone() const { return new NamedVariable(name); }
+
+		unsigned int getName(char *buffer, size_t size) const
+		{
+			if (size == 0)
+				return 1;
+			strncpy(buffer, name.c_str(), size);
+			buffer[size-1] = 0;
+			return 0;
+		}
+};
+
+// gives the name 'name' to variable 'id', replacing its previous name
+VOID DefineVariable(UINT64 id, const string &name);
+// the variable 'id', NULL if it is unknown (0 is the unknown variable)
+const VariableSymbol *LookupVariable(UINT64 id);
+
+#endif
@@ -25,6 +25,7 @@ public:
      virtual 			~PinExecutionContext();
 
      static unsigned int	mapRegisterToPin(enum eRegister reg, REG *pin_reg);
+     static unsigned int	mapRegisterFromPin(REG pin_reg, enum eRegister *reg);
 
      virtual unsigned int	getRegisterValue(enum eRegister reg, unsigned long *value) 	const;
      virtual unsigned int	setRegisterValue(enum eRegister reg, unsigned long value);
@@ -32,6 +33,7 @@ public:
      virtual unsigned int	setInstructionPointer(void *value);
      virtual unsigned int	getMemory(const char *addr, size_t size, char *buffer)		const;
      virtual unsigned int	setMemory(char *addr, size_t size, char *buffer);
+     virtual unsigned int	getThreadId(unsigned int *id)					const;
 };
 
 #endif // PINEXECUTIONCONTEXT_H
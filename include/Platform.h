@@ -0,0 +1,123 @@
+/*
+ * Platform.h
+ *
+ * This file provides the few Pin types that are shared between the Pin tool and
+ * the standalone QUAD utilities (such as quad-merge). When QUAD_STANDALONE is
+ * defined, the Pin headers are not available and the types are defined here.
+ *
+ * The tracing engine also needs the locks and internal threads of Pin, in the
+ * standalone utilities (such as quad-analyzer) these are mapped on pthreads.
+ *
+ */
+
+#ifndef PLATFORM_H_
+#define PLATFORM_H_
+
+#ifdef QUAD_STANDALONE
+
+#include <cstddef>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+typedef unsigned long ADDRINT;
+typedef bool BOOL;
+#ifndef TRUE
+#define TRUE true
+#endif
+#ifndef FALSE
+#define FALSE false
+#endif
+
+#ifndef VOID
+typedef void VOID;
+#endif
+typedef int INT32;
+typedef unsigned int UINT32;
+typedef long long INT64;
+typedef unsigned long long UINT64;
+
+typedef UINT32 THREADID;
+typedef pthread_t PIN_THREAD_UID;
+typedef pthread_mutex_t PIN_LOCK;
+typedef VOID (*ROOT_THREAD_FUNC)(VOID *arg);
+
+#define INVALID_THREADID ((THREADID)-1)
+#define DEFAULT_THREAD_STACK_SIZE 0
+
+inline VOID PIN_InitLock(PIN_LOCK *lock)
+{
+	pthread_mutex_init(lock, NULL);
+}
+
+inline VOID PIN_GetLock(PIN_LOCK *lock, INT32)
+{
+	pthread_mutex_lock(lock);
+}
+
+inline VOID PIN_ReleaseLock(PIN_LOCK *lock)
+{
+	pthread_mutex_unlock(lock);
+}
+
+inline VOID PIN_Sleep(UINT32 milliseconds)
+{
+	usleep(milliseconds * 1000);
+}
+
+inline VOID PIN_Yield()
+{
+	sched_yield();
+}
+
+// a small number identifying the calling thread, assigned the first time a thread asks for it
+inline THREADID PIN_ThreadId()
+{
+	static volatile THREADID lastId = 0;
+	static __thread THREADID id = INVALID_THREADID;
+
+	if (id == INVALID_THREADID)
+		id = __sync_fetch_and_add(&lastId, 1);
+	return id;
+}
+
+typedef struct
+{
+	ROOT_THREAD_FUNC function;
+	VOID *arg;
+}
+StandaloneThreadStart;
+
+inline VOID *StandaloneThreadMain(VOID *start)
+{
+	StandaloneThreadStart s = *(StandaloneThreadStart *)start;
+
+	delete (StandaloneThreadStart *)start;
+	s.function(s.arg);
+	return NULL;
+}
+
+inline THREADID PIN_SpawnInternalThread(ROOT_THREAD_FUNC function, VOID *arg, size_t, PIN_THREAD_UID *uid)
+{
+	StandaloneThreadStart *start = new StandaloneThreadStart;
+	PIN_THREAD_UID thread;
+
+	start->function = function;
+	start->arg = arg;
+	if (pthread_create(&thread, NULL, StandaloneThreadMain, start) != 0)
+	{
+		delete start;
+		return INVALID_THREADID;
+	}
+	if (uid)
+		*uid = thread;
+	return 0;
+}
+
+#else
+
+#include <pin.H>
+
+#endif // QUAD_STANDALONE
+
+#endif /* PLATFORM_H_ */
@@ -11,6 +11,7 @@
 #ifndef Q2XMLFILE_H_
 #define Q2XMLFILE_H_
 
+#include <map>
 #include "Channel.h"
 #include "ticpp.h"
 class Q2XMLFile
@@ -22,6 +23,7 @@ class Q2XMLFile
 		ticpp::Document m_file;
 		ticpp::Iterator< ticpp::Element > m_appfinger;
 		ticpp::Element * m_qdufinger;
+		map<pair<string, string>, ticpp::Element*> m_channels; // the channel tags by producer and consumer
 		
 	public:
 		Q2XMLFile(const string&, const string&, const string&);
@@ -30,7 +32,17 @@ class Q2XMLFile
 		void reset();
 		Channel * getChannel(string prod, string cons) const;
 		void printAllChValues() const;
+		void getChannels(vector<Channel*>& channels) const;
 		void insertChannel(Channel * ch);
+		// notes the tracking granularity (in bytes) of the QDU graph, nothing for 1
+		void setGranularity(unsigned int bytes);
+		// notes that the QDU graph was sampled, 1 of every 'factor' pages or accesses ('mode'),
+		// nothing for a factor of 1
+		void setSampling(const string &mode, unsigned int factor);
+		// notes that UnMA was estimated with HyperLogLog sketches of 2^bits registers, nothing for 0
+		void setUnMASketch(unsigned int bits);
+		// replaces the notes of the QDU graph (q2:note elements)
+		void setNotes(const vector<string> &notes);
 };
 
 #endif /* Q2XMLFILE_H_ */
@@ -12,7 +12,7 @@
 #ifndef _RENWALFLAGS_H_
 #define _RENWALFLAGS_H_
 
-#include "pin.H"
+#include "Platform.h"
 
 //a location can be fresh or old
 enum MemFlagStatus {OLD, FRESH};
@@ -62,7 +62,7 @@ class FNodeList
 		}
 		
 		void SetFlags(void); //ReNew all the flags for this location
-		bool ClearFlag(ADDRINT cons); //Make the flags old for a certain consumer of this location
+		bool ClearFlag(ADDRINT cons, UINT64 &scanned); //Make the flags old for a certain consumer of this location
 		void PrintFlags(void); //print all flags (debugging)
 };
 #endif
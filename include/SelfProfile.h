@@ -0,0 +1,100 @@
+/*
+ * SelfProfile.h
+ *
+ * This file contains the self profile of QUAD: counters of the work done by the
+ * analysis routines of QUAD itself (the shadow memory, the bindings, the renewal
+ * flags, the symbol resolver, the call tracking and the reports), and optional
+ * cycle timers (rdtsc) around these stages. The counters are always compiled in,
+ * every thread and every shard worker counts in its own SelfProfile, so there is
+ * no sharing between threads. The timers are only read with '-self_profile_timers'.
+ *
+ * WriteSelfProfile sums the profiles of all threads in QUAD_self_profile.txt.
+ *
+ */
+
+#ifndef SELFPROFILE_H_
+#define SELFPROFILE_H_
+
+#include <string>
+#include "Platform.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+enum SelfCounter
+{
+	SP_ACCESSES,		// memory accesses instrumented
+	SP_SHADOW_BYTES,	// bytes recorded in the shadow memory
+	SP_TRIE_NODES,		// shadow trie nodes allocated
+	SP_SHADOW_LEAVES,	// shadow leaves allocated
+	SP_BINDING_LOOKUPS,	// bindings looked up for a read
+	SP_BINDINGS,		// bindings created
+	SP_CLEARFLAG_CALLS,	// calls of FNodeList::ClearFlag
+	SP_CLEARFLAG_SCANNED,	// flags scanned by FNodeList::ClearFlag
+	SP_RESOLVER_CALLS,	// accesses looked up in the symbol resolver
+	SP_RESOLVER_HITS,	// accesses of which the variable was found
+	SP_RESOLVER_CACHE_HITS,	// accesses answered by the memo of the resolver
+	SP_CALLS,		// routine entries tracked
+	SP_FRAMES_POPPED,	// frames left by returns, tail calls and unwinding
+	SP_REPORT_ITEMS,	// bindings written in the reports
+	SP_NUM_COUNTERS
+};
+
+enum SelfTimer
+{
+	ST_SHADOW,		// the shadow memory, including the bindings
+	ST_BINDINGS,		// the bindings
+	ST_RESOLVER,		// the symbol resolver
+	ST_CALLS,		// the call tracking
+	ST_REPORT,		// preparing and writing the reports
+	ST_NUM_TIMERS
+};
+
+typedef struct
+{
+	UINT64 counters[SP_NUM_COUNTERS];
+	UINT64 cycles[ST_NUM_TIMERS];
+}
+SelfProfile;
+
+extern BOOL Self_Profile_Timers;
+
+// the profile of thread 'tid', created on first use
+SelfProfile *GetThreadProfile(THREADID tid);
+// the profile of the worker of shard 'shard', created on first use
+SelfProfile *GetShardProfile(unsigned int shard);
+
+// clears the profiles of all threads, e.g. in a forked child
+VOID ResetSelfProfile();
+// writes the sum of the profiles of all threads in QUAD_self_profile.txt, 'when' tells
+// at which point of the execution the profile was taken. Non-zero on failure.
+int WriteSelfProfile(const string &when);
+
+inline UINT64 SelfProfileClock()
+{
+#if defined(_MSC_VER)
+	return __rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+	UINT32 lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((UINT64)hi << 32) | lo;
+#else
+	return 0;
+#endif
+}
+
+inline UINT64 SelfTimerStart()
+{
+	return Self_Profile_Timers ? SelfProfileClock() : 0;
+}
+
+inline VOID SelfTimerStop(SelfProfile *profile, SelfTimer timer, UINT64 start)
+{
+	if (Self_Profile_Timers)
+		profile->cycles[timer] += SelfProfileClock() - start;
+}
+
+#endif /* SELFPROFILE_H_ */
@@ -0,0 +1,75 @@
+/*****
+ *
+ * SymbolCache.h
+ *
+ * The files in which the symbol resolvers keep their indexes between runs ('-symbol_cache <dir>').
+ * A file is named after the key of the binary, its GNU build-id or else a hash of its contents,
+ * so a binary that changes gets a new file and is indexed again.
+ *
+ * A file starts with SYMBOL_CACHE_MAGIC and the key, followed by the names used in the index,
+ * each stored once, and the records of the resolver. Like in the trace files, all numbers are
+ * variable length integers (7 bits per byte, least significant first). The file is mapped and
+ * decoded in one pass when the resolver is created.
+ *
+ *****/
+
+#ifndef SYMBOLCACHE_H
+#define SYMBOLCACHE_H
+
+#include <libelf.h>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#define SYMBOL_CACHE_MAGIC "QUADSYM1"
+#define SYMBOL_CACHE_MAGIC_SIZE 8
+
+// the key of the binary: its build-id, or a hash of the file if it has none ("" if neither can be read)
+std::string	getSymbolCacheKey(Elf *elf);
+// the cache file of the index 'kind' (e.g. "dwarf") of the binary with 'key' in 'dir'
+std::string	getSymbolCachePath(const std::string &dir, const std::string &key, const char *kind);
+
+class SymbolCacheWriter
+{
+private:
+     std::string					path;
+     std::string					key;
+     std::string					records;
+     std::map<std::string, unsigned long long>		name_ids;
+     std::vector<const std::string*>			names;		// in the order of their ids
+
+     static void	encode(std::string &out, unsigned long long value);
+public:
+     SymbolCacheWriter(const std::string &path, const std::string &key);
+
+     void		putNumber(unsigned long long value);
+     void		putName(const std::string &name);
+     // writes the file, through a temporary file so other runs never read half of it. Non-zero on failure.
+     unsigned int	close();
+};
+
+class SymbolCacheReader
+{
+private:
+     void*				mapping;
+     size_t				size;
+     const unsigned char*		pos;
+     const unsigned char*		end;
+     std::vector<std::string>		names;
+     bool				failed;
+     std::string			empty;
+
+public:
+     SymbolCacheReader();
+     ~SymbolCacheReader();
+
+     // maps the file and reads its names, non-zero if there is no file or it is not for 'key'
+     unsigned int		open(const std::string &path, const std::string &key);
+     unsigned long long		getNumber();
+     const std::string&		getName();
+     // false once a read went past the end of the file or named an unknown name
+     bool			ok()				const;
+};
+
+#endif // SYMBOLCACHE_H
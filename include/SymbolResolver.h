@@ -30,6 +30,25 @@ public:
      // returns zero on success, non-zero on failure.
      // NOTE: if the context is modified while this method is executing, the result will be undefined.
      virtual unsigned int resolveVariable(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable)	const	= 0;
+     // like resolveVariable, and stores in [*low, *high) the addresses at which the variable (or the lack of
+     // one) is the same for this instruction in this frame, e.g. for a cache of the results. The default
+     // only vouches for the accessed bytes.
+     virtual unsigned int resolveVariableRange(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable, void **low, void **high) const
+     {
+          *low = addr;
+          *high = (char*) addr + size;
+          return resolveVariable(context, addr, size, variable);
+     }
+     // this method resolves the variable accessed by a memory operand [base + displacement] of 'size' bytes of the
+     // instruction at 'ip' when the instruction is instrumented, for operands that access the same variable
+     // whenever the instruction executes (e.g. a local variable at a fixed offset of the frame pointer).
+     // On success, a pointer to the variable will be stored in *variable.
+     // returns zero on success, one if there is no variable at the operand, and larger values if the variable
+     // can only be resolved when the instruction executes. The default resolves nothing statically.
+     virtual unsigned int resolveStaticVariable(void *ip, enum eRegister base, long displacement, size_t size, const VariableSymbol **variable)	const	{ return 2; }
+     // this method estimates the memory in bytes used by the tables and caches of the resolver,
+     // e.g. to keep QUAD within its memory limit. The default is 0 (unknown).
+     virtual size_t memoryUsage()																	const	{ return 0; }
 };
 
 #endif // SYMBOLRESOLVER_H
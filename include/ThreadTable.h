@@ -0,0 +1,92 @@
+/*
+ * ThreadTable.h
+ *
+ * This file contains the ThreadTable class, a table with one slot per thread id which
+ * grows on demand. The slots are allocated in blocks of THREAD_TABLE_BLOCK when a
+ * thread id of the block is first used, a block never moves afterwards, so a thread
+ * keeps the reference to its slot while the other threads add blocks. The slots of a
+ * new block are value-initialized (0 for numbers and pointers).
+ *
+ * The table covers THREAD_TABLE_BLOCK * THREAD_TABLE_BLOCKS thread ids, QUAD stops
+ * with an error for a thread id beyond them instead of sharing a slot between threads.
+ *
+ */
+
+#ifndef THREADTABLE_H_
+#define THREADTABLE_H_
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define THREAD_TABLE_BLOCK 256
+#define THREAD_TABLE_BLOCKS 256
+
+template <class T>
+class ThreadTable
+{
+	private:
+		T * volatile Blocks[THREAD_TABLE_BLOCKS];
+		volatile unsigned int Used;	// the blocks from 'Used' on are not allocated
+
+		ThreadTable(const ThreadTable &);
+		ThreadTable &operator=(const ThreadTable &);
+
+	public:
+		ThreadTable()
+		{
+			memset((void*) Blocks, 0, sizeof(Blocks));
+			Used = 0;
+		}
+
+		~ThreadTable()
+		{
+			for (unsigned int b = 0; b < THREAD_TABLE_BLOCKS; b++)
+				delete[] Blocks[b];
+		}
+
+		// the slot of thread 'tid', its block is allocated on first use
+		T &operator[](unsigned int tid)
+		{
+			unsigned int b = tid / THREAD_TABLE_BLOCK;
+			T *block;
+
+			if (b >= THREAD_TABLE_BLOCKS)
+			{
+				std::cerr << "QUAD: thread id " << tid << " is beyond the " << limit() << " threads supported" << std::endl;
+				abort();
+			}
+			if (!Blocks[b])
+			{
+				// two threads of the block may race for it, the loser frees its copy
+				block = new T[THREAD_TABLE_BLOCK]();
+				if (!__sync_bool_compare_and_swap(&Blocks[b], (T*) 0, block))
+					delete[] block;
+				for (unsigned int used = Used; used <= b; used = Used)
+					__sync_bool_compare_and_swap(&Used, used, b + 1);
+			}
+			return Blocks[b][tid % THREAD_TABLE_BLOCK];
+		}
+
+		// the slot of thread 'tid' if its block is allocated, NULL otherwise
+		T *find(unsigned int tid) const
+		{
+			unsigned int b = tid / THREAD_TABLE_BLOCK;
+
+			if (b >= THREAD_TABLE_BLOCKS || !Blocks[b])
+				return NULL;
+			return &Blocks[b][tid % THREAD_TABLE_BLOCK];
+		}
+
+		// the thread ids below size() may have a slot, the ones above have none
+		unsigned int size() const
+		{
+			return Used * THREAD_TABLE_BLOCK;
+		}
+
+		static unsigned int limit()
+		{
+			return THREAD_TABLE_BLOCK * THREAD_TABLE_BLOCKS;
+		}
+};
+#endif
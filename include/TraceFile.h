@@ -0,0 +1,110 @@
+/*
+ * TraceFile.h
+ *
+ * This file contains the TraceWriter and TraceReader classes. QUAD started with
+ * '-record_trace <file>' only writes the memory accesses and the function calls of
+ * the application to a trace file, which quad-replay analyzes afterwards.
+ *
+ * A trace file starts with TRACE_MAGIC, followed by records of one tag byte and
+ * a number of variable length integers (7 bits per byte, least significant first):
+ *
+ *	TRACE_FUNC_NAME <id> <length> <characters>	name of function <id>
+ *	TRACE_VAR_NAME <id> <length> <characters>	name of variable <id>
+ *	TRACE_THREAD <tid>				the next records belong to thread <tid>
+ *	TRACE_ENTER[_COUNTED] <id>			function <id> is entered (and counted as a call)
+ *	TRACE_EXIT <frames>				<frames> functions are left
+ *	TRACE_ACCESS|flags <delta> <size> [<func>] [<var>]
+ *
+ * The address of an access is stored as the (zigzag encoded) difference with the
+ * previous access. An access belongs to the function on top of the call stack of
+ * its thread, unless TRACE_EXPLICIT_FUNC is set (e.g. for basic blocks).
+ *
+ */
+
+#ifndef TRACEFILE_H_
+#define TRACEFILE_H_
+
+#include <cstdio>
+#include <string>
+#include "Platform.h"
+
+using namespace std;
+
+#define TRACE_MAGIC "QUADTRC1"
+#define TRACE_MAGIC_SIZE 8
+
+#define TRACE_FUNC_NAME 1
+#define TRACE_VAR_NAME 2
+#define TRACE_THREAD 3
+#define TRACE_ENTER 4
+#define TRACE_ENTER_COUNTED 5
+#define TRACE_EXIT 6
+#define TRACE_ACCESS 0x10
+#define TRACE_WRITE 0x01		// flags of TRACE_ACCESS
+#define TRACE_EXPLICIT_FUNC 0x02
+#define TRACE_HAS_VAR 0x04
+
+typedef struct
+{
+	UINT32 tag;
+	UINT32 tid;		// the thread of the record
+	UINT64 id;		// function or variable number, the number of frames of TRACE_EXIT
+	ADDRINT addr;
+	UINT32 size;
+	UINT64 func;		// only with TRACE_EXPLICIT_FUNC
+	UINT64 var;		// 0 without TRACE_HAS_VAR
+	string name;
+}
+TraceRecord;
+
+class TraceWriter
+{
+	private:
+		FILE *m_file;
+		PIN_LOCK m_lock;
+		THREADID m_tid;		// the thread of the last record
+		ADDRINT m_addr;		// the address of the last access
+		unsigned char m_record[64];
+
+		TraceWriter(FILE *file);
+		void putRecord(unsigned char *end);
+		void selectThread(THREADID tid, unsigned char *&p);
+
+	public:
+		~TraceWriter();
+
+		// creates the trace file, NULL on failure
+		static TraceWriter *open(const string &path);
+
+		void writeName(UINT32 tag, UINT64 id, const string &name);
+		void enter(THREADID tid, UINT64 id, bool counted);
+		void exit(THREADID tid, UINT32 frames);
+		void access(THREADID tid, ADDRINT addr, UINT32 size, UINT64 func, UINT64 var, bool write, bool explicitFunc);
+
+		void flush();
+		void close();
+		// forgets the trace without writing the buffered records (in a forked child)
+		void abandon();
+};
+
+class TraceReader
+{
+	private:
+		FILE *m_file;
+		UINT32 m_tid;
+		ADDRINT m_addr;
+
+		TraceReader(FILE *file);
+		bool getNumber(UINT64 *value);
+
+	public:
+		~TraceReader();
+
+		// opens a trace file, NULL if it can not be read or is not a trace
+		static TraceReader *open(const string &path);
+
+		// returns 1 if a record was read, 0 at the end of the trace and -1 if the trace is corrupt
+		int next(TraceRecord &record);
+};
+
+#endif /* TRACEFILE_H_ */
@@ -12,5 +12,22 @@
 
 unsigned long int str2no(std::string Text);
 std::string no2str(unsigned long no);
+std::string suffixFileName(const std::string& name, const std::string& suffix);
+unsigned long residentKB();
+double wallSeconds();
+
+// the hash of the page (of 4 KB) of an address, the page samplers of the engine ('-sample_pages')
+// and of the overhead controller ('-overhead_sample') select the pages on it, so their samples nest
+inline unsigned int pageHash(unsigned long addr)
+{
+	unsigned int h = (unsigned int)(addr >> 12);
+
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
 
 #endif
\ No newline at end of file
@@ -53,7 +53,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 //==============================================================================
 /* tracing.h: 
- * The prototypes of tracing routines, used by QUAD tool
+ * The prototypes of tracing routines, used by the Engine class (libquadcore)
  *
  *  Authors: Arash Ostadzadeh
  *           Roel Meeuws
@@ -63,17 +63,89 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef __TRACING__H__
 #define __TRACING__H__
 
-#include <pin.H>
+#include "Platform.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
 #include <map>
+#include <string>
+#include <vector>
+
+#include "Q2XMLFile.h"
 
 #ifndef NULL
 #define NULL 0L
 #endif
 
+class GlobalSymbol {
+	public:
+		GlobalSymbol():start(0),size(0){};
+		GlobalSymbol(ADDRINT st, ADDRINT sz):start(st),size(sz){};
+		ADDRINT start;
+		ADDRINT size;
+};
+
+typedef struct 
+{
+	UINT64 total_IN_ML;  // total bytes consumed by this function, produced by a function in the monitor list
+	UINT64 total_OUT_ML; // total bytes produced by this function, consumed by a function in the monitor list
+	UINT64 total_IN_ML_UMA; // total UMA used by this function, produced by a function in the monitor list
+	UINT64 total_OUT_ML_UMA; // total UMA used by this function, consumed by a function in the monitor list
+	UINT64 total_IN_ALL; // total bytes consumed by this function, produced by any function in the application
+	UINT64 total_OUT_ALL; // total bytes produced by this function, consumed by any function in the application
+	UINT64 total_IN_ALL_UMA; // total UMA used by this function, produced by any function in the application
+	UINT64 total_OUT_ALL_UMA; // total UMA used by this function, consumed by any function in the application
+	vector<string> consumers;
+	vector<string> producers;
+}
+TTL_ML_Data_Pack ;
+
+// the state of the tracing engine, set through the Engine interface (see Engine.h)
+extern Q2XMLFile *q2xml;
+extern map <ADDRINT,string> ADDtoName;
+extern map <string, GlobalSymbol*> globalSymbols;
+extern map <string, string> NameToFunction;
+extern map <string, int> FunctionToCount;
+extern map <string,TTL_ML_Data_Pack *> ML_OUTPUT;
+extern BOOL Monitor_ON;
+extern string Output_Suffix;
+
+// report options (EngineOptions)
+extern BOOL BB_Func_Count;
+extern BOOL Dot_Show_Bytes;
+extern BOOL Dot_Show_UnDVs;
+extern BOOL Dot_Show_Ranges;
+extern int Dot_Show_Ranges_Limit;
+extern BOOL Show_Variables;
+extern unsigned int Variable_Count;
+extern unsigned int Granularity;
+extern unsigned int Granularity_Shift;
+extern unsigned int Sample_Pages;
+extern unsigned int Sample_Accesses;
+extern unsigned int UnMA_Sketch_Bits;
+extern vector<string> Report_Notes;
+
+// the degradation of the analysis above the memory limit
+extern BOOL Unique_Cells_Dropped;
+extern BOOL Analysis_Stopped;
+// a shard grew by MEMORY_CHECK_BYTES since the memory was last compared with the limit
+extern volatile BOOL Memory_Check_Due;
+
 int CreateDSGraphFile();
-int RecordMemoryAccess(VOID *, long int,long int,long int);
+int CreateTotalStatFile();
+int RecordMemoryAccess(ADDRINT, UINT32, ADDRINT, const class VariableSymbol *, bool);
+ADDRINT LookupLastWrite(ADDRINT);
+void ResetBindings();
+
+int InitShards(unsigned int);
+VOID QuiesceShards(THREADID);
+VOID RestartShardWorkers();
+VOID StopShards();
+int MergeShards();
+VOID ShardStatistics(UINT64 *, UINT64 *, UINT64 *, UINT64 *, UINT64 *);
+
+int InitReportThreads(unsigned int);
+VOID StopReportThreads();
+int PrepareReport();
 
 #endif //__TRACING__H__
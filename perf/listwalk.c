@@ -0,0 +1,97 @@
+/*
+ * listwalk.c
+ *
+ * perfcheck program: builds a linked list of which the nodes are shuffled over
+ * the heap, then walks and updates it a number of times.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NODES 4096
+#define WALKS 8
+
+struct node
+{
+	struct node *next;
+	int value;
+	int visits;
+};
+
+static struct node *pool[NODES];
+static unsigned int seed = 12345;
+
+static unsigned int next_random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) & 0xFFFFFF;
+}
+
+struct node *build_list(void)
+{
+	int i;
+
+	for (i = 0; i < NODES; i++)
+	{
+		pool[i] = malloc(sizeof(struct node));
+		pool[i]->value = i;
+		pool[i]->visits = 0;
+	}
+	/* link the nodes in a random order */
+	for (i = NODES - 1; i > 0; i--)
+	{
+		int j = next_random() % (i + 1);
+		struct node *tmp = pool[i];
+		pool[i] = pool[j];
+		pool[j] = tmp;
+	}
+	for (i = 0; i < NODES - 1; i++)
+		pool[i]->next = pool[i + 1];
+	pool[NODES - 1]->next = NULL;
+	return pool[0];
+}
+
+long walk_list(struct node *head)
+{
+	long sum = 0;
+
+	for (; head; head = head->next)
+		sum += head->value;
+	return sum;
+}
+
+void update_list(struct node *head)
+{
+	for (; head; head = head->next)
+	{
+		head->visits++;
+		head->value = (head->value * 3 + head->visits) % 10007;
+	}
+}
+
+void free_list(struct node *head)
+{
+	while (head)
+	{
+		struct node *next = head->next;
+		free(head);
+		head = next;
+	}
+}
+
+int main(void)
+{
+	struct node *head = build_list();
+	long sum = 0;
+	int w;
+
+	for (w = 0; w < WALKS; w++)
+	{
+		sum += walk_list(head);
+		update_list(head);
+	}
+	free_list(head);
+	printf("listwalk %ld\n", sum);
+	return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * matmul.c
+ *
+ * perfcheck program: multiplies two dense matrices, the result is checked
+ * by a separate function, so the matrices flow from init_matrix through
+ * multiply to checksum.
+ *
+ */
+
+#include <stdio.h>
+
+#define N 48
+
+static double A[N][N], B[N][N], C[N][N];
+
+void init_matrix(double m[N][N], int seed)
+{
+	int i, j;
+
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++)
+			m[i][j] = (double)((i * 31 + j * 17 + seed) % 13) - 6.0;
+}
+
+void multiply(double a[N][N], double b[N][N], double c[N][N])
+{
+	int i, j, k;
+
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++)
+		{
+			double sum = 0.0;
+			for (k = 0; k < N; k++)
+				sum += a[i][k] * b[k][j];
+			c[i][j] = sum;
+		}
+}
+
+double checksum(double m[N][N])
+{
+	double sum = 0.0;
+	int i, j;
+
+	for (i = 0; i < N; i++)
+		for (j = 0; j < N; j++)
+			sum += m[i][j] * (i + 1);
+	return sum;
+}
+
+int main(void)
+{
+	init_matrix(A, 1);
+	init_matrix(B, 7);
+	multiply(A, B, C);
+	printf("matmul %.1f\n", checksum(C));
+	return 0;
+}
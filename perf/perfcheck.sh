@@ -0,0 +1,199 @@
+#!/bin/bash
+#
+# perfcheck.sh
+#
+# Runs the programs of the performance corpus (perf/*.c) through QUAD and compares
+# the channels of their profiles with the golden ones in perf/golden. The time and
+# the memory of every run are reported relative to the baseline in perf/baseline.txt.
+#
+#   perfcheck.sh check    compare with the golden channels (make perfcheck), skipped
+#                         until golden channels were blessed and committed
+#   perfcheck.sh bless    record new golden channels, traces and baseline (make perfbless)
+#
+# Without Pin (or without the QUAD tool), 'check' replays the traces in perf/traces
+# (recorded by 'bless') with quad-replay instead. The variables PIN, QUADTOOL, OBJDIR
+# and CC are set by the makefile.
+#
+
+PERFDIR=`cd \`dirname $0\` && pwd`
+OBJDIR=${OBJDIR:-obj-ia32/}
+CC=${CC:-gcc}
+mode=$1
+
+if [ "$mode" != "check" ] && [ "$mode" != "bless" ]; then
+    echo "Usage: $0 check|bless" >&2
+    exit 1
+fi
+
+# the golden channels are recorded with Pin, until they are committed there is nothing to check
+if [ "$mode" = "check" ] && ! ls $PERFDIR/golden/*.channels > /dev/null 2>&1; then
+    echo "perfcheck skipped: there are no golden channels in $PERFDIR/golden yet."
+    echo "Run 'make perfbless' on a host with Pin and commit perf/golden, perf/traces and perf/baseline.txt."
+    exit 0
+fi
+
+mkdir -p $OBJDIR/perf || exit 1
+WORKDIR=`cd $OBJDIR/perf && pwd`
+REPLAY=`cd $OBJDIR && pwd`/quad-replay
+BASELINE=$PERFDIR/baseline.txt
+
+if [ -n "$PIN" ] && [ -x "$PIN" ] && [ -f "$QUADTOOL" ]; then
+    QUADTOOL=`cd \`dirname $QUADTOOL\` && pwd`/`basename $QUADTOOL`
+    runner=pin
+elif [ "$mode" = "bless" ]; then
+    echo "perfbless needs Pin and the QUAD tool (PIN=$PIN QUADTOOL=$QUADTOOL)" >&2
+    exit 1
+elif [ -x "$REPLAY" ]; then
+    runner=replay
+else
+    echo "Neither Pin nor $REPLAY is available" >&2
+    exit 1
+fi
+
+# measure <file> <command...>: runs the command and writes '<seconds> <peak KB>' to <file>
+measure()
+{
+    local out=$1
+    shift
+    if [ -x /usr/bin/time ]; then
+        /usr/bin/time -f "%e %M" -o $out "$@" > /dev/null 2>&1
+    else
+        local start=`date +%s.%N`
+        "$@" > /dev/null 2>&1
+        local status=$?
+        awk -v start=$start -v end=`date +%s.%N` 'BEGIN { printf "%.2f -\n", end - start }' > $out
+        return $status
+    fi
+}
+
+# the channels of a q2 XML profile, one line per producer/consumer pair. The address
+# ranges are left out, they change with the layout of the memory.
+channels()
+{
+    awk '
+        /<q2:channel / {
+            p = $0; sub(/.*producer="/, "", p); sub(/".*/, "", p)
+            c = $0; sub(/.*consumer="/, "", c); sub(/".*/, "", c)
+        }
+        /<q2:Bytes>/ { b = $0; gsub(/.*<q2:Bytes>|<\/q2:Bytes>.*/, "", b) }
+        /<q2:UnMA>/ { m = $0; gsub(/.*<q2:UnMA>|<\/q2:UnMA>.*/, "", m) }
+        /<q2:UnDV>/ { v = $0; gsub(/.*<q2:UnDV>|<\/q2:UnDV>.*/, "", v) }
+        /<\/q2:channel>/ { print p " -> " c ": " b " Bytes, " m " UnMA, " v " UnDV" }
+    ' $1 | LC_ALL=C sort
+}
+
+# baseline <name> <field>: a field of the baseline of a program, '-' if there is none
+baseline()
+{
+    local value=`awk -v name=$1 -v field=$2 '$1 == name { print $field }' $BASELINE 2>/dev/null`
+    echo ${value:--}
+}
+
+# ratio <value> <baseline value>
+ratio()
+{
+    if [ "$1" = "-" ] || [ "$2" = "-" ]; then
+        echo "-"
+    else
+        awk -v a=$1 -v b=$2 'BEGIN { if (b > 0) printf "%.2fx", a / b; else print "-" }'
+    fi
+}
+
+if [ "$mode" = "bless" ]; then
+    mkdir -p $PERFDIR/golden $PERFDIR/traces
+    echo "# name native_s quad_s quad_kb replay_s replay_kb" > $BASELINE.new
+fi
+
+failed=0
+compared=0
+printf "%-12s %-8s %10s %10s %10s %12s %12s\n" program result seconds peak_KB slowdown "vs baseline" "mem vs base"
+
+for src in $PERFDIR/*.c; do
+    name=`basename $src .c`
+    dir=$WORKDIR/$name
+    golden=$PERFDIR/golden/$name.channels
+    trace=$PERFDIR/traces/$name.trace
+
+    rm -rf $dir
+    mkdir -p $dir
+    cd $dir
+
+    if [ "$runner" = "pin" ]; then
+        if ! $CC -O0 -g $src -o $name; then
+            echo "Can not compile $src" >&2
+            failed=1
+            continue
+        fi
+        measure native.time ./$name
+        measure quad.time $PIN -t $QUADTOOL -- ./$name
+        status=$?
+    else
+        if [ ! -f $trace ]; then
+            printf "%-12s %-8s (no trace, run 'make perfbless' on a host with Pin)\n" $name skipped
+            continue
+        fi
+        measure quad.time $REPLAY $trace
+        status=$?
+    fi
+
+    if [ $status -ne 0 ] || [ ! -f q2profiling.xml ]; then
+        printf "%-12s %-8s (QUAD failed, see $dir)\n" $name FAILED
+        failed=1
+        continue
+    fi
+    channels q2profiling.xml > $name.channels
+
+    read seconds kb < quad.time
+    if [ "$runner" = "pin" ]; then
+        read native_seconds native_kb < native.time
+        slowdown=`ratio $seconds $native_seconds`
+        base_slowdown=`ratio \`baseline $name 3\` \`baseline $name 2\``
+        vs_base=`ratio ${slowdown%x} ${base_slowdown%x}`
+        mem_base=`ratio $kb \`baseline $name 4\``
+    else
+        slowdown="-"
+        vs_base=`ratio $seconds \`baseline $name 5\``
+        mem_base=`ratio $kb \`baseline $name 6\``
+    fi
+
+    if [ "$mode" = "bless" ]; then
+        cp $name.channels $golden
+        rm -f $trace
+        $PIN -t $QUADTOOL -record_trace $trace -- ./$name > /dev/null 2>&1
+        mkdir -p replay && cd replay
+        measure ../replay.time $REPLAY $trace
+        cd ..
+        read replay_seconds replay_kb < replay.time
+        echo "$name $native_seconds $seconds $kb $replay_seconds $replay_kb" >> $BASELINE.new
+        result=blessed
+    elif [ ! -f $golden ]; then
+        result=new
+    elif diff -u $golden $name.channels > channels.diff; then
+        result=ok
+        compared=`expr $compared + 1`
+    else
+        result=CHANGED
+        compared=`expr $compared + 1`
+        failed=1
+    fi
+
+    printf "%-12s %-8s %10s %10s %10s %12s %12s\n" $name $result $seconds $kb $slowdown $vs_base $mem_base
+    if [ "$result" = "CHANGED" ]; then
+        cat channels.diff
+    fi
+done
+
+if [ "$mode" = "bless" ]; then
+    mv $BASELINE.new $BASELINE
+    echo "Blessed the channels in $PERFDIR/golden, the traces in $PERFDIR/traces and $BASELINE"
+else
+    # golden channels without a single program compared with them checked nothing (e.g. the traces are missing)
+    if [ $compared -eq 0 ]; then
+        echo "No program was compared with the golden channels, run 'make perfbless' on a host with Pin and commit perf/golden, perf/traces and perf/baseline.txt" >&2
+        failed=1
+    fi
+    if [ $failed -ne 0 ]; then
+        echo "perfcheck FAILED"
+    fi
+fi
+exit $failed
@@ -0,0 +1,73 @@
+/*
+ * pipeline.c
+ *
+ * perfcheck program: a streaming filter pipeline, every stage reads the block
+ * of samples written by the previous stage.
+ *
+ */
+
+#include <stdio.h>
+
+#define BLOCK 256
+#define BLOCKS 64
+#define TAPS 8
+
+static int source[BLOCK], filtered[BLOCK], decimated[BLOCK / 2];
+static int history[TAPS];
+static const int taps[TAPS] = { 1, 3, 7, 12, 12, 7, 3, 1 };
+static long long total;
+
+void generate(int block)
+{
+	int i;
+
+	for (i = 0; i < BLOCK; i++)
+		source[i] = ((block * BLOCK + i) * 7919) % 1024 - 512;
+}
+
+void lowpass(void)
+{
+	int i, t;
+
+	for (i = 0; i < BLOCK; i++)
+	{
+		int acc = 0;
+		for (t = TAPS - 1; t > 0; t--)
+			history[t] = history[t - 1];
+		history[0] = source[i];
+		for (t = 0; t < TAPS; t++)
+			acc += history[t] * taps[t];
+		filtered[i] = acc / 46;
+	}
+}
+
+void decimate(void)
+{
+	int i;
+
+	for (i = 0; i < BLOCK / 2; i++)
+		decimated[i] = (filtered[2 * i] + filtered[2 * i + 1]) / 2;
+}
+
+void sink(void)
+{
+	int i;
+
+	for (i = 0; i < BLOCK / 2; i++)
+		total += decimated[i] * (i & 3);
+}
+
+int main(void)
+{
+	int block;
+
+	for (block = 0; block < BLOCKS; block++)
+	{
+		generate(block);
+		lowpass();
+		decimate();
+		sink();
+	}
+	printf("pipeline %lld\n", total);
+	return 0;
+}
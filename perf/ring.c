@@ -0,0 +1,72 @@
+/*
+ * ring.c
+ *
+ * perfcheck program: a producer and a consumer exchanging messages through a
+ * ring buffer. Both run in the main thread in a fixed order, so the profile
+ * does not depend on the scheduling of threads.
+ *
+ */
+
+#include <stdio.h>
+
+#define SLOTS 64
+#define MESSAGES 20000
+
+struct message
+{
+	int id;
+	int payload[6];
+};
+
+static struct message ring[SLOTS];
+static unsigned int head, tail;
+static long long received;
+
+int produce(int id)
+{
+	struct message *m;
+	int i;
+
+	if (head - tail == SLOTS)
+		return 0;
+	m = &ring[head % SLOTS];
+	m->id = id;
+	for (i = 0; i < 6; i++)
+		m->payload[i] = id * (i + 1);
+	head++;
+	return 1;
+}
+
+int consume(void)
+{
+	struct message *m;
+	int i;
+
+	if (head == tail)
+		return 0;
+	m = &ring[tail % SLOTS];
+	for (i = 0; i < 6; i++)
+		received += m->payload[i] ^ m->id;
+	tail++;
+	return 1;
+}
+
+int main(void)
+{
+	int id = 0;
+
+	while (id < MESSAGES)
+	{
+		/* bursts of different lengths fill the ring to different levels */
+		int burst = 1 + id % 37;
+		while (burst-- > 0 && id < MESSAGES && produce(id))
+			id++;
+		burst = 1 + id % 29;
+		while (burst-- > 0 && consume())
+			;
+	}
+	while (consume())
+		;
+	printf("ring %lld\n", received);
+	return 0;
+}
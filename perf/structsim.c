@@ -0,0 +1,100 @@
+/*
+ * structsim.c
+ *
+ * perfcheck program: a small particle simulation on an array of structures,
+ * the stages of every time step read and write different fields.
+ *
+ */
+
+#include <stdio.h>
+
+#define PARTICLES 256
+#define STEPS 16
+
+struct particle
+{
+	double pos[3];
+	double vel[3];
+	double force[3];
+	double mass;
+	int cell;
+};
+
+static struct particle particles[PARTICLES];
+
+void init_particles(void)
+{
+	int i, d;
+
+	for (i = 0; i < PARTICLES; i++)
+	{
+		for (d = 0; d < 3; d++)
+		{
+			particles[i].pos[d] = (double)((i * (d + 3)) % 97);
+			particles[i].vel[d] = 0.0;
+		}
+		particles[i].mass = 1.0 + (i % 5);
+	}
+}
+
+void assign_cells(void)
+{
+	int i;
+
+	for (i = 0; i < PARTICLES; i++)
+		particles[i].cell = ((int)particles[i].pos[0] / 10) * 100 + ((int)particles[i].pos[1] / 10) * 10 + (int)particles[i].pos[2] / 10;
+}
+
+void compute_forces(void)
+{
+	int i, j, d;
+
+	for (i = 0; i < PARTICLES; i++)
+	{
+		for (d = 0; d < 3; d++)
+			particles[i].force[d] = 0.0;
+		/* only the particles in the same cell interact */
+		for (j = 0; j < PARTICLES; j++)
+			if (j != i && particles[j].cell == particles[i].cell)
+				for (d = 0; d < 3; d++)
+					particles[i].force[d] += (particles[j].pos[d] - particles[i].pos[d]) * particles[j].mass * 0.01;
+	}
+}
+
+void integrate(void)
+{
+	int i, d;
+
+	for (i = 0; i < PARTICLES; i++)
+		for (d = 0; d < 3; d++)
+		{
+			particles[i].vel[d] += particles[i].force[d] / particles[i].mass;
+			particles[i].pos[d] += particles[i].vel[d] * 0.1;
+		}
+}
+
+double kinetic_energy(void)
+{
+	double energy = 0.0;
+	int i, d;
+
+	for (i = 0; i < PARTICLES; i++)
+		for (d = 0; d < 3; d++)
+			energy += 0.5 * particles[i].mass * particles[i].vel[d] * particles[i].vel[d];
+	return energy;
+}
+
+int main(void)
+{
+	int step;
+
+	init_particles();
+	for (step = 0; step < STEPS; step++)
+	{
+		assign_cells();
+		compute_forces();
+		integrate();
+	}
+	printf("structsim %.3f\n", kinetic_energy());
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * AccessRing.cpp
+ *
+ * This file contains the member functions of the AccessRing class, the ring buffer
+ * in a shared memory file between QUAD and quad-analyzer.
+ *
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "AccessRing.h"
+
+// true if process 'pid' does not exist anymore
+static bool processGone(INT32 pid)
+{
+	return pid != 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+AccessRing::AccessRing(const string &path, AccessRingHeader *header, size_t length)
+	:m_path(path), m_header(header), m_length(length)
+{
+	m_slots = (AccessRingSlot *)(header + 1);
+}
+
+AccessRing::~AccessRing()
+{
+	munmap(m_header, m_length);
+}
+
+AccessRing *AccessRing::create(const string &path, UINT64 slots)
+{
+	UINT64 count = 1;
+	size_t length;
+	int fd;
+	void *mem;
+
+	while (count < slots)
+		count <<= 1;
+	length = sizeof(AccessRingHeader) + count * sizeof(AccessRingSlot);
+
+	if ((fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0)
+	{
+		cerr << "Can not create the ring buffer file " << path << ": " << strerror(errno) << endl;
+		return NULL;
+	}
+	if (ftruncate(fd, length) != 0 ||
+	    (mem = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		cerr << "Can not map the ring buffer file " << path << ": " << strerror(errno) << endl;
+		::close(fd);
+		return NULL;
+	}
+	::close(fd);
+
+	AccessRingHeader *header = (AccessRingHeader *)mem;
+	memset(header, 0, sizeof(AccessRingHeader));
+	header->slots = count;
+	header->readerPid = getpid();
+	header->version = ACCESS_RING_VERSION;
+	__sync_synchronize();
+	header->magic = ACCESS_RING_MAGIC;
+
+	return new AccessRing(path, header, length);
+}
+
+AccessRing *AccessRing::attach(const string &path)
+{
+	struct stat st;
+	int fd;
+	void *mem;
+
+	if ((fd = open(path.c_str(), O_RDWR)) < 0)
+	{
+		cerr << "Can not open the ring buffer file " << path << ": " << strerror(errno) << endl;
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AccessRingHeader) ||
+	    (mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		cerr << "Can not map the ring buffer file " << path << endl;
+		::close(fd);
+		return NULL;
+	}
+	::close(fd);
+
+	AccessRingHeader *header = (AccessRingHeader *)mem;
+	if (header->magic != ACCESS_RING_MAGIC || header->version != ACCESS_RING_VERSION ||
+	    sizeof(AccessRingHeader) + header->slots * sizeof(AccessRingSlot) != (size_t)st.st_size)
+	{
+		cerr << "The file " << path << " is not a ring buffer created by quad-analyzer" << endl;
+		munmap(mem, st.st_size);
+		return NULL;
+	}
+	if (header->writerPid != 0 && !processGone(header->writerPid))
+	{
+		cerr << "Another process is already writing to the ring buffer " << path << endl;
+		munmap(mem, st.st_size);
+		return NULL;
+	}
+	header->writerPid = getpid();
+
+	return new AccessRing(path, header, st.st_size);
+}
+
+// reserves 'count' consecutive slots and waits until the reader made room for them
+bool AccessRing::reserve(UINT32 count, UINT64 *pos)
+{
+	unsigned int spins = 0;
+
+	*pos = __sync_fetch_and_add(&m_header->head, (UINT64)count);
+	while (*pos + count - m_header->tail > m_header->slots)
+	{
+		if (++spins % 1024 == 0)
+		{
+			if (processGone(m_header->readerPid))
+				return false;
+			usleep(100);
+		}
+		else
+			sched_yield();
+	}
+	return true;
+}
+
+bool AccessRing::writeAccess(ADDRINT addr, UINT32 size, UINT32 func, UINT32 var, bool write)
+{
+	UINT64 pos;
+
+	if (!reserve(1, &pos))
+		return false;
+
+	AccessRingSlot *slot = &m_slots[pos & (m_header->slots - 1)];
+	slot->type = write ? RING_WRITE : RING_READ;
+	slot->size = size;
+	slot->addr = addr;
+	slot->func = func;
+	slot->var = var;
+	__sync_synchronize();
+	slot->seq = pos + 1;
+	return true;
+}
+
+bool AccessRing::writeName(UINT32 type, UINT32 id, const string &name)
+{
+	UINT32 payload = (name.size() + RING_PAYLOAD_SIZE - 1) / RING_PAYLOAD_SIZE;
+	UINT64 pos;
+	UINT32 i;
+
+	if (!reserve(1 + payload, &pos))
+		return false;
+
+	AccessRingSlot *slot = &m_slots[pos & (m_header->slots - 1)];
+	slot->type = type;
+	slot->size = name.size();
+	slot->addr = id;
+	slot->func = 0;
+	slot->var = 0;
+	for (i = 0; i < payload; i++)
+	{
+		AccessRingSlot *data = &m_slots[(pos + 1 + i) & (m_header->slots - 1)];
+		size_t offset = i * RING_PAYLOAD_SIZE;
+		size_t length = name.size() - offset < RING_PAYLOAD_SIZE ? name.size() - offset : RING_PAYLOAD_SIZE;
+		memcpy((char *)data + sizeof(UINT64), name.data() + offset, length);
+	}
+	__sync_synchronize();
+	for (i = 1; i <= payload; i++)
+		m_slots[(pos + i) & (m_header->slots - 1)].seq = pos + i + 1;
+	slot->seq = pos + 1;
+	return true;
+}
+
+void AccessRing::close()
+{
+	__sync_synchronize();
+	m_header->closed = 1;
+}
+
+int AccessRing::read(AccessRingSlot &record, string &name)
+{
+	UINT64 tail = m_header->tail;
+	UINT64 mask = m_header->slots - 1;
+	AccessRingSlot *slot = &m_slots[tail & mask];
+	UINT32 payload = 0, i;
+
+	if (slot->seq != tail + 1)
+	{
+		// nothing published, check whether something can still come
+		bool gone = processGone(m_header->writerPid);
+		bool finished = m_header->closed && m_header->head == tail;
+		__sync_synchronize();
+		if (slot->seq != tail + 1)
+			return (gone || finished) ? RING_CLOSED : RING_EMPTY;
+	}
+	__sync_synchronize();
+	record = *slot;
+
+	if (record.type == RING_FUNC_NAME || record.type == RING_VAR_NAME)
+	{
+		payload = (record.size + RING_PAYLOAD_SIZE - 1) / RING_PAYLOAD_SIZE;
+		for (i = 1; i <= payload; i++)
+			if (m_slots[(tail + i) & mask].seq != tail + i + 1)
+				return processGone(m_header->writerPid) ? RING_CLOSED : RING_EMPTY;
+		__sync_synchronize();
+
+		name.clear();
+		for (i = 0; i < payload; i++)
+		{
+			size_t length = record.size - i * RING_PAYLOAD_SIZE < RING_PAYLOAD_SIZE ? record.size - i * RING_PAYLOAD_SIZE : RING_PAYLOAD_SIZE;
+			name.append((char *)&m_slots[(tail + 1 + i) & mask] + sizeof(UINT64), length);
+		}
+	}
+
+	__sync_synchronize();
+	m_header->tail = tail + 1 + payload;
+	return RING_RECORD;
+}
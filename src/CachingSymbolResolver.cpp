@@ -0,0 +1,122 @@
+/*****
+ *
+ * CachingSymbolResolver.cpp
+ *
+ * The per thread memo of the resolved variables, see CachingSymbolResolver.h.
+ *
+ *****/
+
+#include <cstring>
+
+#include "CachingSymbolResolver.h"
+#include "SelfProfile.h"
+
+using namespace std;
+
+CachingSymbolResolver::CachingSymbolResolver(SymbolResolver *resolver) : resolver(resolver) {
+}
+
+CachingSymbolResolver::~CachingSymbolResolver() {
+	for (unsigned int t = 0; t < caches.size(); t++) {
+		ResolverCache	**cache = caches.find(t);
+
+		if (cache != 0) {
+			delete *cache;
+		}
+	}
+}
+
+// every slot is used by one thread only, so it is never created twice
+ResolverCache* CachingSymbolResolver::getCache(const ExecutionContext &context, unsigned int *tid) const {
+	if (context.getThreadId(tid) != 0) {
+		*tid = 0;
+	}
+
+	ResolverCache	*&cache = caches[*tid];
+	if (cache == 0) {
+		cache = new ResolverCache();
+		memset(cache->slots, 0, sizeof(cache->slots));
+	}
+	return cache;
+}
+
+unsigned int CachingSymbolResolver::enterFunction(const class ExecutionContext &context, void *addr) {
+	unsigned int		tid;
+	unsigned long		sp = 0;
+	ResolverCache		*cache = getCache(context, &tid);
+	unsigned long long	signature = cache->frames.empty() ? 0 : cache->frames.back();
+
+	// the same call path with the stack at the same place gets the same signature
+	context.getRegisterValue(EREG_STACK_POINTER, &sp);
+	signature = (signature ^ (unsigned long) addr) * 0x9e3779b97f4a7c15ULL;
+	signature = (signature ^ sp) * 0x9e3779b97f4a7c15ULL;
+	cache->frames.push_back(signature);
+	return resolver->enterFunction(context, addr);
+}
+
+unsigned int CachingSymbolResolver::leaveFunction(const class ExecutionContext &context, void *addr, void *ret_addr) {
+	unsigned int	tid;
+	ResolverCache	*cache = getCache(context, &tid);
+
+	if (!cache->frames.empty()) {
+		cache->frames.pop_back();
+	}
+	return resolver->leaveFunction(context, addr, ret_addr);
+}
+
+unsigned int CachingSymbolResolver::resolveFunction(const ExecutionContext& context, void *addr, const FunctionSymbol **function) const {
+	return resolver->resolveFunction(context, addr, function);
+}
+
+unsigned int CachingSymbolResolver::resolveVariable(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable) const {
+	unsigned int		tid;
+	void			*ip;
+	ResolverCache		*cache = getCache(context, &tid);
+	unsigned int		depth = cache->frames.size();
+	unsigned long long	signature = cache->frames.empty() ? 0 : cache->frames.back();
+
+	if (context.getInstructionPointer(&ip) != 0) {
+		return resolver->resolveVariable(context, addr, size, variable);
+	}
+
+	ResolvedAccess &slot = cache->slots[(((unsigned long) ip >> 2) ^ (((unsigned long) addr >> 12) * 0x9e3779b1UL >> 8)) & (RESOLVER_CACHE_SLOTS - 1)];
+	if (slot.ip == ip && slot.depth == depth && slot.signature == signature &&
+	    slot.low <= addr && (char*) addr + size <= (char*) slot.high) {
+		GetThreadProfile(tid)->counters[SP_RESOLVER_CACHE_HITS]++;
+		if (slot.result == 0) {
+			*variable = slot.variable;
+		}
+		return slot.result;
+	}
+
+	slot.result = resolver->resolveVariableRange(context, addr, size, &slot.variable, &slot.low, &slot.high);
+	if (slot.result == 0) {
+		*variable = slot.variable;
+	}
+	// the accesses the resolver can not tell anything about are not remembered
+	if (slot.result < 2) {
+		slot.ip = ip;
+		slot.depth = depth;
+		slot.signature = signature;
+	} else {
+		slot.ip = 0;
+	}
+	return slot.result;
+}
+
+unsigned int CachingSymbolResolver::resolveStaticVariable(void *ip, enum eRegister base, long displacement, size_t size, const VariableSymbol **variable) const {
+	return resolver->resolveStaticVariable(ip, base, displacement, size, variable);
+}
+
+size_t CachingSymbolResolver::memoryUsage() const {
+	size_t	bytes = sizeof(*this) + resolver->memoryUsage();
+
+	for (unsigned int t = 0; t < caches.size(); t++) {
+		ResolverCache	**cache = caches.find(t);
+
+		if (cache != 0 && *cache != 0) {
+			bytes += sizeof(ResolverCache) + (*cache)->frames.capacity() * sizeof(unsigned long long);
+		}
+	}
+	return bytes;
+}
@@ -17,6 +17,7 @@
 using namespace std;
 
 Channel::Channel(string p, string c, vector<Range>& ranges, ULL unma ,ULL bytes, ULL vals)
+	:Estimated(false)
 {
 	producer = p;
 	consumer = c;
@@ -134,6 +134,7 @@ unsigned int DwarfIndexer::getDwarfScriptList(Dwarf_Die die, Dwarf_Half attr, Dw
 
 					dls.script.push_back(op);
 				}
+				DwarfMachine::compile(dls);
 
 				sl.push_back(dls);
 
@@ -240,10 +241,55 @@ void DwarfIndexer::fixIndirectVariableType(struct VarEntry &ve) {
 	}
 }
 
-DwarfIndexer::DwarfIndexer() : CU_lopc(0), CU_hipc(0), current_basetype(0) {
+DwarfIndexer::DwarfIndexer(unsigned int verbose) : CU_lopc(0), CU_hipc(0), current_basetype(0), unit_pass(UP_All), verbose(verbose) {
 }
 
 DwarfIndexer::~DwarfIndexer() {
+	while (!units.empty()) {
+		delete units.back();
+		units.pop_back();
+	}
+}
+
+// the ranges of the units in .debug_aranges, by the offset of their CU DIE
+unsigned int DwarfIndexer::getAddressRanges(map<Dwarf_Off, vector<pair<Dwarf_Addr, Dwarf_Addr> > > &ranges, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
+	Dwarf_Arange	*aranges;
+	Dwarf_Signed	count;
+
+	if (dwarf_get_aranges(dwarf_handle, &aranges, &count, &dwarf_error) != DW_DLV_OK) {
+		return 1;
+	}
+
+	for (Dwarf_Signed i = 0; i < count; i++) {
+		Dwarf_Addr	start;
+		Dwarf_Unsigned	length;
+		Dwarf_Off	cu_offset;
+
+		if (dwarf_get_arange_info(aranges[i], &start, &length, &cu_offset, &dwarf_error) == DW_DLV_OK && length > 0) {
+			ranges[cu_offset].push_back(make_pair(start, start + length));
+		}
+		dwarf_dealloc(dwarf_handle, aranges[i], DW_DLA_ARANGE);
+	}
+	dwarf_dealloc(dwarf_handle, aranges, DW_DLA_LIST);
+	return 0;
+}
+
+// the top level functions of the CU, collects the functions of the unit (with the nested ones) from their offsets
+unsigned int DwarfIndexer::visitUnitFunctions(UnitEntry &unit, Dwarf_Die cu_die, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
+	DwarfIndex				global_index = { types, global_variables, functions };
+	map<Dwarf_Off, FunctionEntry*>::iterator	fit;
+	unsigned int				res;
+
+	current_function_id = "";
+	unit_pass = UP_Functions;
+	res = visitCU(global_index, cu_die, dwarf_handle, dwarf_error);
+	unit_pass = UP_All;
+
+	for (fit = functions.lower_bound(unit.offset); fit != functions.end() && fit->first < unit.end; fit++) {
+		unit.functions.push_back(fit->second);
+	}
+	unit.indexed = true;
+	return res;
 }
 
 unsigned int DwarfIndexer::accept(Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
@@ -252,9 +298,16 @@ unsigned int DwarfIndexer::accept(Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_er
 	Dwarf_Unsigned 	header_length, abbrev_offset, next_cu_header;
 	Dwarf_Half	version_stamp, address_size;
 	DwarfIndex	global_index = { types, global_variables, functions };
+	map<Dwarf_Off, vector<pair<Dwarf_Addr, Dwarf_Addr> > >	aranges;
+	unsigned int	indexed = 0;
 
+	if (verbose > 0) {
+		cerr << "Indexing dwarf..." << endl;
+	}
 
-	cerr << "Indexing dwarf..." << endl;
+	if (getAddressRanges(aranges, dwarf_handle, dwarf_error) != 0 && verbose > 0) {
+		cerr << "Warning: no .debug_aranges, using the pcs of the CUs" << endl;
+	}
 
 	current_function_id = "";
 	while ((res = dwarf_next_cu_header(dwarf_handle, &header_length,
@@ -262,9 +315,41 @@ unsigned int DwarfIndexer::accept(Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_er
 					&address_size, &next_cu_header, &dwarf_error)) == DW_DLV_OK) {
 		if ((res = dwarf_siblingof(dwarf_handle, 0, &cu_die, &dwarf_error)) == DW_DLV_OK) {
 			if (getDwarfTag(cu_die, dwarf_error) == DW_TAG_compile_unit) {
-				if (visitCU(global_index, cu_die, dwarf_handle, dwarf_error) != 0) {
+				UnitEntry	*unit = new UnitEntry;
+				Dwarf_Addr	lopc, hipc;
+
+				unit->offset = getDwarfOffset(cu_die, dwarf_handle, dwarf_error);
+				unit->end = next_cu_header;
+				unit->indexed = false;
+				units.push_back(unit);
+
+				if (aranges.count(unit->offset) > 0) {
+					unit->ranges = aranges[unit->offset];
+				} else if (getDwarfPC(cu_die, &lopc, &hipc, dwarf_error) == 0 && lopc < hipc) {
+					unit->ranges.push_back(make_pair(lopc, hipc));
+				}
+
+				unit_pass = UP_Globals;
+				res = visitCU(global_index, cu_die, dwarf_handle, dwarf_error);
+				unit_pass = UP_All;
+				if (res != 0) {
 					return 2;
 				}
+
+				// without ranges there is no address to index the unit on later, so its functions tell them
+				if (unit->ranges.empty()) {
+					vector<FunctionEntry*>::iterator fit;
+
+					if (visitUnitFunctions(*unit, cu_die, dwarf_handle, dwarf_error) != 0) {
+						return 2;
+					}
+					for (fit = unit->functions.begin(); fit != unit->functions.end(); fit++) {
+						if ((*fit)->lopc < (*fit)->hipc) {
+							unit->ranges.push_back(make_pair((*fit)->lopc, (*fit)->hipc));
+						}
+					}
+					indexed++;
+				}
 			}
 		} else {
 			return 3;
@@ -274,85 +359,382 @@ unsigned int DwarfIndexer::accept(Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_er
 	fixIndirectTypes();
 	fixIndirectVariableTypes();
 
-	map<Dwarf_Off, TypeEntry*>::iterator ti;
-	cerr << "Types: " << endl;
-	for (ti = types.begin(); ti != types.end(); ti++) {
-		cerr << " - " << ti->second->name << endl;	
+	if (verbose > 0) {
+		cerr << "Indexed " << units.size() << " compile units, the functions of " << indexed << " of them" << endl;
+	}
+	if (verbose > 1) {
+		map<Dwarf_Off, FunctionEntry*>::const_iterator fit;
+
+		dumpTypes();
+		dumpGlobals();
+		cerr << "Functions: " << endl;
+		for (fit = functions.begin(); fit != functions.end(); fit++) {
+			dumpFunction(*fit->second);
+		}
 	}
 
-	map<Dwarf_Off, VarEntry*>::iterator vi;
-	cerr << "Globals: " << endl;
-	for (vi = global_variables.begin(); vi != global_variables.end(); vi++) {
-		TypeEntry &type = vi->second->type;
-
-		cerr << " - [";
-		cerr << type.name;
-		cerr << "] " << vi->second->name << endl;
-
-		DwarfScriptList::iterator slit;
-		for (slit = vi->second->location.begin(); slit != vi->second->location.end(); slit++) {
-			cerr << "   <" << (void*) slit->lowpc << " - " << (void*) slit->hipc << ">:" << endl;
-			
-			DwarfScript::iterator si;
-			for (si = slit->script.begin(); si != slit->script.end(); si++) {
-				cerr << "      #" << (void*) si->offset << " - " << (void*) si->opcode << " (" << (void*) si->operand1 << ", " << (void*) si->operand2 << ")" << endl;
-			}
+	return 0;
+}
+
+unsigned int DwarfIndexer::indexUnit(UnitEntry &unit, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
+	unsigned int	res;
+
+	if (unit.indexed) {
+		return 0;
+	}
+
+	if ((res = parseUnit(unit, dwarf_handle, dwarf_error)) != 0) {
+		return res;
+	}
+	fixUnitTypes(unit);
+	return 0;
+}
+
+unsigned int DwarfIndexer::parseUnit(UnitEntry &unit, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
+	Dwarf_Die	cu_die;
+
+	if (dwarf_offdie(dwarf_handle, unit.offset, &cu_die, &dwarf_error) != DW_DLV_OK) {
+		// do not try again on every address of the unit
+		unit.indexed = true;
+		return 1;
+	}
+	if (visitUnitFunctions(unit, cu_die, dwarf_handle, dwarf_error) != 0) {
+		return 2;
+	}
+	return 0;
+}
+
+unsigned int DwarfIndexer::mergeUnit(UnitEntry &unit, DwarfIndexer &partial) {
+	map<Dwarf_Off, TypeEntry*>::iterator		tfirst, tlast;
+	map<Dwarf_Off, FunctionEntry*>::iterator	ffirst, flast, fit;
+
+	if (unit.indexed) {
+		partial.dropUnit(unit);
+		return 1;
+	}
+
+	// the offsets of the DIEs of a unit are its own, so nothing is replaced
+	tfirst = partial.types.lower_bound(unit.offset);
+	tlast = partial.types.lower_bound(unit.end);
+	types.insert(tfirst, tlast);
+	partial.types.erase(tfirst, tlast);
+
+	ffirst = partial.functions.lower_bound(unit.offset);
+	flast = partial.functions.lower_bound(unit.end);
+	functions.insert(ffirst, flast);
+	partial.functions.erase(ffirst, flast);
+
+	for (fit = functions.lower_bound(unit.offset); fit != functions.end() && fit->first < unit.end; fit++) {
+		unit.functions.push_back(fit->second);
+	}
+	unit.indexed = true;
+
+	fixUnitTypes(unit);
+	return 0;
+}
+
+// deletes the entries of the unit, parsed by this indexer but not merged
+void DwarfIndexer::dropUnit(const UnitEntry &unit) {
+	map<Dwarf_Off, TypeEntry*>::iterator		tit;
+	map<Dwarf_Off, FunctionEntry*>::iterator	fit;
+	map<Dwarf_Off, VarEntry*>::iterator		vit;
+
+	for (tit = types.lower_bound(unit.offset); tit != types.end() && tit->first < unit.end; tit++) {
+		delete tit->second;
+	}
+	types.erase(types.lower_bound(unit.offset), types.lower_bound(unit.end));
+
+	for (fit = functions.lower_bound(unit.offset); fit != functions.end() && fit->first < unit.end; fit++) {
+		for (vit = fit->second->variables.begin(); vit != fit->second->variables.end(); vit++) {
+			delete vit->second;
 		}
+		delete fit->second;
 	}
+	functions.erase(functions.lower_bound(unit.offset), functions.lower_bound(unit.end));
+}
 
-	map<Dwarf_Off, FunctionEntry*>::iterator fi;
-	cerr << "Functions: " << endl;
-	for (fi = functions.begin(); fi != functions.end(); fi++) {
-		ti = types.find(fi->second->return_type);
+// the types declared in the functions of the unit, and the types of their variables
+void DwarfIndexer::fixUnitTypes(const UnitEntry &unit) {
+	map<Dwarf_Off, TypeEntry*>::iterator		tit;
+	vector<FunctionEntry*>::const_iterator		fit;
 
-		cerr << " - [";
-		if (fi->second->return_type == -1) {
-			cerr << "void";
-		} else if (ti != types.end()) {
-			cerr << ti->second->name;
-		} else {
-			cerr << fi->second->return_type;
+	for (tit = types.lower_bound(unit.offset); tit != types.end() && tit->first < unit.end; tit++) {
+		fixIndirectType(*tit->second);
+	}
+	for (fit = unit.functions.begin(); fit != unit.functions.end(); fit++) {
+		fixIndirectLocalVariableTypes(**fit);
+	}
+
+	if (verbose > 1) {
+		cerr << "Indexed the " << unit.functions.size() << " functions of the unit at " << (void*) unit.offset << endl;
+		for (fit = unit.functions.begin(); fit != unit.functions.end(); fit++) {
+			dumpFunction(**fit);
 		}
-		cerr << "] " << fi->second->name << " (";
-		// print parameters
-		cerr << ")" << endl;
-
-		cerr << "   Frame Base: " << endl;
-		DwarfScriptList::iterator slit;
-		for (slit = fi->second->frame_base.begin(); slit != fi->second->frame_base.end(); slit++) {
-			cerr << "   <" << (void*) slit->lowpc << " - " << (void*) slit->hipc << ">:" << endl;
-			
-			DwarfScript::iterator si;
-			for (si = slit->script.begin(); si != slit->script.end(); si++) {
-				cerr << "      #" << (void*) si->offset << " - " << (void*) si->opcode << " (" << si->operand1 << ", " << si->operand2 << ")" << endl;
-			}
+	}
+}
+
+void DwarfIndexer::saveLocation(SymbolCacheWriter &cache, const DwarfScriptList &location) {
+	DwarfScriptList::const_iterator	slit;
+	DwarfScript::const_iterator	si;
+
+	cache.putNumber(location.size());
+	for (slit = location.begin(); slit != location.end(); slit++) {
+		cache.putNumber(slit->lowpc);
+		cache.putNumber(slit->hipc);
+		cache.putNumber(slit->compiled.kind);
+		cache.putNumber(slit->compiled.reg);
+		cache.putNumber(slit->compiled.operand);
+		cache.putNumber(slit->script.size());
+		for (si = slit->script.begin(); si != slit->script.end(); si++) {
+			cache.putNumber(si->opcode);
+			cache.putNumber(si->operand1);
+			cache.putNumber(si->operand2);
+			cache.putNumber(si->offset);
 		}
+	}
+}
 
-		if (!fi->second->variables.empty()) {
-			cerr << "   Local Variables: " << endl;
-			for (vi = fi->second->variables.begin(); vi != fi->second->variables.end(); vi++) {
-				TypeEntry &type = vi->second->type;
-		
-				cerr << "    - [";
-				cerr << type.name;
-				cerr << "] " << vi->second->name << endl;
-			
-				DwarfScriptList::iterator slit;
-				for (slit = vi->second->location.begin(); slit != vi->second->location.end(); slit++) {
-					cerr << "      <" << (void*) slit->lowpc << " - " << (void*) slit->hipc << ">:" << endl;
-					
-					DwarfScript::iterator si;
-					for (si = slit->script.begin(); si != slit->script.end(); si++) {
-						cerr << "         #" << (void*) si->offset << " - " << (void*) si->opcode << " (" << si->operand1 << ", " << si->operand2 << ")" << endl;
-					}
-				}
-			}
+void DwarfIndexer::saveVariable(SymbolCacheWriter &cache, const VarEntry &ve) {
+	cache.putName(ve.name);
+	cache.putNumber(ve.type_off);
+	saveLocation(cache, ve.location);
+}
+
+// the DIE offsets of the tables are stored as the difference with the previous one
+void DwarfIndexer::save(SymbolCacheWriter &cache) const {
+	map<Dwarf_Off, TypeEntry*>::const_iterator	tit;
+	map<Dwarf_Off, VarEntry*>::const_iterator	vit;
+	map<Dwarf_Off, FunctionEntry*>::const_iterator	fit;
+	vector<UnitEntry*>::const_iterator		uit;
+	Dwarf_Off					previous;
+
+	cache.putNumber(types.size());
+	for (tit = types.begin(), previous = 0; tit != types.end(); previous = tit->first, tit++) {
+		cache.putNumber(tit->first - previous);
+		cache.putNumber(tit->second->type);
+		cache.putName(tit->second->name);
+		cache.putNumber(tit->second->basetype_off);
+		cache.putNumber(tit->second->size);
+		cache.putNumber(tit->second->upper_bound);
+	}
+
+	cache.putNumber(global_variables.size());
+	for (vit = global_variables.begin(), previous = 0; vit != global_variables.end(); previous = vit->first, vit++) {
+		cache.putNumber(vit->first - previous);
+		saveVariable(cache, *vit->second);
+	}
+
+	cache.putNumber(functions.size());
+	for (fit = functions.begin(), previous = 0; fit != functions.end(); previous = fit->first, fit++) {
+		const FunctionEntry &fe = *fit->second;
+		Dwarf_Off	local = fit->first;
+
+		cache.putNumber(fit->first - previous);
+		cache.putName(fe.name);
+		cache.putNumber(fe.return_type);
+		cache.putNumber(fe.lopc);
+		cache.putNumber(fe.hipc);
+		saveLocation(cache, fe.frame_base);
+		cache.putNumber(fe.variables.size());
+		for (vit = fe.variables.begin(); vit != fe.variables.end(); local = vit->first, vit++) {
+			cache.putNumber(vit->first - local);
+			saveVariable(cache, *vit->second);
+		}
+	}
+
+	cache.putNumber(units.size());
+	for (uit = units.begin(), previous = 0; uit != units.end(); previous = (*uit)->offset, uit++) {
+		vector<pair<Dwarf_Addr, Dwarf_Addr> >::const_iterator rit;
+
+		cache.putNumber((*uit)->offset - previous);
+		cache.putNumber((*uit)->end - (*uit)->offset);
+		cache.putNumber((*uit)->ranges.size());
+		for (rit = (*uit)->ranges.begin(); rit != (*uit)->ranges.end(); rit++) {
+			cache.putNumber(rit->first);
+			cache.putNumber(rit->second - rit->first);
+		}
+	}
+}
+
+void DwarfIndexer::loadLocation(SymbolCacheReader &cache, DwarfScriptList &location) {
+	unsigned long long count = cache.getNumber();
+
+	for (unsigned long long l = 0; l < count && cache.ok(); l++) {
+		DwarfLocationScript dls;
+
+		dls.lowpc = cache.getNumber();
+		dls.hipc = cache.getNumber();
+		dls.compiled.kind = (enum eLocationKind) cache.getNumber();
+		dls.compiled.reg = (enum eRegister) cache.getNumber();
+		dls.compiled.operand = cache.getNumber();
+
+		unsigned long long operations = cache.getNumber();
+		for (unsigned long long o = 0; o < operations && cache.ok(); o++) {
+			DwarfOperation op;
+
+			op.opcode = (unsigned char) cache.getNumber();
+			op.operand1 = cache.getNumber();
+			op.operand2 = cache.getNumber();
+			op.offset = cache.getNumber();
+			dls.script.push_back(op);
 		}
+		location.push_back(dls);
 	}
+}
+
+VarEntry* DwarfIndexer::loadVariable(SymbolCacheReader &cache, const string &function_id) {
+	VarEntry *ve = new VarEntry;
 
+	ve->name = cache.getName();
+	ve->function_id = function_id;
+	ve->type_off = cache.getNumber();
+	loadLocation(cache, ve->location);
+	return ve;
+}
+
+unsigned int DwarfIndexer::load(SymbolCacheReader &cache) {
+	unsigned long long	count;
+	Dwarf_Off		offset;
+
+	count = cache.getNumber();
+	for (offset = 0; count > 0 && cache.ok(); count--) {
+		TypeEntry *te = new TypeEntry;
+
+		offset += cache.getNumber();
+		te->type = (enum TypeType) cache.getNumber();
+		te->name = cache.getName();
+		te->basetype_off = cache.getNumber();
+		te->basetype_type = 0;
+		te->size = cache.getNumber();
+		te->upper_bound = cache.getNumber();
+		types[offset] = te;
+	}
+
+	count = cache.getNumber();
+	for (offset = 0; count > 0 && cache.ok(); count--) {
+		offset += cache.getNumber();
+		global_variables[offset] = loadVariable(cache, "");
+	}
+
+	count = cache.getNumber();
+	for (offset = 0; count > 0 && cache.ok(); count--) {
+		FunctionEntry		*fe = new FunctionEntry;
+		stringstream		unique_name_ss;
+		unsigned long long	variables;
+		Dwarf_Off		local;
+
+		offset += cache.getNumber();
+		fe->name = cache.getName();
+		fe->return_type = cache.getNumber();
+		fe->lopc = cache.getNumber();
+		fe->hipc = cache.getNumber();
+		unique_name_ss << fe->name << "_" << fe->lopc;
+		unique_name_ss >> fe->unique_id;
+		loadLocation(cache, fe->frame_base);
+
+		variables = cache.getNumber();
+		for (local = offset; variables > 0 && cache.ok(); variables--) {
+			local += cache.getNumber();
+			fe->variables[local] = loadVariable(cache, fe->unique_id);
+		}
+		functions[offset] = fe;
+	}
+
+	count = cache.getNumber();
+	for (offset = 0; count > 0 && cache.ok(); count--) {
+		UnitEntry		*unit = new UnitEntry;
+		unsigned long long	ranges;
+		map<Dwarf_Off, FunctionEntry*>::iterator fit;
+
+		offset += cache.getNumber();
+		unit->offset = offset;
+		unit->end = offset + cache.getNumber();
+		unit->indexed = true;
+		ranges = cache.getNumber();
+		for (; ranges > 0 && cache.ok(); ranges--) {
+			Dwarf_Addr low = cache.getNumber();
+			unit->ranges.push_back(make_pair(low, low + cache.getNumber()));
+		}
+		for (fit = functions.lower_bound(unit->offset); fit != functions.end() && fit->first < unit->end; fit++) {
+			unit->functions.push_back(fit->second);
+		}
+		units.push_back(unit);
+	}
+
+	if (!cache.ok()) {
+		return 1;
+	}
+
+	// the types of the variables are copies, with the base types they point to
+	fixIndirectTypes();
+	fixIndirectVariableTypes();
+
+	if (verbose > 0) {
+		cerr << "Read the index of " << units.size() << " compile units from the cache" << endl;
+	}
 	return 0;
 }
 
+void DwarfIndexer::dumpLocation(const DwarfScriptList &location, const char *indent) {
+	DwarfScriptList::const_iterator slit;
+
+	for (slit = location.begin(); slit != location.end(); slit++) {
+		cerr << indent << "<" << (void*) slit->lowpc << " - " << (void*) slit->hipc << ">:" << endl;
+
+		DwarfScript::const_iterator si;
+		for (si = slit->script.begin(); si != slit->script.end(); si++) {
+			cerr << indent << "   #" << (void*) si->offset << " - " << (void*) si->opcode << " (" << si->operand1 << ", " << si->operand2 << ")" << endl;
+		}
+	}
+}
+
+void DwarfIndexer::dumpTypes() const {
+	map<Dwarf_Off, TypeEntry*>::const_iterator ti;
+
+	cerr << "Types: " << endl;
+	for (ti = types.begin(); ti != types.end(); ti++) {
+		cerr << " - " << ti->second->name << endl;	
+	}
+}
+
+void DwarfIndexer::dumpGlobals() const {
+	map<Dwarf_Off, VarEntry*>::const_iterator vi;
+
+	cerr << "Globals: " << endl;
+	for (vi = global_variables.begin(); vi != global_variables.end(); vi++) {
+		cerr << " - [" << vi->second->type.name << "] " << vi->second->name << endl;
+		dumpLocation(vi->second->location, "   ");
+	}
+}
+
+void DwarfIndexer::dumpFunction(const FunctionEntry &fe) const {
+	map<Dwarf_Off, TypeEntry*>::const_iterator	ti;
+	map<Dwarf_Off, VarEntry*>::const_iterator	vi;
+
+	ti = types.find(fe.return_type);
+
+	cerr << " - [";
+	if (fe.return_type == (Dwarf_Off) -1) {
+		cerr << "void";
+	} else if (ti != types.end()) {
+		cerr << ti->second->name;
+	} else {
+		cerr << fe.return_type;
+	}
+	cerr << "] " << fe.name << " ()" << endl;
+
+	cerr << "   Frame Base: " << endl;
+	dumpLocation(fe.frame_base, "   ");
+
+	if (!fe.variables.empty()) {
+		cerr << "   Local Variables: " << endl;
+		for (vi = fe.variables.begin(); vi != fe.variables.end(); vi++) {
+			cerr << "    - [" << vi->second->type.name << "] " << vi->second->name << endl;
+			dumpLocation(vi->second->location, "      ");
+		}
+	}
+}
+
 unsigned int DwarfIndexer::accept(DwarfIndex &index, Dwarf_Die die, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
 	Dwarf_Half tag;
 	switch(tag = getDwarfTag(die, dwarf_error)) {
@@ -380,7 +762,9 @@ unsigned int DwarfIndexer::accept(DwarfIndex &index, Dwarf_Die die, Dwarf_Debug
 	case DW_TAG_subprogram:
 		return visitSubProgram(index, die, dwarf_handle, dwarf_error);
 	default:
-		cerr << "Unsupported tag number " << tag << ". Has to be added." << endl;
+		if (verbose > 0) {
+			cerr << "Unsupported tag number " << tag << ". Has to be added." << endl;
+		}
 		return 255;
 	}
 }
@@ -406,14 +790,37 @@ unsigned int DwarfIndexer::acceptChildren(DwarfIndex &index, Dwarf_Die die, Dwar
 unsigned int DwarfIndexer::visitCU(DwarfIndex &index, Dwarf_Die cu_die, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
 	Dwarf_Addr		lopc, hipc;
 	
+	unsigned int		res;
+	list<Dwarf_Die>		children;
+	list<Dwarf_Die>::iterator	it;
+	
 	if (getDwarfPC(cu_die, &lopc, &hipc, dwarf_error) != 0) {
-		cerr << "Warning: could not read lowpc or hipc of CU" << endl;
+		if (verbose > 0) {
+			cerr << "Warning: could not read lowpc or hipc of CU" << endl;
+		}
 		lopc = hipc = 0;
 	}
 	CU_lopc = lopc;
 	CU_hipc = hipc;
 
-	return acceptChildren(index, cu_die, dwarf_handle, dwarf_error);
+	if (unit_pass == UP_All) {
+		return acceptChildren(index, cu_die, dwarf_handle, dwarf_error);
+	}
+
+	if (getChildren(cu_die, children, dwarf_handle, dwarf_error) != 0) {
+		return 1; 	
+	}
+
+	for (it = children.begin(); it != children.end(); it++) {
+		if ((getDwarfTag(*it, dwarf_error) == DW_TAG_subprogram) != (unit_pass == UP_Functions)) {
+			continue;
+		}
+		res = accept(index, *it, dwarf_handle, dwarf_error);
+		if (res != 0 && res != 255) {
+			return 2;
+		}
+	}
+	return 0;
 }
 
 unsigned int DwarfIndexer::visitBaseType(DwarfIndex &index, Dwarf_Die type_die, Dwarf_Debug dwarf_handle, Dwarf_Error dwarf_error) {
@@ -429,11 +836,16 @@ unsigned int DwarfIndexer::visitBaseType(DwarfIndex &index, Dwarf_Die type_die,
 	te = new TypeEntry;
 	te->type = TT_Base;
 	te->name = name;
+	te->basetype_off = 0;
+	te->basetype_type = 0;
 	te->size = size;
+	te->upper_bound = 0;
 
 	index.types[offset] = te;
 
-	cerr << name.c_str() << endl;
+	if (verbose > 1) {
+		cerr << name.c_str() << endl;
+	}
 
 	return 0;
 }
@@ -454,6 +866,7 @@ unsigned int DwarfIndexer::visitTypedefType(DwarfIndex &index, Dwarf_Die type_di
 	te->basetype_off = realtype;
 	te->basetype_type = 0;
 	te->size = 0;
+	te->upper_bound = 0;
 
 	index.types[offset] = te;
 
@@ -475,6 +888,7 @@ unsigned int DwarfIndexer::visitArrayType(DwarfIndex &index, Dwarf_Die type_die,
 	te->basetype_off = element;
 	te->basetype_type = 0;
 	te->size = 0;
+	te->upper_bound = 0;
 
 	index.types[offset] = te;
 
@@ -520,6 +934,7 @@ unsigned int DwarfIndexer::visitPointerType(DwarfIndex &index, Dwarf_Die type_di
 	te->basetype_off = pointee;
 	te->basetype_type = 0;
 	te->size = size;
+	te->upper_bound = 0;
 
 	index.types[offset] = te;
 
@@ -541,6 +956,8 @@ unsigned int DwarfIndexer::visitConstType(DwarfIndex &index, Dwarf_Die type_die,
 	te->name = "";
 	te->basetype_off = basetype;
 	te->basetype_type = 0;
+	te->size = 0;
+	te->upper_bound = 0;
 
 	index.types[offset] = te;
 
@@ -560,7 +977,10 @@ unsigned int DwarfIndexer::visitStructureType(DwarfIndex &index, Dwarf_Die type_
 	te = new TypeEntry;
 	te->type = TT_Struct;
 	te->name = name;
+	te->basetype_off = 0;
+	te->basetype_type = 0;
 	te->size = size;
+	te->upper_bound = 0;
 
 	// TODO: add structure members.
 
@@ -584,12 +1004,16 @@ unsigned int DwarfIndexer::visitVariable(DwarfIndex &index, Dwarf_Die variable_d
 	ve->function_id = current_function_id;
 	ve->type_off = type;
 	if (getDwarfScriptList(variable_die, DW_AT_location, ve->location, dwarf_handle, dwarf_error, CU_lopc) != 0) {
-		cerr << "Warning: variable " << ve->name << " has no location." << endl;
+		if (verbose > 0) {
+			cerr << "Warning: variable " << ve->name << " has no location." << endl;
+		}
 	}
 
 	index.variables[offset] = ve;
 
-	cerr << name.c_str() << endl;
+	if (verbose > 1) {
+		cerr << name.c_str() << endl;
+	}
 
 	return 0;
 }
@@ -604,10 +1028,14 @@ unsigned int DwarfIndexer::visitSubProgram(DwarfIndex &index, Dwarf_Die sp_die,
 	name = getDwarfName(sp_die, dwarf_handle, dwarf_error);
 	offset = getDwarfOffset(sp_die, dwarf_handle, dwarf_error);
 	rettype = getDwarfRefOffset(sp_die, DW_AT_type, dwarf_handle, dwarf_error);
-	cerr << name.c_str() << endl;
+	if (verbose > 1) {
+		cerr << name.c_str() << endl;
+	}
 
 	if (getDwarfPC(sp_die, &lopc, &hipc, dwarf_error) != 0) {
-		cerr << "Warning: could not read lowpc or hipc" << endl;
+		if (verbose > 0) {
+			cerr << "Warning: could not read lowpc or hipc" << endl;
+		}
 		lopc = hipc = 0;
 	}
 
@@ -621,7 +1049,9 @@ unsigned int DwarfIndexer::visitSubProgram(DwarfIndex &index, Dwarf_Die sp_die,
 	unique_name_ss >> fe->unique_id;
 
 	if (getDwarfScriptList(sp_die, DW_AT_frame_base, fe->frame_base, dwarf_handle, dwarf_error, CU_lopc) != 0) {
-		cerr << "Warning: function " << fe->name << " has no frame_base." << endl;
+		if (verbose > 0) {
+			cerr << "Warning: function " << fe->name << " has no frame_base." << endl;
+		}
 	}
 
 	DwarfIndex local_index = { index.types, fe->variables, index.functions };
@@ -691,3 +1121,31 @@ list<FunctionEntry> DwarfIndexer::getFunctions() const {
 
 	return funcs;
 }
+
+const map<Dwarf_Off, FunctionEntry*>& DwarfIndexer::getFunctionTable() const {
+	return functions;
+}
+
+const map<Dwarf_Off, VarEntry*>& DwarfIndexer::getGlobalVariableTable() const {
+	return global_variables;
+}
+
+const vector<UnitEntry*>& DwarfIndexer::getUnitTable() const {
+	return units;
+}
+
+unsigned int DwarfIndexer::getStaticAddress(const VarEntry &ve, Dwarf_Addr *addr) {
+	// a single location for all pcs, getDwarfScriptList stores it as [0, -1)
+	if (ve.location.size() != 1 || ve.location.front().lowpc != 0 ||
+	    (ve.location.front().hipc != 0 && ve.location.front().hipc != (unsigned long long) -1)) {
+		return 1;
+	}
+
+	const DwarfCompiledLocation &compiled = ve.location.front().compiled;
+	if (compiled.kind != LK_Address) {
+		return 2;
+	}
+
+	*addr = compiled.operand;
+	return 0;
+}
@@ -10,7 +10,7 @@
 #include "DwarfIndexer.h"
 #include "ExecutionContext.h"
 
-DwarfMachine::DwarfMachine(const ExecutionContext &econtext, const DwarfScript &s, const FunctionEntry *fe) : context(econtext), script(s),function(fe), state(MS_Executing), instruction(0) {
+DwarfMachine::DwarfMachine(const ExecutionContext &econtext, const DwarfScript &s, const FunctionEntry *fe) : context(econtext), script(s),function(fe), state(MS_Executing), instruction(0), depth(0) {
 }
 
 DwarfMachine::~DwarfMachine() {
@@ -28,7 +28,12 @@ void DwarfMachine::gotoState(enum eMachineState s) {
 }
 
 void DwarfMachine::push(StackValue v) {
-	stack.push(v);
+	if (depth < DWARF_STACK_SIZE) {
+		stack[depth++] = v;
+	} else {
+		cerr << "DWARF stack overflow." << endl;
+		gotoState(MS_Failed);
+	}
 }
 
 void DwarfMachine::push(signed long long n) {
@@ -77,29 +82,30 @@ void DwarfMachine::push(enum eRegister r) {
 }
 
 bool DwarfMachine::hasResult() const {
-	return !stack.empty();
+	return depth > 0;
 }
 
 StackValue DwarfMachine::pop() {
-	StackValue v = stack.top();
-	stack.pop();
-	return v;
+	if (depth == 0) {
+		StackValue v;
+		v.type.encoding = TE_Unsigned;
+		v.type.size = 0;
+		cerr << "DWARF stack underflow." << endl;
+		gotoState(MS_Failed);
+		return v;
+	}
+	return stack[--depth];
 }
 
+// the operations run in order, none of the supported operations branches
 void DwarfMachine::step() {
-	DwarfScript::const_iterator sit;
-
-	instruction++;
-	for (sit = script.begin(); sit != script.end(); sit++) {
-		if (sit->offset == instruction) {
-			op(sit->opcode, sit->operand1, sit->operand2);
-			break;
-		}
-	}
-
-	if (sit == script.end()) {
+	if (instruction >= script.size()) {
 		gotoState(MS_Done);
+		return;
 	}
+
+	const DwarfOperation &operation = script[instruction++];
+	op(operation.opcode, operation.operand1, operation.operand2);
 }
 
 void DwarfMachine::op(unsigned char opcode, unsigned long long operand1, unsigned long long operand2) {
@@ -167,6 +173,66 @@ void DwarfMachine::op(unsigned char opcode, unsigned long long operand1, unsigne
 	}
 }
 
+void DwarfMachine::compile(DwarfLocationScript &location) {
+	DwarfCompiledLocation	&compiled = location.compiled;
+
+	compiled.kind = LK_Interpreted;
+	compiled.reg = EREG_MAX;
+	compiled.operand = 0;
+	if (location.script.size() != 1) {
+		return;
+	}
+
+	const DwarfOperation &operation = location.script[0];
+	// WARNING, this assumes that the reg and breg opcodes are numbered sequentially.
+	if (operation.opcode == DW_OP_addr) {
+		compiled.kind = LK_Address;
+		compiled.operand = operation.operand1;
+	} else if (operation.opcode >= DW_OP_reg0 && operation.opcode <= DW_OP_reg31) {
+		compiled.kind = LK_Register;
+		compiled.reg = (enum eRegister) (operation.opcode - DW_OP_reg0);
+	} else if (operation.opcode >= DW_OP_breg0 && operation.opcode <= DW_OP_breg31) {
+		compiled.kind = LK_RegisterOffset;
+		compiled.reg = (enum eRegister) (operation.opcode - DW_OP_breg0);
+		compiled.operand = operation.operand1;
+	} else if (operation.opcode == DW_OP_fbreg) {
+		compiled.kind = LK_FrameOffset;
+		compiled.operand = operation.operand1;
+	}
+}
+
+const DwarfLocationScript *DwarfMachine::findLocation(const DwarfScriptList &sl, void *ip) {
+	DwarfScriptList::const_iterator slit;
+
+	for (slit = sl.begin(); slit != sl.end(); slit++) {
+		if ((slit->lowpc == 0 && slit->hipc == 0) ||
+		    ((void*) slit->lowpc <= ip && (void*) slit->hipc > ip)) {
+			return &*slit;
+		}
+	}
+	return 0;
+}
+
+unsigned int DwarfMachine::getFrameBase(const ExecutionContext &context, const FunctionEntry *fe, unsigned long *base) {
+	StackValue frame_base;
+
+	if (fe == 0) {
+		return 1;
+	}
+	// a frame base can not refer to itself
+	if (evaluate(context, fe->frame_base, 0, &frame_base) != 0) {
+		return 2;
+	}
+
+	if (frame_base.type.encoding == TE_Address) {
+		*base = (unsigned long) frame_base.address;
+		return 0;
+	} else if (frame_base.type.encoding == TE_Register) {
+		return context.getRegisterValue(frame_base.registerNumber, base) == 0 ? 0 : 3;
+	}
+	return 4;
+}
+
 unsigned int DwarfMachine::evaluateLocation(const ExecutionContext &context, const DwarfScriptList &sl, void **addr, enum eRegister *reg, const struct FunctionEntry *fe) {
 	StackValue result;
 
@@ -194,7 +260,7 @@ unsigned int DwarfMachine::evaluateLocation(const ExecutionContext &context, con
 }
 
 unsigned int DwarfMachine::evaluate(const ExecutionContext &context, const DwarfScriptList &sl, const FunctionEntry *fe, StackValue *result) {
-	DwarfScriptList::const_iterator slit;
+	const DwarfLocationScript *location;
 	void* ip;
 
 	if (sl.empty()) {
@@ -206,18 +272,52 @@ unsigned int DwarfMachine::evaluate(const ExecutionContext &context, const Dwarf
 		return 1;
 	}
 
-	for (slit = sl.begin(); slit != sl.end(); slit++) {
-		if ((slit->lowpc == 0 && slit->hipc == 0) ||
-		    ((void*) slit->lowpc <= ip && (void*) slit->hipc > ip)) {
-			if (evaluate(context, slit->script, fe, result) == 0) {
-				return 0;
-			} else {
-				return 3;
-			}
+	location = findLocation(sl, ip);
+	if (location == 0) {
+		cerr << "No suitable location list entry found. (" << ip << ")" << endl;
+		return 2;
+	}
+	if (evaluate(context, *location, fe, result) == 0) {
+		return 0;
+	} else {
+		return 3;
+	}
+}
+
+unsigned int DwarfMachine::evaluate(const ExecutionContext &context, const DwarfLocationScript &location, const FunctionEntry *fe, StackValue *result) {
+	const DwarfCompiledLocation	&compiled = location.compiled;
+	unsigned long			value;
+
+	switch (compiled.kind) {
+	case LK_Address:
+		result->type.encoding = TE_Address;
+		result->type.size = sizeof(void*);
+		result->address = (void*) compiled.operand;
+		return 0;
+	case LK_Register:
+		result->type.encoding = TE_Register;
+		result->type.size = sizeof(enum eRegister);
+		result->registerNumber = compiled.reg;
+		return 0;
+	case LK_RegisterOffset:
+		if (context.getRegisterValue(compiled.reg, &value) != 0) {
+			return 1;
 		}
-	} 
-	cerr << "No suitable location list entry found. (" << ip << ")" << endl;
-	return 2;
+		result->type.encoding = TE_Address;
+		result->type.size = sizeof(void*);
+		result->address = (void*) (value + compiled.operand);
+		return 0;
+	case LK_FrameOffset:
+		if (getFrameBase(context, fe, &value) != 0) {
+			return 1;
+		}
+		result->type.encoding = TE_Address;
+		result->type.size = sizeof(void*);
+		result->address = (void*) (value + compiled.operand);
+		return 0;
+	default:
+		return evaluate(context, location.script, fe, result);
+	}
 }
 
 unsigned int DwarfMachine::evaluate(const ExecutionContext &context, const DwarfScript &script, const FunctionEntry *fe, StackValue *result) {
@@ -266,11 +366,13 @@ void DwarfMachine::op_bregn(unsigned long long operand1, unsigned long long oper
 
 void DwarfMachine::op_fb_reg(unsigned long long operand1, unsigned long long operand2) {
 	unsigned long frame_base;
-	if (function != 0) {
-		evaluateLocation(context, function->frame_base, (void **) &frame_base, 0, function);
+	if (function == 0) {
+		cerr << "fbreg without a function." << endl;
+		gotoState(MS_Failed);
+	} else if (getFrameBase(context, function, &frame_base) == 0) {
 		push((void*) (frame_base + operand1));	
 	} else {
-		cerr << "fbreg without a function." << endl;
+		cerr << "Failed to evaluate the frame base." << endl;
 		gotoState(MS_Failed);
 	}	
 }
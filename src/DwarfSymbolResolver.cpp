@@ -12,15 +12,21 @@
 #include "DwarfSymbolResolver.h"
 #include "DwarfSymbols.h"
 #include "DwarfIndexer.h"
+#include "SymbolCache.h"
 	
+#include <fcntl.h>
+#include <unistd.h>
+#include <libelf.h>
 #include <string.h>
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 void internal_dwarf_handler(Dwarf_Error err, Dwarf_Ptr arg) {
 }
 
-DwarfSymbolResolver::DwarfSymbolResolver() : current_function(0) {
+DwarfSymbolResolver::DwarfSymbolResolver() : indexer(0), verbose(0), index_thread_count(0), next_index_unit(0), index_threads(0), index_exit(false), cache_loaded(false) {
+	PIN_InitLock(&unit_lock);
 }
 
 DwarfSymbolResolver::~DwarfSymbolResolver() {
@@ -38,53 +44,193 @@ Dwarf_Error* DwarfSymbolResolver::getDwarfError() {
 }
 
 void DwarfSymbolResolver::createIndexer() {
-	indexer = new DwarfIndexer();
+	SymbolCacheReader	cache;
+
+	indexer = new DwarfIndexer(verbose);
+	if (!cache_path.empty() && cache.open(cache_path, cache_key) == 0) {
+		if (indexer->load(cache) == 0) {
+			cache_loaded = true;
+			return;
+		}
+		cerr << "Warning: the symbol cache " << cache_path << " is damaged, indexing again" << endl;
+		delete indexer;
+		indexer = new DwarfIndexer(verbose);
+	}
 	indexer->accept(*getDwarfHandle(), *getDwarfError());
 }
 
-map<unsigned long long, list<VarEntry> > DwarfSymbolResolver::createRelevanceMap(const FunctionEntry &fe) {
-	list<VarEntry>				variables;
-	list<VarEntry>::iterator		vit;
+template <class Interval>
+static bool startsBefore(const Interval &a, const Interval &b) {
+	return a.low < b.low;
+}
 
-	map<unsigned long long, list<VarEntry> >	relevantVariables;
-	if (indexer != 0) {
-		variables = indexer->getVariables(fe);
+template <class Interval>
+static bool addressBefore(Dwarf_Addr addr, const Interval &interval) {
+	return addr < interval.low;
+}
 
-		for (vit = variables.begin(); vit != variables.end(); vit++) {
-			DwarfScriptList::iterator slit;
+// sorts 'sorted' on the addresses and appends it to 'intervals' without overlaps: overlapping
+// addresses (e.g. the same function in several CUs) go to the entry starting first, and of the
+// entries starting at the same address to the first one in the DWARF information, as a linear
+// scan would
+template <class Entry>
+static void addDisjointIntervals(vector<AddressInterval<Entry> > &sorted, vector<AddressInterval<Entry> > &intervals) {
+	typename vector<AddressInterval<Entry> >::iterator	sit;
 
-			for (slit = vit->location.begin(); slit != vit->location.end(); slit++) {
-				if (slit->lowpc == 0 && (slit->hipc == 0 || slit->hipc == (unsigned long long) -1)) {
-					relevantVariables[(unsigned long long) -1].push_back(*vit);
-				} else {
-					for (unsigned long long addr = slit->lowpc; addr < slit->hipc; addr++) {
-						relevantVariables[addr].push_back(*vit);
-					}
-				}
+	stable_sort(sorted.begin(), sorted.end(), startsBefore<AddressInterval<Entry> >);
+
+	for (sit = sorted.begin(); sit != sorted.end(); sit++) {
+		if (!intervals.empty() && sit->low < intervals.back().high) {
+			if (sit->high <= intervals.back().high) {
+				continue;
 			}
+			sit->low = intervals.back().high;
 		}
+		intervals.push_back(*sit);
 	}
-	return relevantVariables;
 }
 
-void DwarfSymbolResolver::createRelevanceMaps() {
-	list<FunctionEntry>		functions;
-	list<FunctionEntry>::iterator	fit;
+// the interval of the disjoint, sorted 'intervals' containing addr, 0 if there is none
+template <class Interval>
+static const Interval *findInterval(const vector<Interval> &intervals, Dwarf_Addr addr) {
+	typename vector<Interval>::const_iterator	it;
+
+	// the interval before the first one starting after addr is the only one that may contain it
+	it = upper_bound(intervals.begin(), intervals.end(), addr, addressBefore<Interval>);
+	if (it != intervals.begin()) {
+		it--;
+		if (addr < it->high) {
+			return &*it;
+		}
+	}
+	return 0;
+}
 
-	if (indexer != 0) {
-		functions = indexer->getFunctions();
+// the units are only indexed when an address in them is resolved, the first unit of the DWARF
+// information gets the addresses of overlapping units
+void DwarfSymbolResolver::createUnitIntervals() {
+	vector<UnitEntry*>::const_iterator		uit;
+	vector<AddressInterval<ResolverUnit> >		sorted;
+
+	if (indexer == 0) {
+		return;
+	}
+
+	units.resize(indexer->getUnitTable().size());
+	for (uit = indexer->getUnitTable().begin(); uit != indexer->getUnitTable().end(); uit++) {
+		ResolverUnit &unit = units[uit - indexer->getUnitTable().begin()];
+		vector<pair<Dwarf_Addr, Dwarf_Addr> >::const_iterator rit;
+
+		unit.unit = *uit;
+		unit.ready = false;
+		for (rit = (*uit)->ranges.begin(); rit != (*uit)->ranges.end(); rit++) {
+			AddressInterval<ResolverUnit> interval = { rit->first, rit->second, &unit };
+			sorted.push_back(interval);
+		}
+		// the units without ranges are indexed already
+		if ((*uit)->indexed) {
+			createFunctionIntervals(unit);
+		}
+	}
+	addDisjointIntervals(sorted, unit_intervals);
+}
+
+void DwarfSymbolResolver::createFunctionIntervals(ResolverUnit &unit) const {
+	vector<FunctionEntry*>::const_iterator		fit;
+	vector<AddressInterval<FunctionEntry> >		sorted;
 
-		for (fit = functions.begin(); fit != functions.end(); fit++) {
-			relevance[fit->unique_id] = createRelevanceMap(*fit);
+	for (fit = unit.unit->functions.begin(); fit != unit.unit->functions.end(); fit++) {
+		if ((*fit)->lopc < (*fit)->hipc) {
+			AddressInterval<FunctionEntry> interval = { (*fit)->lopc, (*fit)->hipc, *fit };
+			sorted.push_back(interval);
 		}
+		createRelevanceMap(**fit, unit.relevance[*fit]);
 	}
+	addDisjointIntervals(sorted, unit.functions);
+
+	// the intervals are complete before other threads see the unit is ready
+	__sync_synchronize();
+	unit.ready = true;
 }
 
-unsigned int DwarfSymbolResolver::createDwarfSymbolResolver(Elf *elf_handle, DwarfSymbolResolver **resolver) {
+// the locations of the globals are evaluated once here, only the few that depend on the
+// context are left for the DwarfMachine
+void DwarfSymbolResolver::createGlobalIntervals() {
+	map<Dwarf_Off, VarEntry*>::const_iterator	vit;
+	vector<AddressInterval<VarEntry> >		sorted;
+	Dwarf_Addr					addr;
+
+	if (indexer == 0) {
+		return;
+	}
+
+	for (vit = indexer->getGlobalVariableTable().begin(); vit != indexer->getGlobalVariableTable().end(); vit++) {
+		if (DwarfIndexer::getStaticAddress(*vit->second, &addr) == 0) {
+			if (vit->second->type.size > 0) {
+				AddressInterval<VarEntry> interval = { addr, addr + vit->second->type.size, vit->second };
+				sorted.push_back(interval);
+			}
+		} else {
+			dynamic_globals.push_back(vit->second);
+		}
+	}
+	addDisjointIntervals(sorted, global_intervals);
+}
+
+// splits the pcs of the function at every start and end of a location of its variables, so every
+// interval lists the variables with a location in all of it, in the order of the DWARF information
+void DwarfSymbolResolver::createRelevanceMap(const FunctionEntry &fe, RelevanceMap &relevant) const {
+	map<Dwarf_Off, VarEntry*>::const_iterator	vit;
+	vector<AddressInterval<VarEntry> >		ranges;
+	vector<AddressInterval<VarEntry> >::iterator	rit;
+	vector<Dwarf_Addr>				bounds;
+
+	for (vit = fe.variables.begin(); vit != fe.variables.end(); vit++) {
+		DwarfScriptList::const_iterator slit;
+
+		for (slit = vit->second->location.begin(); slit != vit->second->location.end(); slit++) {
+			if (slit->lowpc == 0 && (slit->hipc == 0 || slit->hipc == (unsigned long long) -1)) {
+				relevant.always.push_back(vit->second);
+			} else if (slit->lowpc < slit->hipc) {
+				AddressInterval<VarEntry> range = { slit->lowpc, slit->hipc, vit->second };
+				ranges.push_back(range);
+				bounds.push_back(slit->lowpc);
+				bounds.push_back(slit->hipc);
+			}
+		}
+	}
+
+	sort(bounds.begin(), bounds.end());
+	bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+
+	for (size_t b = 0; b + 1 < bounds.size(); b++) {
+		RelevanceInterval interval;
+
+		interval.low = bounds[b];
+		interval.high = bounds[b + 1];
+		for (rit = ranges.begin(); rit != ranges.end(); rit++) {
+			if (rit->low <= interval.low && interval.high <= rit->high) {
+				interval.variables.push_back(rit->entry);
+			}
+		}
+		if (!interval.variables.empty()) {
+			relevant.intervals.push_back(interval);
+		}
+	}
+}
+
+unsigned int DwarfSymbolResolver::createDwarfSymbolResolver(Elf *elf_handle, DwarfSymbolResolver **resolver, unsigned int verbose, const char *cache_dir) {
 	DwarfSymbolResolver *dwarf_resolver = new DwarfSymbolResolver();
 	if (dwarf_resolver == 0) {
 		return 1;
 	}
+	dwarf_resolver->verbose = verbose;
+	if (cache_dir != 0) {
+		dwarf_resolver->cache_key = getSymbolCacheKey(elf_handle);
+		if (!dwarf_resolver->cache_key.empty()) {
+			dwarf_resolver->cache_path = getSymbolCachePath(cache_dir, dwarf_resolver->cache_key, "dwarf");
+		}
+	}
 
 	if (dwarf_elf_init(elf_handle, DW_DLC_READ, &internal_dwarf_handler, 0, dwarf_resolver->getDwarfHandle(), dwarf_resolver->getDwarfError()) != DW_DLV_OK) {
 		delete dwarf_resolver;
@@ -97,7 +243,8 @@ unsigned int DwarfSymbolResolver::createDwarfSymbolResolver(Elf *elf_handle, Dwa
 	}
 
 	dwarf_resolver->createIndexer();
-	dwarf_resolver->createRelevanceMaps();
+	dwarf_resolver->createUnitIntervals();
+	dwarf_resolver->createGlobalIntervals();
      
 	*resolver = dwarf_resolver;
 	return 0;
@@ -147,158 +294,228 @@ const class VariableSymbol *DwarfSymbolResolver::toSymbol(const struct VarEntry
 	return symbol;
 }
 
-unsigned int DwarfSymbolResolver::findFunction(void *addr, FunctionEntry *fe) const {
-	list<FunctionEntry>		functions;
-	list<FunctionEntry>::iterator	fit;
+// the unit with addr in its ranges, its functions are indexed the first time
+unsigned int DwarfSymbolResolver::findUnit(void *addr, const ResolverUnit **unit) const {
+	const AddressInterval<ResolverUnit> *interval = findInterval(unit_intervals, (Dwarf_Addr) addr);
 
-	if (indexer != 0) {
-		functions = indexer->getFunctions();
+	if (interval == 0) {
+		return 1;
+	}
 
-		for (fit = functions.begin(); fit != functions.end(); fit++) {
-			if (fit->lopc <= (Dwarf_Addr) addr && (Dwarf_Addr) addr < fit->hipc) {
-				*fe = *fit;
-				return 0;
-			}
-		}
+	ResolverUnit &found = units[interval->entry - &units[0]];
+	if (!found.ready) {
+		indexUnit(found);
 	}
 
-	return 1;
+	*unit = &found;
+	return 0;
 }
 
-unsigned int DwarfSymbolResolver::findGlobalVariable(const ExecutionContext &context, void *addr, size_t size, struct VarEntry *ve) const {
-	list<VarEntry> 			variables;
-	list<VarEntry>::iterator	vit;
-
-	if (indexer != 0) {
-		variables = indexer->getVariables();
-		
-		for (vit = variables.begin(); vit != variables.end(); vit++) {
-			TypeEntry type = vit->type;
-			void* vaddr;
-			size_t vsize = type.size; 
-			if (DwarfMachine::evaluateLocation(context, vit->location, &vaddr, 0) == 0) {
-				if (addr >= vaddr && addr < vaddr + vsize) {
-					*ve = *vit;
-					return 0;
-				}
-			}
-		}			
+void DwarfSymbolResolver::indexUnit(ResolverUnit &unit) const {
+	PIN_GetLock(&unit_lock, 1);
+	if (!unit.ready) {
+		if (indexer->indexUnit(*unit.unit, dwarf_handle, dwarf_error) != 0 && verbose > 0) {
+			cerr << "Warning: could not index the unit at " << (void*) unit.unit->offset << endl;
+		}
+		createFunctionIntervals(unit);
 	}
-	return 1;
+	PIN_ReleaseLock(&unit_lock);
 }
 
-unsigned int DwarfSymbolResolver::findLocalVariable(const ExecutionContext &context, void *addr, size_t size, const struct FunctionEntry &fe, struct VarEntry *ve) const {
-	void*				ip;	
-	list<VarEntry> 			variables;
-	list<VarEntry>::iterator	vit;
+unsigned int DwarfSymbolResolver::findFunction(void *addr, const FunctionEntry **fe) const {
+	const ResolverUnit			*unit;
+	const AddressInterval<FunctionEntry>	*interval;
 
-	if (context.getInstructionPointer(&ip) != 0) {
-		return 2;
+	if (findUnit(addr, &unit) != 0) {
+		return 1;
 	}
 
-	map<string, map<unsigned long long, list<VarEntry> > >::const_iterator rel_it;
-	rel_it = relevance.find(fe.unique_id);
-	if (rel_it == relevance.end()) {
-		cerr << "No relevance map for " << fe.name << endl;
-		return 3;
+	interval = findInterval(unit->functions, (Dwarf_Addr) addr);
+	if (interval != 0) {
+		*fe = interval->entry;
+		return 0;
 	}
 
-	map<unsigned long long, list<VarEntry> >::const_iterator lrel_it, lrel_it_all;
-	lrel_it = rel_it->second.find((unsigned long long) ip);
-	lrel_it_all = rel_it->second.find((unsigned long long) -1);
+	return 1;
+}
+
+unsigned int DwarfSymbolResolver::findGlobalVariable(const ExecutionContext &context, void *addr, size_t size, struct VarEntry *ve, void **low, void **high) const {
+	list<const VarEntry*>::const_iterator	vit;
+	const AddressInterval<VarEntry>		*global;
 
-	if (lrel_it != rel_it->second.end()) {
-		variables.insert(variables.begin(), lrel_it->second.begin(), lrel_it->second.end());
-	}
-	if (lrel_it_all != rel_it->second.end()) {
-		variables.insert(variables.begin(), lrel_it_all->second.begin(), lrel_it_all->second.end());
+	global = findInterval(global_intervals, (Dwarf_Addr) addr);
+	if (global != 0) {
+		*ve = *global->entry;
+		*low = (void*) global->low;
+		*high = (void*) global->high;
+		return 0;
 	}
-	//variables = DwarfIndexer::getVariables(fe);
-	for (vit = variables.begin(); vit != variables.end(); vit++) {		
+
+	for (vit = dynamic_globals.begin(); vit != dynamic_globals.end(); vit++) {
 		void* vaddr;
-		unsigned int result = DwarfMachine::evaluateLocation(context, vit->location, &vaddr, 0, &fe);
-		// variable is in memory
-		if (result == 0) {
-			TypeEntry type = vit->type;
-			size_t vsize = type.size;
+		size_t vsize = (*vit)->type.size;
+		if (DwarfMachine::evaluateLocation(context, (*vit)->location, &vaddr, 0) == 0) {
 			if (addr >= vaddr && addr < vaddr + vsize) {
-				*ve = *vit;
+				*ve = **vit;
+				*low = vaddr;
+				*high = (char*) vaddr + vsize;
 				return 0;
 			}
 		}
-		// if variable is not in memory and not in a register, it is an error.
-		else if (result != 1) {
-			cerr << "Evaluate failed for " << vit->name << " in " << fe.name << endl; 
-		}
 	}
 	return 1;
 }
 
-void DwarfSymbolResolver::setCurrentFunction(const struct FunctionEntry &fe) {
-	delete current_function;
+// the variables of fe with a location at ip: those with a location at every pc in lists[0], the others
+// in lists[1] (0 if there are none)
+unsigned int DwarfSymbolResolver::findRelevantVariables(const FunctionEntry &fe, void *ip, const vector<const VarEntry*> **lists) const {
+	map<const FunctionEntry*, RelevanceMap>::const_iterator rel_it;
+	const ResolverUnit *unit;
+
+	if (findUnit(ip, &unit) != 0 || (rel_it = unit->relevance.find(&fe)) == unit->relevance.end()) {
+		if (verbose > 0) {
+			cerr << "No relevance map for " << fe.name << endl;
+		}
+		return 1;
+	}
 
-	current_function = new FunctionEntry;
-	*current_function = fe;
+	const RelevanceInterval *interval = findInterval(rel_it->second.intervals, (Dwarf_Addr) ip);
+	lists[0] = &rel_it->second.always;
+	lists[1] = interval != 0 ? &interval->variables : 0;
+	return 0;
 }
 
-const struct FunctionEntry* DwarfSymbolResolver::getCurrentFunction() const {
-	return current_function;
+// the location of ve at ip as base register + offset, from the compiled locations of the variable and
+// the frame base of fe, non-zero if it is not at a fixed offset of a register
+unsigned int DwarfSymbolResolver::getFrameOffset(const FunctionEntry &fe, const VarEntry &ve, void *ip, enum eRegister *base, long long *offset) const {
+	const DwarfLocationScript *location = DwarfMachine::findLocation(ve.location, ip);
+
+	if (location == 0) {
+		return 1;
+	}
+
+	switch (location->compiled.kind) {
+	case LK_RegisterOffset:
+		*base = location->compiled.reg;
+		*offset = (long long) location->compiled.operand;
+		return 0;
+	case LK_FrameOffset: {
+		const DwarfLocationScript *frame_base = DwarfMachine::findLocation(fe.frame_base, ip);
+
+		if (frame_base == 0) {
+			return 2;
+		}
+		if (frame_base->compiled.kind == LK_Register) {
+			*base = frame_base->compiled.reg;
+			*offset = (long long) location->compiled.operand;
+			return 0;
+		}
+		if (frame_base->compiled.kind == LK_RegisterOffset) {
+			*base = frame_base->compiled.reg;
+			*offset = (long long) (frame_base->compiled.operand + location->compiled.operand);
+			return 0;
+		}
+		return 3;
+	}
+	default:
+		return 4;
+	}
 }
 
-// TODO warning, this is very inefficient.
-void DwarfSymbolResolver::storeLocalVariables(const ExecutionContext &context, const struct FunctionEntry &fe) {
-	list<VarEntry> 			variables;
-	list<VarEntry>::iterator	vit;
+unsigned int DwarfSymbolResolver::findLocalVariable(const ExecutionContext &context, void *addr, size_t size, const struct FunctionEntry &fe, struct VarEntry *ve, void **low, void **high) const {
+	void*					ip;	
+	const vector<const VarEntry*>		*variables[2];
+	vector<const VarEntry*>::const_iterator	vit;
 
-	variables = DwarfIndexer::getVariables(fe);
-	for (vit = variables.begin(); vit != variables.end(); vit++) {
-		TypeEntry type = vit->type;
+	if (context.getInstructionPointer(&ip) != 0) {
+		return 2;
+	}
 
-		void* vaddr;
-		size_t vsize = type.size; 
-		if (DwarfMachine::evaluateLocation(context, vit->location, &vaddr, 0, &fe) == 0) {
-			for (unsigned int b = 0; b < vsize; b++) {
-				void *byte_addr = (void*) &((char*) vaddr)[b];
-				cache[byte_addr].push(*vit);
+	if (findRelevantVariables(fe, ip, variables) != 0) {
+		return 3;
+	}
+
+	for (unsigned int l = 0; l < 2 && variables[l] != 0; l++) {
+		for (vit = variables[l]->begin(); vit != variables[l]->end(); vit++) {
+			void* vaddr;
+			unsigned int result = DwarfMachine::evaluateLocation(context, (*vit)->location, &vaddr, 0, &fe);
+			// variable is in memory
+			if (result == 0) {
+				size_t vsize = (*vit)->type.size;
+				if (addr >= vaddr && addr < vaddr + vsize) {
+					*ve = **vit;
+					*low = vaddr;
+					*high = (char*) vaddr + vsize;
+					return 0;
+				}
+			}
+			// if variable is not in memory and not in a register, it is an error.
+			else if (result != 1 && verbose > 0) {
+				cerr << "Evaluate failed for " << (*vit)->name << " in " << fe.name << endl; 
 			}
 		}
 	}
+	return 1;
 }
 
-void DwarfSymbolResolver::removeLocalVariables(const struct FunctionEntry &fe) {
-	map<void*, stack<VarEntry> >::iterator	cache_iterator;
-	
-	for (cache_iterator = cache.begin(); cache_iterator != cache.end(); cache_iterator++) {
-		if (!cache_iterator->second.empty()) {
-			VarEntry ve = cache_iterator->second.top();
-			if (ve.function_id == fe.unique_id) {
-				cache_iterator->second.pop();
-			}
+static unsigned int threadSlot(const ExecutionContext &context) {
+	unsigned int tid;
+
+	return context.getThreadId(&tid) == 0 ? tid : 0;
+}
+
+// every thread only touches its own call stack
+vector<LocalFrame>& DwarfSymbolResolver::getFrames(const ExecutionContext &context) {
+	return frames[threadSlot(context)];
+}
+
+const vector<LocalFrame>& DwarfSymbolResolver::getFrames(const ExecutionContext &context) const {
+	return frames[threadSlot(context)];
+}
+
+void DwarfSymbolResolver::storeLocalVariables(const ExecutionContext &context, LocalFrame &frame) {
+	map<Dwarf_Off, VarEntry*>::const_reverse_iterator	vit;
+	vector<AddressInterval<VarEntry> >			sorted;
+
+	// the variables are added last first, so of the variables sharing a stack slot the last one
+	// in the DWARF information is found, as with the former byte map
+	for (vit = frame.function->variables.rbegin(); vit != frame.function->variables.rend(); vit++) {
+		void* vaddr;
+		size_t vsize = vit->second->type.size;
+		if (vsize > 0 && DwarfMachine::evaluateLocation(context, vit->second->location, &vaddr, 0, frame.function) == 0) {
+			AddressInterval<VarEntry> interval = { (Dwarf_Addr) vaddr, (Dwarf_Addr) vaddr + vsize, vit->second };
+			sorted.push_back(interval);
 		}
 	}
+	frame.locals.clear();
+	addDisjointIntervals(sorted, frame.locals);
 }
 
 unsigned int DwarfSymbolResolver::enterFunction(const ExecutionContext &context, void *addr) {
-	FunctionEntry	fe;
+	const FunctionEntry	*fe;
+	vector<LocalFrame>	&calls = getFrames(context);
 
 	if (findFunction(addr, &fe) != 0) {
 		return 3;
 	}
 
-	cerr << "Entering function " << fe.name << endl;
+	if (verbose > 1) {
+		cerr << "Entering function " << fe->name << endl;
+	}
 
-	const struct FunctionEntry *previous_fe = getCurrentFunction();
-	if (previous_fe != 0) {
-		storeLocalVariables(context, *previous_fe);
+	if (!calls.empty()) {
+		storeLocalVariables(context, calls.back());
 	}
-	setCurrentFunction(fe);
+	calls.push_back(LocalFrame());
+	calls.back().function = fe;
 
 	return 1;
 }
 
 unsigned int DwarfSymbolResolver::leaveFunction(const ExecutionContext &context, void *addr, void *ret_addr) {
-	FunctionEntry	fe;
-	FunctionEntry	rfe;
+	const FunctionEntry	*fe;
+	const FunctionEntry	*rfe;
+	vector<LocalFrame>	&calls = getFrames(context);
 
 	if (findFunction(addr, &fe) != 0) {
 		return 3;
@@ -308,18 +525,30 @@ unsigned int DwarfSymbolResolver::leaveFunction(const ExecutionContext &context,
 		return 4;
 	}
 
-	cerr << "Leaving function " << fe.name << " to " << rfe.name << endl;
-	removeLocalVariables(rfe);
-	setCurrentFunction(rfe);
+	if (verbose > 1) {
+		cerr << "Leaving function " << fe->name << " to " << rfe->name << endl;
+	}
+
+	// normally only the returning frame is popped, more when frames were left without a return
+	// (e.g. longjmp), and if the caller is not on the stack at all it starts over from it
+	while (!calls.empty() && calls.back().function != rfe) {
+		calls.pop_back();
+	}
+	if (calls.empty()) {
+		calls.push_back(LocalFrame());
+		calls.back().function = rfe;
+	}
+	// the locals of the caller are resolved live again
+	calls.back().locals.clear();
 
 	return 1;
 }
 
 unsigned int DwarfSymbolResolver::resolveFunction(const ExecutionContext& context, void *addr, const FunctionSymbol **function) const {
-	FunctionEntry fe;	
+	const FunctionEntry *fe;
 
 	if (findFunction(addr, &fe) == 0) {
-		*function = toSymbol(fe);
+		*function = toSymbol(*fe);
 		return 0;
 	}
 
@@ -327,11 +556,21 @@ unsigned int DwarfSymbolResolver::resolveFunction(const ExecutionContext& contex
 }
 
 unsigned int DwarfSymbolResolver::resolveVariable(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable) const {
-	void 		*ip;
-	VarEntry 	ve;
-	FunctionEntry	fe;
+	void	*low, *high;
+
+	return resolveVariableRange(context, addr, size, variable, &low, &high);
+}
+
+unsigned int DwarfSymbolResolver::resolveVariableRange(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **variable, void **low, void **high) const {
+	void			*ip;
+	VarEntry 		ve;
+	const FunctionEntry	*fe;
+
+	// without a variable, only the accessed bytes are known to have none
+	*low = addr;
+	*high = (char*) addr + size;
 
-	if (findGlobalVariable(context, addr, size, &ve) == 0) {
+	if (findGlobalVariable(context, addr, size, &ve, low, high) == 0) {
 		*variable = toSymbol(ve);
 		return 0;
 	}
@@ -341,22 +580,229 @@ unsigned int DwarfSymbolResolver::resolveVariable(const ExecutionContext& contex
 	}
 
 	if (findFunction(ip, &fe) == 0) {
-		if (findLocalVariable(context, addr, size, fe, &ve) == 0) {
+		if (findLocalVariable(context, addr, size, *fe, &ve, low, high) == 0) {
 			*variable = toSymbol(ve);
 			return 0;
 		}
 	}
 	
-	map<void*, stack<VarEntry> >::const_iterator	cache_iterator;
-
-	cache_iterator = cache.find(addr);
-	if (cache_iterator != cache.end()) {
-		if (!cache_iterator->second.empty()) {
-			ve = cache_iterator->second.top();
-			*variable = toSymbol(ve);
+	// the locals of the callers, innermost first
+	const vector<LocalFrame> &calls = getFrames(context);
+	vector<LocalFrame>::const_reverse_iterator	frit;
+
+	for (frit = calls.rbegin(); frit != calls.rend(); frit++) {
+		const AddressInterval<VarEntry> *local = findInterval(frit->locals, (Dwarf_Addr) addr);
+		if (local != 0) {
+			*variable = toSymbol(*local->entry);
+			*low = (void*) local->low;
+			*high = (void*) local->high;
 			return 0;
 		}
 	}
 
 	return 1;
 }
+
+unsigned int DwarfSymbolResolver::resolveStaticVariable(void *ip, enum eRegister base, long displacement, size_t size, const VariableSymbol **variable) const {
+	const FunctionEntry			*fe;
+	const vector<const VarEntry*>		*variables[2];
+	vector<const VarEntry*>::const_iterator	vit;
+	bool					other_base = false;
+	bool					frame_base = false;	// a variable lives at an offset of 'base'
+
+	if (findFunction(ip, &fe) != 0 || findRelevantVariables(*fe, ip, variables) != 0) {
+		return 2;
+	}
+
+	// the same variables in the same order as findLocalVariable, if the location of one of them is
+	// not a register + offset (e.g. one behind a pointer) it might be the one accessed
+	for (unsigned int l = 0; l < 2 && variables[l] != 0; l++) {
+		for (vit = variables[l]->begin(); vit != variables[l]->end(); vit++) {
+			enum eRegister	vbase;
+			long long	voffset;
+			const DwarfLocationScript *location = DwarfMachine::findLocation((*vit)->location, ip);
+
+			// not at ip, in a register or at a fixed address: not at the operand
+			if (location == 0 || location->compiled.kind == LK_Register || location->compiled.kind == LK_Address) {
+				continue;
+			}
+			if (getFrameOffset(*fe, **vit, ip, &vbase, &voffset) != 0) {
+				return 3;
+			}
+			// relative to the other register (e.g. [esp+k] in a function with a frame pointer), the
+			// distance between the two registers is only known when the instruction executes
+			if (vbase != base) {
+				other_base = true;
+				continue;
+			}
+			frame_base = true;
+			if (voffset <= displacement && displacement < voffset + (long long) (*vit)->type.size) {
+				*variable = toSymbol(**vit);
+				return 0;
+			}
+		}
+	}
+	if (other_base) {
+		return 4;
+	}
+	// without a variable relative to 'base' it is not known to be the frame register of the function
+	// (e.g. ebp used as a general purpose register with -fomit-frame-pointer)
+	return frame_base ? 1 : 5;
+}
+
+VOID DwarfSymbolResolver::indexThread(VOID *arg) {
+	((DwarfSymbolResolver*) arg)->runIndexThread();
+}
+
+// libdwarf is not thread safe, so every thread parses the units with its own handles into its own
+// indexer, and only merges a unit into the shared tables under the lock
+void DwarfSymbolResolver::runIndexThread() {
+	int		fd;
+	Elf		*elf;
+	Dwarf_Debug	handle;
+	Dwarf_Error	error;
+	DwarfIndexer	partial(verbose);
+	unsigned int	u;
+
+	if ((fd = open(image.c_str(), O_RDONLY)) < 0) {
+		cerr << "Warning: the DWARF index thread can not open " << image << endl;
+	} else {
+		if ((elf = elf_begin(fd, ELF_C_READ, NULL)) != NULL) {
+			if (dwarf_elf_init(elf, DW_DLC_READ, &internal_dwarf_handler, 0, &handle, &error) == DW_DLV_OK) {
+				while (!index_exit && (u = __sync_fetch_and_add(&next_index_unit, 1)) < units.size()) {
+					ResolverUnit	&unit = units[u];
+					UnitEntry	part;
+
+					if (unit.ready) {
+						continue;
+					}
+					part.offset = unit.unit->offset;
+					part.end = unit.unit->end;
+					part.indexed = false;
+					partial.parseUnit(part, handle, error);
+
+					PIN_GetLock(&unit_lock, 1);
+					if (indexer->mergeUnit(*unit.unit, partial) == 0) {
+						createFunctionIntervals(unit);
+					}
+					PIN_ReleaseLock(&unit_lock);
+				}
+				dwarf_finish(handle, &error);
+			}
+			elf_end(elf);
+		}
+		close(fd);
+	}
+	__sync_fetch_and_sub(&index_threads, 1);
+}
+
+unsigned int DwarfSymbolResolver::startIndexThreads(const char *filename, unsigned int threads) {
+	PIN_THREAD_UID	uid;
+
+	// all units of a cached index are indexed already
+	if (cache_loaded) {
+		return 0;
+	}
+	image = filename;
+	index_thread_count = 0;
+	index_exit = false;
+	for (unsigned int t = 0; t < threads; t++) {
+		__sync_fetch_and_add(&index_threads, 1);
+		if (PIN_SpawnInternalThread(indexThread, this, DEFAULT_THREAD_STACK_SIZE, &uid) == INVALID_THREADID) {
+			__sync_fetch_and_sub(&index_threads, 1);
+			cerr << "Can not spawn DWARF index thread " << t << endl;
+			return 1;
+		}
+		index_thread_count++;
+	}
+	return 0;
+}
+
+void DwarfSymbolResolver::stopIndexThreads() {
+	index_exit = true;
+	while (index_threads > 0) {
+		PIN_Sleep(1);
+	}
+}
+
+void DwarfSymbolResolver::quiesceIndexThreads() {
+	PIN_GetLock(&unit_lock, 1);
+}
+
+void DwarfSymbolResolver::resumeIndexThreads() {
+	PIN_ReleaseLock(&unit_lock);
+}
+
+// the threads of the parent do not exist in the child, the units they were parsing are indexed again
+void DwarfSymbolResolver::restartIndexThreads() {
+	PIN_InitLock(&unit_lock);
+	index_threads = 0;
+	if (index_thread_count > 0 && !index_exit) {
+		next_index_unit = 0;
+		startIndexThreads(image.c_str(), index_thread_count);
+	}
+}
+
+// the overhead of a node of a std::map or std::set: the links and the color
+#define MAP_NODE_BYTES (4 * sizeof(void*))
+
+size_t DwarfSymbolResolver::memoryUsage() const {
+	map<const FunctionEntry*, RelevanceMap>::const_iterator	rel_it;
+	vector<RelevanceInterval>::const_iterator		iit;
+	vector<ResolverUnit>::const_iterator			uit;
+	size_t	bytes = 0;
+
+	bytes += units.capacity() * sizeof(ResolverUnit);
+	bytes += unit_intervals.capacity() * sizeof(AddressInterval<ResolverUnit>);
+	bytes += global_intervals.capacity() * sizeof(AddressInterval<VarEntry>);
+	bytes += dynamic_globals.size() * 3 * sizeof(void*);
+	// the frames of the other threads change while they run, assume a few locals per frame
+	for (unsigned int t = 0; t < frames.size(); t++) {
+		const vector<LocalFrame>	*stack = frames.find(t);
+
+		if (stack != 0) {
+			bytes += stack->capacity() * (sizeof(LocalFrame) + 4 * sizeof(AddressInterval<VarEntry>));
+		}
+	}
+	bytes += functionSymbols.size() * (MAP_NODE_BYTES + sizeof(string) + sizeof(FunctionSymbol*) + sizeof(DwarfFunctionSymbol));
+	bytes += variableSymbols.size() * (MAP_NODE_BYTES + sizeof(string) + sizeof(VariableSymbol*) + sizeof(DwarfVariableSymbol));
+	// only the units indexed so far, the others may be indexed meanwhile
+	for (uit = units.begin(); uit != units.end(); uit++) {
+		if (!uit->ready) {
+			continue;
+		}
+		bytes += uit->functions.capacity() * sizeof(AddressInterval<FunctionEntry>);
+		for (rel_it = uit->relevance.begin(); rel_it != uit->relevance.end(); rel_it++) {
+			bytes += MAP_NODE_BYTES + sizeof(*rel_it);
+			bytes += rel_it->second.always.capacity() * sizeof(VarEntry*);
+			bytes += rel_it->second.intervals.capacity() * sizeof(RelevanceInterval);
+			for (iit = rel_it->second.intervals.begin(); iit != rel_it->second.intervals.end(); iit++) {
+				bytes += iit->variables.capacity() * sizeof(VarEntry*);
+			}
+		}
+	}
+	return bytes;
+}
+
+// the cache holds complete indexes only, so the units no address was resolved in are indexed now
+unsigned int DwarfSymbolResolver::saveIndexCache() {
+	vector<ResolverUnit>::iterator	uit;
+
+	if (cache_path.empty() || cache_loaded || indexer == 0) {
+		return 0;
+	}
+
+	for (uit = units.begin(); uit != units.end(); uit++) {
+		if (!uit->ready) {
+			indexUnit(*uit);
+		}
+	}
+
+	SymbolCacheWriter cache(cache_path, cache_key);
+	indexer->save(cache);
+	if (cache.close() != 0) {
+		cerr << "Warning: can not write the symbol cache " << cache_path << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -16,20 +16,13 @@
 #include <stdio.h>
 
 #include "ElfSymbolResolver.h"
+#include "SymbolCache.h"
 #include "gelf.h"
 
-ElfFunctionSymbol::ElfFunctionSymbol(const ElfFunctionSymbol& other) {
-	void *low, *high;
-	other.getName(symbol_name, 128);
-	other.getAddressRange(&low, &high);
-	symbol_address = low;
-	symbol_size = ((char*) high - (char*) low);
+ElfFunctionSymbol::ElfFunctionSymbol(const ElfFunctionSymbol& other) : symbol_name(other.symbol_name), symbol_address(other.symbol_address), symbol_size(other.symbol_size) {
 }
 
-ElfFunctionSymbol::ElfFunctionSymbol(const char *name, void *addr, size_t size) {
-	strncpy(symbol_name, name, 128);
-	symbol_address = addr;
-	symbol_size = size;
+ElfFunctionSymbol::ElfFunctionSymbol(const char *name, void *addr, size_t size) : symbol_name(name), symbol_address(addr), symbol_size(size) {
 }
 
 ElfFunctionSymbol::~ElfFunctionSymbol() {
@@ -46,13 +39,13 @@ unsigned int ElfFunctionSymbol::getAddressRange(void **low, void **high) const {
 }
 
 unsigned int ElfFunctionSymbol::getName(char *buffer, size_t size) const {
-	size_t len = strlen(symbol_name);
+	size_t len = symbol_name.size();
 	if (buffer == NULL) {
 		return len;
 	} else {
 		size_t min = len < (size - 1) ? len : (size - 1);
 
-		strncpy(buffer, symbol_name, min);
+		memcpy(buffer, symbol_name.c_str(), min);
 		buffer[min] = '\0';
 
 		return min;
@@ -63,18 +56,10 @@ unsigned int ElfFunctionSymbol::getReturnType(const Type **type) const {
 	return 1;
 }
 
-ElfVariableSymbol::ElfVariableSymbol(const ElfVariableSymbol& other) {
-	void *low, *high;
-	other.getName(symbol_name, 128);
-	other.getAddressRange(&low, &high);
-	symbol_address = low;
-	symbol_size = ((char*) high - (char*) low);
+ElfVariableSymbol::ElfVariableSymbol(const ElfVariableSymbol& other) : symbol_name(other.symbol_name), symbol_address(other.symbol_address), symbol_size(other.symbol_size) {
 }
 
-ElfVariableSymbol::ElfVariableSymbol(const char *name, void *addr, size_t size) {
-	strncpy(symbol_name, name, 128);
-	symbol_address = addr;
-	symbol_size = size;
+ElfVariableSymbol::ElfVariableSymbol(const char *name, void *addr, size_t size) : symbol_name(name), symbol_address(addr), symbol_size(size) {
 }
 
 ElfVariableSymbol::~ElfVariableSymbol() {
@@ -99,13 +84,13 @@ unsigned int ElfVariableSymbol::getAddressRange(void **low, void **high) const {
 }
 
 unsigned int ElfVariableSymbol::getName(char *buffer, size_t size) const {
-	size_t len = strlen(symbol_name);
+	size_t len = symbol_name.size();
 	if (buffer == NULL) {
 		return len;
 	} else {
 		size_t min = len < (size - 1) ? len : (size - 1);
 
-		strncpy(buffer, symbol_name, min);
+		memcpy(buffer, symbol_name.c_str(), min);
 		buffer[min] = '\0';
 
 		return min;
@@ -131,7 +116,7 @@ ElfSymbolResolver::~ElfSymbolResolver() {
 	}
 }
 
-unsigned int ElfSymbolResolver::createElfSymbolResolver(ElfSymbolResolver **resolver, const char *filename) {
+unsigned int ElfSymbolResolver::createElfSymbolResolver(ElfSymbolResolver **resolver, const char *filename, const char *cache_dir) {
 	int			elf_fd;
 	Elf 			*elf_handle;
 	Elf_Scn			*elf_scn 	= NULL;
@@ -141,6 +126,8 @@ unsigned int ElfSymbolResolver::createElfSymbolResolver(ElfSymbolResolver **reso
 	ElfSymbolResolver 	*instance;
 	int			symbol_count	= 0;
 	int			i 		= 0;
+	string			cache_key, cache_path;
+	bool			cached		= false;
 	
 	if (elf_version(EV_CURRENT) == EV_NONE) {
 		return 1; // failed to initialize libelf
@@ -164,7 +151,18 @@ unsigned int ElfSymbolResolver::createElfSymbolResolver(ElfSymbolResolver **reso
 		return 4; // failed to allocate instance
 	}
 
-	while ((elf_scn = elf_nextscn(elf_handle, elf_scn)) != NULL) {
+	if (cache_dir != 0 && !(cache_key = getSymbolCacheKey(elf_handle)).empty()) {
+		cache_path = getSymbolCachePath(cache_dir, cache_key, "elf");
+		if (instance->loadCache(cache_path, cache_key) == 0) {
+			cached = true;
+		} else {
+			// a damaged file may have left some symbols behind
+			delete instance;
+			instance = new ElfSymbolResolver();
+		}
+	}
+
+	while (!cached && (elf_scn = elf_nextscn(elf_handle, elf_scn)) != NULL) {
 		if (gelf_getshdr(elf_scn, &elf_shdr) != &elf_shdr) {
 			delete instance;
 			elf_end(elf_handle);
@@ -188,16 +186,16 @@ unsigned int ElfSymbolResolver::createElfSymbolResolver(ElfSymbolResolver **reso
 					if (ELF32_ST_BIND(elf_symbol.st_info) == STB_GLOBAL && elf_symbol.st_size > 0) {
 						if (ELF32_ST_TYPE(elf_symbol.st_info) == STT_OBJECT) {
 							const char *variable_name = elf_strptr(elf_handle, elf_shdr.sh_link, elf_symbol.st_name);
-							if (variable_name != 0) {
-								printf("variable: %s (%lu)\n", variable_name, (unsigned long int) elf_symbol.st_size);
+							if (variable_name == 0) {
+								continue;
 							}
 
 							ElfVariableSymbol* v = new ElfVariableSymbol(variable_name, (void *) elf_symbol.st_value, (size_t) elf_symbol.st_size);
 							instance->addVariable(v);
 						} else if (ELF32_ST_TYPE(elf_symbol.st_info) == STT_FUNC) {
 							const char *function_name = elf_strptr(elf_handle, elf_shdr.sh_link, elf_symbol.st_name);
-							if (function_name != 0) {
-								printf("function: %s (%#x - %#x)\n", function_name, (unsigned int) elf_symbol.st_value, (unsigned int) elf_symbol.st_size);
+							if (function_name == 0) {
+								continue;
 							}
 
 							ElfFunctionSymbol* f = new ElfFunctionSymbol(function_name, (void *) elf_symbol.st_value, (size_t) elf_symbol.st_size);
@@ -209,6 +207,10 @@ unsigned int ElfSymbolResolver::createElfSymbolResolver(ElfSymbolResolver **reso
 		}
 	}
 
+	if (!cached && !cache_path.empty() && instance->saveCache(cache_path, cache_key) != 0) {
+		fprintf(stderr, "Warning: can not write the symbol cache %s\n", cache_path.c_str());
+	}
+
 	if (resolver != 0) {
 		*resolver = instance;
 	} else {
@@ -231,6 +233,57 @@ unsigned int ElfSymbolResolver::addVariable(ElfVariableSymbol *vs) {
 	return 0;
 }
 
+// the functions and then the variables, each as its name, address and size
+unsigned int ElfSymbolResolver::loadCache(const string &path, const string &key) {
+	SymbolCacheReader	cache;
+	unsigned long long	count;
+
+	if (cache.open(path, key) != 0) {
+		return 1;
+	}
+
+	for (count = cache.getNumber(); count > 0 && cache.ok(); count--) {
+		string name = cache.getName();
+		void *addr = (void*) (unsigned long) cache.getNumber();
+		addFunction(new ElfFunctionSymbol(name.c_str(), addr, (size_t) cache.getNumber()));
+	}
+	for (count = cache.getNumber(); count > 0 && cache.ok(); count--) {
+		string name = cache.getName();
+		void *addr = (void*) (unsigned long) cache.getNumber();
+		addVariable(new ElfVariableSymbol(name.c_str(), addr, (size_t) cache.getNumber()));
+	}
+	return cache.ok() ? 0 : 2;
+}
+
+unsigned int ElfSymbolResolver::saveCache(const string &path, const string &key) const {
+	SymbolCacheWriter	cache(path, key);
+	void			*low, *high;
+
+	cache.putNumber(functions.size());
+	for (vector<ElfFunctionSymbol*>::const_iterator fit = functions.begin(); fit != functions.end(); fit++) {
+		(*fit)->getAddressRange(&low, &high);
+		cache.putName((*fit)->symbol_name);
+		cache.putNumber((unsigned long) low);
+		cache.putNumber((char*) high - (char*) low);
+	}
+	cache.putNumber(variables.size());
+	for (vector<ElfVariableSymbol*>::const_iterator vit = variables.begin(); vit != variables.end(); vit++) {
+		(*vit)->getAddressRange(&low, &high);
+		cache.putName((*vit)->symbol_name);
+		cache.putNumber((unsigned long) low);
+		cache.putNumber((char*) high - (char*) low);
+	}
+	return cache.close();
+}
+
+unsigned int ElfSymbolResolver::enterFunction(const class ExecutionContext &context, void *addr) {
+	return 0;
+}
+
+unsigned int ElfSymbolResolver::leaveFunction(const class ExecutionContext &context, void *addr, void *ret_addr) {
+	return 0;
+}
+
 unsigned int ElfSymbolResolver::resolveFunction(const ExecutionContext& context, void *addr, const FunctionSymbol **result) const {
 	vector<ElfFunctionSymbol*>::const_iterator it;
 	void *low, *high;
@@ -252,14 +305,19 @@ unsigned int ElfSymbolResolver::resolveFunction(const ExecutionContext& context,
 }
 
 unsigned int ElfSymbolResolver::resolveVariable(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **result) const {
-	vector<ElfVariableSymbol*>::const_iterator it;
 	void *low, *high;
 
+	return resolveVariableRange(context, addr, size, result, &low, &high);
+}
+
+unsigned int ElfSymbolResolver::resolveVariableRange(const ExecutionContext& context, void *addr, size_t size, const VariableSymbol **result, void **low, void **high) const {
+	vector<ElfVariableSymbol*>::const_iterator it;
+
 	for (it = variables.begin(); it != variables.end(); it++) {
 		ElfVariableSymbol* variable = *it;	
 
-		if (variable->getAddressRange(&low, &high) == 0) {
-			if (low <= addr && ((char *) addr) + size <= high) {
+		if (variable->getAddressRange(low, high) == 0) {
+			if (*low <= addr && ((char *) addr) + size <= *high) {
 				if (result != NULL) {
 					*result = new ElfVariableSymbol(*variable);
 					return 0;
@@ -268,5 +326,7 @@ unsigned int ElfSymbolResolver::resolveVariable(const ExecutionContext& context,
 		}
 	}
 	
+	*low = addr;
+	*high = (char*) addr + size;
 	return 1;
 }
@@ -0,0 +1,368 @@
+/*
+ * Engine.cpp
+ *
+ * This file contains the member functions of the Engine class, the interface of
+ * the tracing engine in tracing.cpp.
+ *
+ */
+
+#include <iostream>
+
+#include "Engine.h"
+#include "tracing.h"
+#include "Utility.h"
+#include "SelfProfile.h"
+#include "HyperLogLog.h"
+#include "ThreadTable.h"
+
+#define CALL_COUNT_BLOCK 4096
+#define MAX_CALL_COUNT_BLOCKS 256
+
+// the call stacks of the application threads, indexed by thread id
+static ThreadTable<vector<ADDRINT>*> Call_Stacks;
+// the accesses of every application thread so far, for the access sampling
+static ThreadTable<UINT64> Access_Counts;
+static ADDRINT Bottom_Function = 1;
+
+// the number of calls of every function id, in blocks which never move once they are
+// allocated, so the counters can be incremented while new functions are defined
+static UINT64 *Call_Counts[MAX_CALL_COUNT_BLOCKS];
+
+EngineOptions::EngineOptions()
+	:bbFuncCount(FALSE), showBytes(TRUE), showUnDVs(TRUE), showRanges(TRUE), rangesLimit(3),
+	showVariables(FALSE), variableCount(5), granularity(1), samplePages(1), sampleAccesses(1),
+	unmaSketchBits(0)
+{
+}
+
+Engine::Engine()
+	:m_started(FALSE), m_memoryLimit(0), m_otherBytes(0), m_degradation(ENGINE_FULL)
+{
+}
+
+int Engine::start(const string &xmlFile, const string &application, unsigned int shards, unsigned int reportThreads)
+{
+	string ns("q2:");
+
+	// the blocks may not cross the stripes of the shards (4 KB)
+	if (m_options.granularity == 0 || m_options.granularity > 4096 ||
+		(m_options.granularity & (m_options.granularity - 1)))
+	{
+		cerr << "The granularity has to be a power of two up to 4096 bytes (not " << m_options.granularity << ")" << endl;
+		return 1;
+	}
+
+	if (m_options.samplePages == 0 || m_options.sampleAccesses == 0 ||
+		(m_options.samplePages > 1 && m_options.sampleAccesses > 1))
+	{
+		cerr << "The accesses can be sampled by page or by access, not both" << endl;
+		return 1;
+	}
+
+	if (m_options.unmaSketchBits != 0 &&
+		(m_options.unmaSketchBits < HLL_MIN_BITS || m_options.unmaSketchBits > HLL_MAX_BITS))
+	{
+		cerr << "The UnMA sketches have " << HLL_MIN_BITS << " to " << HLL_MAX_BITS << " bits" << endl;
+		return 1;
+	}
+
+	q2xml = new Q2XMLFile(xmlFile, ns, application);
+	if (InitShards(shards) || InitReportThreads(reportThreads))
+		return 1;
+	m_started = TRUE;
+	return 0;
+}
+
+void Engine::setOptions(const EngineOptions &options)
+{
+	m_options = options;
+	BB_Func_Count = options.bbFuncCount;
+	Dot_Show_Bytes = options.showBytes;
+	Dot_Show_UnDVs = options.showUnDVs;
+	Dot_Show_Ranges = options.showRanges;
+	Dot_Show_Ranges_Limit = options.rangesLimit;
+	Show_Variables = options.showVariables;
+	Variable_Count = options.variableCount;
+	Granularity = options.granularity;
+	Sample_Pages = options.samplePages;
+	Sample_Accesses = options.sampleAccesses;
+	UnMA_Sketch_Bits = options.unmaSketchBits;
+	for (Granularity_Shift = 0; (1U << Granularity_Shift) < Granularity; Granularity_Shift++)
+		;
+}
+
+const EngineOptions &Engine::options() const
+{
+	return m_options;
+}
+
+/* ===================================================================== */
+
+void Engine::defineFunction(ADDRINT id, const string &name)
+{
+	ADDtoName[id] = name;
+
+	if (id / CALL_COUNT_BLOCK < MAX_CALL_COUNT_BLOCKS && !Call_Counts[id / CALL_COUNT_BLOCK])
+		Call_Counts[id / CALL_COUNT_BLOCK] = new UINT64[CALL_COUNT_BLOCK]();
+}
+
+const string &Engine::functionName(ADDRINT id)
+{
+	return ADDtoName[id];
+}
+
+const map<ADDRINT, string> &Engine::functions() const
+{
+	return ADDtoName;
+}
+
+void Engine::defineBasicBlock(const string &name, const string &function)
+{
+	if (NameToFunction.find(name) == NameToFunction.end())
+		NameToFunction[name] = function;
+}
+
+void Engine::defineGlobalSymbol(const string &name, ADDRINT start, ADDRINT size)
+{
+	globalSymbols[name] = new GlobalSymbol(start, size);
+}
+
+void Engine::addNote(const string &note)
+{
+	Report_Notes.push_back(note);
+}
+
+void Engine::monitor(const string &function)
+{
+	TTL_ML_Data_Pack *DPP = new TTL_ML_Data_Pack;
+
+	DPP->total_IN_ML=0;
+	DPP->total_OUT_ML=0;
+	DPP->total_IN_ML_UMA=0;
+	DPP->total_OUT_ML_UMA=0;
+	DPP->total_IN_ALL=0;
+	DPP->total_OUT_ALL=0;
+	DPP->total_IN_ALL_UMA=0;
+	DPP->total_OUT_ALL_UMA=0;
+
+	delete ML_OUTPUT[function];
+	ML_OUTPUT[function] = DPP;
+	Monitor_ON = TRUE;
+}
+
+/* ===================================================================== */
+
+void Engine::setBottomFunction(ADDRINT func)
+{
+	Bottom_Function = func;
+}
+
+const vector<ADDRINT> &Engine::callStack(THREADID tid)
+{
+	vector<ADDRINT> *&stack = Call_Stacks[tid];
+
+	if (!stack)
+		stack = new vector<ADDRINT>(1, Bottom_Function);
+	return *stack;
+}
+
+void Engine::onEnter(THREADID tid, ADDRINT func, BOOL counted)
+{
+	callStack(tid);
+	Call_Stacks[tid]->push_back(func);
+	GetThreadProfile(tid)->counters[SP_CALLS]++;
+
+	if (counted && func / CALL_COUNT_BLOCK < MAX_CALL_COUNT_BLOCKS && Call_Counts[func / CALL_COUNT_BLOCK])
+		Call_Counts[func / CALL_COUNT_BLOCK][func % CALL_COUNT_BLOCK]++;
+}
+
+void Engine::onExit(THREADID tid, UINT32 frames)
+{
+	vector<ADDRINT> *stack = Call_Stacks[tid];
+
+	// the bottom of the stack is never left
+	while (stack && frames-- > 0 && stack->size() > 1)
+	{
+		stack->pop_back();
+		GetThreadProfile(tid)->counters[SP_FRAMES_POPPED]++;
+	}
+}
+
+ADDRINT Engine::currentFunction(THREADID tid)
+{
+	return callStack(tid).back();
+}
+
+/* ===================================================================== */
+
+int Engine::onWrite(THREADID tid, ADDRINT addr, UINT32 size, const VariableSymbol *symbol)
+{
+	return onAccess(addr, size, currentFunction(tid), symbol, TRUE);
+}
+
+int Engine::onRead(THREADID tid, ADDRINT addr, UINT32 size, const VariableSymbol *symbol)
+{
+	return onAccess(addr, size, currentFunction(tid), symbol, FALSE);
+}
+
+// a page (of 4 KB) is sampled when its hash falls in the first 1/Sample_Pages of the hash values,
+// so a run samples the same pages for all the functions, and strided data is not sampled in step
+static inline BOOL PageSampled(ADDRINT addr)
+{
+	return pageHash(addr) % Sample_Pages == 0;
+}
+
+BOOL Engine::samples(THREADID tid, ADDRINT addr, UINT32 size)
+{
+	// every thread counts its own accesses, so a run samples the same ones of every thread
+	if (Sample_Accesses > 1)
+		return Access_Counts[tid]++ % Sample_Accesses == 0;
+	if (Sample_Pages > 1)
+		return PageSampled(addr) || (size > 0 && PageSampled(addr + size - 1));
+	return TRUE;
+}
+
+int Engine::onAccess(ADDRINT addr, UINT32 size, ADDRINT func, const VariableSymbol *symbol, BOOL write)
+{
+	if (Analysis_Stopped || size == 0)
+		return 0;
+
+	// every block of the granularity has its own producer, an access partially covering a
+	// block is recorded with the bytes it covers
+	ADDRINT end = addr + size;
+	for (ADDRINT block = addr & ~(ADDRINT)(Granularity - 1); block < end; block += Granularity)
+	{
+		ADDRINT low = block < addr ? addr : block;
+		ADDRINT high = block + Granularity < end ? block + Granularity : end;
+		if (Sample_Pages > 1 && !PageSampled(block))
+			continue;
+		if (RecordMemoryAccess(block, high - low, func, symbol, write))
+			return 1;
+	}
+	// a shard grew by MEMORY_CHECK_BYTES, one application thread compares the memory with the limit
+	if (Memory_Check_Due && __sync_bool_compare_and_swap(&Memory_Check_Due, TRUE, FALSE))
+		checkMemory(m_otherBytes);
+	return 0;
+}
+
+ADDRINT Engine::lastWriter(ADDRINT addr)
+{
+	return LookupLastWrite(addr);
+}
+
+/* ===================================================================== */
+
+void Engine::quiesce(THREADID tid)
+{
+	if (m_started)
+		QuiesceShards(tid);
+}
+
+void Engine::restart(const string &suffix, const string &xmlFile, const string &application)
+{
+	string ns("q2:");
+
+	Output_Suffix = suffix;
+	if (!m_started)
+		return;
+
+	RestartShardWorkers();
+	ResetBindings();
+	ResetSelfProfile();
+
+	for (unsigned int b=0; b<MAX_CALL_COUNT_BLOCKS; b++)
+		if (Call_Counts[b])
+			for (unsigned int i=0; i<CALL_COUNT_BLOCK; i++)
+				Call_Counts[b][i] = 0;
+
+	delete q2xml;
+	q2xml = new Q2XMLFile(suffixFileName(xmlFile, suffix), ns, application);
+}
+
+int Engine::prepareReport()
+{
+	int status = 0;
+	UINT64 start = SelfTimerStart();
+
+	if (m_started)
+	{
+		// the reports look the call counts up by name
+		map<ADDRINT, string>::const_iterator it;
+		for (it = ADDtoName.begin(); it != ADDtoName.end(); it++)
+			if (it->first / CALL_COUNT_BLOCK < MAX_CALL_COUNT_BLOCKS && Call_Counts[it->first / CALL_COUNT_BLOCK])
+				FunctionToCount[it->second] = Call_Counts[it->first / CALL_COUNT_BLOCK][it->first % CALL_COUNT_BLOCK];
+		status = PrepareReport();
+	}
+	StopReportThreads();
+	SelfTimerStop(GetThreadProfile(PIN_ThreadId()), ST_REPORT, start);
+	return status;
+}
+
+int Engine::report()
+{
+	if (!m_started)
+		return 1;
+
+	UINT64 start;
+	int status = 0;
+
+	prepareReport();
+	start = SelfTimerStart();
+	if (CreateDSGraphFile())
+	{
+		cerr << "Can not create the QDU graph..." << endl;
+		status = 1;
+	}
+	else if (Monitor_ON && CreateTotalStatFile())
+		status = 1;
+	SelfTimerStop(GetThreadProfile(PIN_ThreadId()), ST_REPORT, start);
+	return status;
+}
+
+void Engine::stop()
+{
+	StopReportThreads();
+	StopShards();
+}
+
+void Engine::statistics(EngineStatistics &stats)
+{
+	if (m_started)
+		ShardStatistics(&stats.shadowBytes, &stats.bindingBytes, &stats.unmaBytes, &stats.bindings, &stats.communications);
+	else
+		stats.shadowBytes = stats.bindingBytes = stats.unmaBytes = stats.bindings = stats.communications = 0;
+}
+
+void Engine::setMemoryLimit(UINT64 bytes)
+{
+	m_memoryLimit = bytes;
+}
+
+EngineDegradation Engine::checkMemory(UINT64 otherBytes)
+{
+	EngineStatistics stats;
+	UINT64 total;
+
+	m_otherBytes = otherBytes;
+	if (!m_started || m_memoryLimit == 0)
+		return m_degradation;
+
+	statistics(stats);
+	total = stats.shadowBytes + stats.bindingBytes + stats.unmaBytes + otherBytes;
+
+	if (m_degradation < ENGINE_NO_UNMA_SETS && total >= m_memoryLimit)
+	{
+		cerr << "\nQUAD uses " << (total >> 20) << " MB, more than its limit of " << (m_memoryLimit >> 20)
+			<< " MB: the unique addresses are not collected anymore, the UnMA counts become lower bounds..." << endl;
+		Unique_Cells_Dropped = TRUE;
+		m_degradation = ENGINE_NO_UNMA_SETS;
+	}
+	if (m_degradation < ENGINE_STOPPED && total >= m_memoryLimit + m_memoryLimit / 4)
+	{
+		cerr << "\nQUAD uses " << (total >> 20) << " MB, 25% more than its limit of " << (m_memoryLimit >> 20)
+			<< " MB: the analysis is stopped, the reports only hold the accesses so far..." << endl;
+		Analysis_Stopped = TRUE;
+		m_degradation = ENGINE_STOPPED;
+	}
+	return m_degradation;
+}
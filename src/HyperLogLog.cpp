@@ -0,0 +1,94 @@
+/*
+ * File : HyperLogLog.cpp
+ *
+ * This file contains the member functions of the HyperLogLog class (Flajolet et al.,
+ * "HyperLogLog: the analysis of a near-optimal cardinality estimation algorithm", 2007),
+ * with the linear counting correction for small numbers of addresses.
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include "HyperLogLog.h"
+
+HyperLogLog::HyperLogLog(unsigned int bits)
+{
+	Bits = bits;
+	Count = 1U << bits;
+	Registers = new unsigned char[Count];
+	memset(Registers, 0, Count);
+}
+
+HyperLogLog::~HyperLogLog()
+{
+	delete [] Registers;
+}
+
+/*
+The addresses are hashed with the finalizer of MurmurHash3, the low Bits bits of the hash
+select the register, which keeps the longest run of leading zeros (+1) seen in the rest.
+*/
+void HyperLogLog::insert(ADDRINT value)
+{
+	UINT64 h = value;
+	unsigned char rank = 1;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	UINT64 rest = h >> Bits;
+	while (!(rest & (1ULL << (63 - Bits))) && rank <= 64 - Bits)
+	{
+		rest <<= 1;
+		rank++;
+	}
+	if (rank > Registers[h & (Count - 1)])
+		Registers[h & (Count - 1)] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog &other)
+{
+	for (unsigned int i = 0; i < Count; i++)
+		if (other.Registers[i] > Registers[i])
+			Registers[i] = other.Registers[i];
+}
+
+unsigned long long HyperLogLog::estimate() const
+{
+	double alpha, sum = 0, raw;
+	unsigned int zeros = 0;
+
+	switch (Count)
+	{
+		case 16: alpha = 0.673; break;
+		case 32: alpha = 0.697; break;
+		case 64: alpha = 0.709; break;
+		default: alpha = 0.7213 / (1 + 1.079 / Count);
+	}
+
+	for (unsigned int i = 0; i < Count; i++)
+	{
+		sum += ldexp(1.0, -Registers[i]);
+		if (Registers[i] == 0)
+			zeros++;
+	}
+	raw = alpha * Count * Count / sum;
+
+	// few addresses: count the empty registers instead (linear counting)
+	if (raw <= 2.5 * Count && zeros > 0)
+		raw = Count * log((double)Count / zeros);
+	return (unsigned long long)(raw + 0.5);
+}
+
+double HyperLogLog::error() const
+{
+	return 1.04 / sqrt((double)Count);
+}
+
+unsigned long HyperLogLog::bytes(unsigned int bits)
+{
+	return sizeof(HyperLogLog) + (1UL << bits);
+}
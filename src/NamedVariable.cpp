@@ -0,0 +1,25 @@
+/*
+ * NamedVariable.cpp
+ *
+ * This file contains the variables of the standalone utilities, see NamedVariable.h.
+ *
+ */
+
+#include <vector>
+
+#include "NamedVariable.h"
+
+static vector<NamedVariable*> Variables; // indexed by the variable id of the writer, 0 is the unknown variable
+
+VOID DefineVariable(UINT64 id, const string &name)
+{
+	if (id >= Variables.size())
+		Variables.resize(id+1, NULL);
+	delete Variables[id];
+	Variables[id] = new NamedVariable(name);
+}
+
+const VariableSymbol *LookupVariable(UINT64 id)
+{
+	return (id < Variables.size()) ? Variables[id] : NULL;
+}
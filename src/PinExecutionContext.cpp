@@ -37,6 +37,25 @@ unsigned int PinExecutionContext::mapRegisterToPin(enum eRegister reg, REG *pin_
 	}
 }
 
+unsigned int PinExecutionContext::mapRegisterFromPin(REG pin_reg, enum eRegister *reg) {
+	if (pin_reg == REG_STACK_PTR) {
+		*reg = EREG_STACK_POINTER;
+	} else if (pin_reg == REG_GBP) {
+		*reg = EREG_BASE_POINTER;
+	} else if (pin_reg == REG_EAX) {
+		*reg = EREG_EAX;
+	} else if (pin_reg == REG_ECX) {
+		*reg = EREG_ECX;
+	} else if (pin_reg == REG_EDX) {
+		*reg = EREG_EDX;
+	} else if (pin_reg == REG_EBX) {
+		*reg = EREG_EBX;
+	} else {
+		return 1;
+	}
+	return 0;
+}
+
 unsigned int PinExecutionContext::getRegisterValue(enum eRegister reg, unsigned long *value) const {
 	REG 		pin_register;
 	ADDRINT 	content;
@@ -80,3 +99,14 @@ unsigned int PinExecutionContext::getMemory(const char *addr, size_t size, char
 unsigned int PinExecutionContext::setMemory(char *addr, size_t size, char *buffer) {
 	return (unsigned int) PIN_SafeCopy(addr, buffer, size);
 }
+
+// the context is always the one of the thread calling the analysis routine
+unsigned int PinExecutionContext::getThreadId(unsigned int *id) const {
+	THREADID tid = PIN_ThreadId();
+
+	if (tid == INVALID_THREADID) {
+		return 1;
+	}
+	*id = (unsigned int) tid;
+	return 0;
+}
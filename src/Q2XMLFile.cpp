@@ -100,6 +100,12 @@ void Q2XMLFile::reset()
 	}
 	
 	m_qdufinger = qduTag;
+	
+	// index the channels which are already in the file
+	m_channels.clear();
+	ticpp::Iterator< ticpp::Element > channelItr(m_namespace + "channel");
+	for(channelItr = channelItr.begin(m_qdufinger); channelItr != channelItr.end(); channelItr++)
+		m_channels[make_pair(channelItr->GetAttribute("producer"), channelItr->GetAttribute("consumer"))] = channelItr.Get();
 }
 
 
@@ -188,6 +194,39 @@ void Q2XMLFile::printAllChValues() const
 	}
 }
 
+//append all the channels of the current application to 'channels' (the caller owns them)
+void Q2XMLFile::getChannels(vector<Channel*>& channels) const
+{
+	unsigned long long unma, bytes, values;
+	ticpp::Element *rangeTag;
+	
+	ticpp::Iterator< ticpp::Element > channelItr(m_namespace + "channel");
+	for(channelItr = channelItr.begin(m_qdufinger); channelItr != channelItr.end(); channelItr++)
+	{
+		string prod = channelItr->GetAttribute("producer");
+		string cons = channelItr->GetAttribute("consumer");
+		channelItr->FirstChildElement(m_namespace + "UnMA")->GetText(&unma);
+		channelItr->FirstChildElement(m_namespace + "Bytes")->GetText(&bytes);
+		channelItr->FirstChildElement(m_namespace + "UnDV")->GetText(&values);
+		
+		vector<Range> ranges;
+		Range r;
+		rangeTag = channelItr->FirstChildElement(m_namespace + "UnMARanges", false);
+		if (rangeTag)
+		{
+			ticpp::Iterator< ticpp::Element > unmaRangeItr(m_namespace + "range");
+			for(unmaRangeItr = unmaRangeItr.begin(rangeTag); unmaRangeItr != unmaRangeItr.end(); unmaRangeItr++)
+			{
+				r.lower = str2no( unmaRangeItr->GetAttribute("lower") );
+				r.upper = str2no( unmaRangeItr->GetAttribute("upper") );
+				ranges.push_back(r);
+			}
+		}
+		
+		channels.push_back(new Channel(prod,cons,ranges,unma,bytes,values));
+	}
+}
+
 void Q2XMLFile::insertChannel(Channel * ch)
 {
 	ticpp::Element *chTag;
@@ -195,23 +234,19 @@ void Q2XMLFile::insertChannel(Channel * ch)
 	string m_applicname("canny");
 
 	// get channel
-	ticpp::Iterator< ticpp::Element > channelItr(m_namespace + "channel");
-	for(channelItr = channelItr.begin(m_qdufinger); channelItr != channelItr.end(); channelItr++)
-		if	(	channelItr->GetAttribute("producer").compare(ch->getProducer()) == 0 && 
-				channelItr->GetAttribute("consumer").compare(ch->getConsumer()) == 0
-			)
-			break;
+	map<pair<string, string>, ticpp::Element*>::iterator channelItr = m_channels.find(make_pair(ch->getProducer(), ch->getConsumer()));
 	
-	if(channelItr == channelItr.end())
+	if(channelItr == m_channels.end())
 	{
 		// add new tag
 		chTag = new ticpp::Element(m_namespace + "channel");
 		chTag->SetAttribute("producer",ch->getProducer());
 		chTag->SetAttribute("consumer",ch->getConsumer());
 		m_qdufinger->LinkEndChild(chTag);            
+		m_channels[make_pair(ch->getProducer(), ch->getConsumer())] = chTag;
 	} 
 	else 
-		chTag = channelItr.Get();
+		chTag = channelItr->second;
 
 	try
 	{
@@ -224,6 +259,15 @@ void Q2XMLFile::insertChannel(Channel * ch)
 		unmaTag->SetText( ch->getUnMA() );
 		chTag->LinkEndChild(unmaTag);
 	}
+	// the bounds of a previous (sampled) profile in the same file are removed
+	unmaTag->RemoveAttribute("low");
+	unmaTag->RemoveAttribute("high");
+	if (ch->isEstimated())
+	{
+		unmaTag->SetAttribute("low",ch->getUnMALow());
+		if (ch->getUnMAHigh() > 0)
+			unmaTag->SetAttribute("high",ch->getUnMAHigh());
+	}
 	
 
 	try
@@ -237,6 +281,13 @@ void Q2XMLFile::insertChannel(Channel * ch)
 		bytesTag->SetText( ch->getBytes() );
 		chTag->LinkEndChild(bytesTag);
 	}
+	bytesTag->RemoveAttribute("low");
+	bytesTag->RemoveAttribute("high");
+	if (ch->isEstimated())
+	{
+		bytesTag->SetAttribute("low",ch->getBytesLow());
+		bytesTag->SetAttribute("high",ch->getBytesHigh());
+	}
 
 	try
 	{
@@ -249,6 +300,14 @@ void Q2XMLFile::insertChannel(Channel * ch)
 		valuesTag->SetText( ch->getValues() );
 		chTag->LinkEndChild(valuesTag);
 	}
+	valuesTag->RemoveAttribute("low");
+	valuesTag->RemoveAttribute("high");
+	if (ch->isEstimated())
+	{
+		valuesTag->SetAttribute("low",ch->getValuesLow());
+		if (ch->getValuesHigh() > 0)
+			valuesTag->SetAttribute("high",ch->getValuesHigh());
+	}
 	
 	
 	try
@@ -274,4 +333,53 @@ void Q2XMLFile::insertChannel(Channel * ch)
 	
 }
 
+void Q2XMLFile::setGranularity(unsigned int bytes)
+{
+	if (bytes > 1)
+		m_qdufinger->SetAttribute("granularity",bytes);
+	else
+		m_qdufinger->RemoveAttribute("granularity");
+}
+
+void Q2XMLFile::setSampling(const string &mode, unsigned int factor)
+{
+	if (factor > 1)
+	{
+		m_qdufinger->SetAttribute("sampling",mode);
+		m_qdufinger->SetAttribute("samplingFactor",factor);
+	}
+	else
+	{
+		m_qdufinger->RemoveAttribute("sampling");
+		m_qdufinger->RemoveAttribute("samplingFactor");
+	}
+}
+
+void Q2XMLFile::setUnMASketch(unsigned int bits)
+{
+	if (bits > 0)
+		m_qdufinger->SetAttribute("unmaSketchRegisters",1U << bits);
+	else
+		m_qdufinger->RemoveAttribute("unmaSketchRegisters");
+}
 
+void Q2XMLFile::setNotes(const vector<string> &notes)
+{
+	ticpp::Element *note;
+	
+	try
+	{
+		while ((note = m_qdufinger->FirstChildElement(m_namespace + "note", false)))
+			m_qdufinger->RemoveChild(note);
+	}
+	catch( ticpp::Exception& ex )
+	{
+	}
+	
+	for (vector<string>::const_iterator it = notes.begin(); it != notes.end(); it++)
+	{
+		note = new ticpp::Element(m_namespace + "note");
+		note->SetText(*it);
+		m_qdufinger->LinkEndChild(note);
+	}
+}
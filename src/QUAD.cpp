@@ -70,6 +70,9 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include "pin.H"
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -85,15 +88,23 @@ THE POSSIBILITY OF SUCH DAMAGE.
 #include "Exception.h"
 #include "Q2XMLFile.h"
 #include "BBlock.h"
+#include "Utility.h"
+#include "Engine.h"
+#include "AccessRing.h"
+#include "TraceFile.h"
+#include "SelfProfile.h"
+#include "ThreadTable.h"
 
 #include "PinExecutionContext.h"
 #include "SymbolResolver.h"
+#include "CachingSymbolResolver.h"
 
-SymbolResolver *symbol_resolver = 0;
+SymbolResolver *symbol_resolver = 0;	// the memo in front of the resolver below
 #ifdef QUAD_LIBELF
 #include "gelf.h"
 #include "ElfSymbolResolver.h"
 Elf* elf_handle;
+ElfSymbolResolver *elf_resolver = 0;	// the symbol table, when there is no DWARF information
 #endif
 
 #ifdef QUAD_LIBDWARF
@@ -102,6 +113,7 @@ Elf* elf_handle;
 #include "libdwarf.h"
 
 Dwarf_Debug dwarf_handle = 0;
+DwarfSymbolResolver *dwarf_resolver = 0;
 Dwarf_Error dwarf_error;
 
 void dwarf_handler(Dwarf_Error err, Dwarf_Ptr arg) {
@@ -133,26 +145,26 @@ void dwarf_handler(Dwarf_Error err, Dwarf_Ptr arg) {
 /* ===================================================================== */
 /* Global Variables */
 /* ===================================================================== */
-Q2XMLFile *q2xml; // also used in Tracing.cpp
+Engine Quad_Engine; // the tracing engine (libquadcore)
 BBList bblist;		//list of BBlocks
 
 char main_image_path[100];
 char main_image_name[100];
 
 map <string,ADDRINT> NametoADD;
-map <ADDRINT,string> ADDtoName;
-
-class GlobalSymbol {
-	public:
-		GlobalSymbol():start(0),size(0){};
-		GlobalSymbol(ADDRINT st, ADDRINT sz):start(st),size(sz){};
-		ADDRINT start;
-		ADDRINT size;
-};
 
-map <string, GlobalSymbol*> globalSymbols;
+// The shadow call stack of a thread holds the stack pointer at the entry of the active routines, the 
+// engine keeps the routines themselves in the call stack of the thread. A frame is dead as soon as the 
+// stack pointer is above its entry value, so returns, tail calls, longjmp and exception unwinding are 
+// all handled by comparing stack pointers.
+typedef struct
+{
+	vector<ADDRINT> entrySps;	// the stack pointer at the entry of every active routine
+	BOOL unwinding;	// a longjmp or an exception is unwinding frames without returning from them
+}
+ShadowStack;
 
-stack <string> CallStack; // our own virtual Call Stack to trace function call
+ThreadTable<ShadowStack*> ShadowStacks;
 
 set<string> SeenFname;
 ADDRINT GlobalfunctionNo=0x1;
@@ -164,37 +176,84 @@ UINT32 Progress_M_Ins=0;
 UINT32 Percentage=0;
 
 BOOL Count_Only = FALSE;
-BOOL Monitor_ON = FALSE;
 BOOL Include_External_Images=FALSE; // a flag showing our interest to trace functions which are not included in the main image file
 BOOL Select_Instr_ON = FALSE;
 BOOL Uncommon_Functions_Filter=TRUE;
 BOOL No_Stack_Flag = FALSE;   // a flag showing our interest to include or exclude stack memory accesses in analysis. The default value indicates tracing also the stack accesses. Can be modified by 'ignore_stack_access' command line switch
 BOOL Verbose_ON = FALSE;  // a flag showing the interest to print something when the tool is running or not!
+UINT32 Dwarf_Verbose = 0; // the diagnostics of the DWARF symbol resolver: 1 the warnings, 2 also every DIE, entry and call
+UINT32 Dwarf_Threads = 0; // the threads indexing the DWARF information in the background (0: only on demand)
+string Symbol_Cache_Dir; // the directory keeping the symbol indexes between runs ("": no cache)
 BOOL BBMODE = FALSE;
+BOOL Profile_This_Process = TRUE; // cleared in forked children when we are not interested in following them
+BOOL Ipc_Channels = FALSE; // a flag showing our interest to record pipe/socket/shared memory transfers as bindings
+unsigned int Num_Shard_Workers = 0; // the number of threads analyzing the memory accesses, 0 analyzes them in the application threads
+unsigned int Num_Report_Workers = 0; // the number of threads helping to generate the reports
+
+AccessRing *Analyzer_Ring = NULL; // the accesses are forwarded to quad-analyzer through this ring buffer, instead of being analyzed here
+BOOL Analyzer_Lost = FALSE; // quad-analyzer does not exist anymore
+map <string, UINT32> VariableIds; // the variable numbers used in the ring buffer and the trace
+PIN_LOCK VariableIds_Lock; // taken by the application threads to look up or number a variable
+TraceWriter *Trace_Writer = NULL; // the accesses and calls are recorded in this trace for quad-replay, instead of being analyzed here
+BOOL Self_Profile = FALSE; // a flag showing our interest to write the self profile of QUAD (QUAD_self_profile.txt)
+UINT32 Self_Profile_Interval = 0; // the self profile is also written every so many million instructions
+UINT32 Max_Memory_MB = 0; // the memory limit of the analysis, 0 is unlimited
+UINT32 Memory_Report_Interval = 0; // the memory of the analysis is reported every so many million instructions
+
+// the instrumentation levels of the overhead controller, from the most to the least detailed
+enum Fidelity
+{
+	FIDELITY_FULL,		// every memory access is recorded
+	FIDELITY_SAMPLED,	// only the accesses to a sample of the pages are recorded
+	FIDELITY_CALLS		// only the calls are tracked (and counted)
+};
+const char *Fidelity_Names[] = {"full tracing", "page sampled tracing", "function call counting"};
+
+typedef struct
+{
+	UINT32 fidelity;
+	UINT32 fromMIns;	// the first million instructions of the phase
+}
+FidelityPhase;
+
+UINT32 Overhead_Budget = 0; // the maximum slowdown of the application, 0 traces everything whatever the overhead
+double Native_IPS = 0; // the instructions per second of the application without Pin (estimated)
+UINT32 Overhead_Sample_Mask = 0; // the pages with (hash & mask) == 0 are recorded at FIDELITY_SAMPLED
+volatile UINT32 Current_Fidelity = FIDELITY_FULL;
+vector <FidelityPhase> Fidelity_Phases;
+PIN_LOCK Overhead_Lock;
+double Window_Start = 0; // the measurement window of the overhead controller
+UINT32 Window_Start_M_Ins = 0;
+UINT32 Windows_At_Fidelity = 0; // the windows measured since the last change of fidelity
+UINT32 Step_Up_Backoff = 1; // the windows to wait under the budget before trying a higher fidelity
+BOOL Stepped_Up = FALSE;
+
+// the state of the inter-process channels (-ipc_channels)
+typedef struct
+{
+	ADDRINT start;
+	ADDRINT end;	// one past the last byte of the mapping
+	ADDRINT id;	// function number of the SHM:<...> node
+}
+SharedRegion;
+
+// the accesses of all threads look up the regions without a lock: a mapping or unmapping publishes
+// a new copy of the table, the copies replaced are only freed in Fini as a lookup may still use them
+const vector<SharedRegion> * volatile SharedRegions = 0;
+vector<const vector<SharedRegion>*> Retired_SharedRegions;
+PIN_LOCK SharedRegions_Lock;
+
+typedef struct
+{
+	ADDRINT number;
+	ADDRINT args[6];
+}
+PendingSyscall;
+
+// the syscall every thread is in, the entry of a thread is only used by that thread
+map<THREADID, PendingSyscall> Pending_Syscalls;
+PIN_LOCK Pending_Syscalls_Lock;
 
-// A mapping between the name used and the functions names. This is needed
-// as names can be also basic blocks/code fragments
-map <string, string> NameToFunction;
-
-// The number of calls for each function
-map <string, int> FunctionToCount;
-
-typedef struct 
-{
-	UINT64 total_IN_ML;  // total bytes consumed by this function, produced by a function in the monitor list
-	UINT64 total_OUT_ML; // total bytes produced by this function, consumed by a function in the monitor list
-	UINT64 total_IN_ML_UMA; // total UMA used by this function, produced by a function in the monitor list
-	UINT64 total_OUT_ML_UMA; // total UMA used by this function, consumed by a function in the monitor list
-	UINT64 total_IN_ALL; // total bytes consumed by this function, produced by any function in the application
-	UINT64 total_OUT_ALL; // total bytes produced by this function, consumed by any function in the application
-	UINT64 total_IN_ALL_UMA; // total UMA used by this function, produced by any function in the application
-	UINT64 total_OUT_ALL_UMA; // total UMA used by this function, consumed by any function in the application
-	vector<string> consumers;
-	vector<string> producers;
-}
-TTL_ML_Data_Pack ;
-   
-map <string,TTL_ML_Data_Pack *> ML_OUTPUT ;  // used to maintain info regarding monitor list statistics
 vector <string> SIFL_OUTPUT;	//used to maintain selected instrument functions names
 char fileName[FILENAME_MAX];
 char cCurrentPath[FILENAME_MAX];
@@ -244,6 +303,18 @@ KNOB<BOOL> KnobElf(KNOB_MODE_WRITEONCE, "pintool",
 KNOB<unsigned int> KnobVariableCount(KNOB_MODE_WRITEONCE, "pintool", 
 	"varcnt", "5", "The maximum number of variable names to be displayed in the dot graph.");
 
+KNOB<unsigned int> KnobGranularity(KNOB_MODE_WRITEONCE, "pintool", 
+	"granularity", "1", "Track the memory in aligned blocks of this many bytes (1, 4, 8, 64, ... a power of two), coarser blocks use less shadow memory and time");
+
+KNOB<unsigned int> KnobSamplePages(KNOB_MODE_WRITEONCE, "pintool", 
+	"sample_pages", "1", "Only analyze the accesses to 1 of every N pages (chosen by a hash of the page), Bytes and UnMA are scaled estimates with confidence bounds");
+
+KNOB<unsigned int> KnobSampleAccesses(KNOB_MODE_WRITEONCE, "pintool", 
+	"sample_accesses", "1", "Only analyze 1 of every N memory accesses, Bytes is a scaled estimate with confidence bounds and UnMA a lower bound");
+
+KNOB<unsigned int> KnobUnMASketch(KNOB_MODE_WRITEONCE, "pintool", 
+	"unma_sketch", "0", "Estimate UnMA with a HyperLogLog sketch of 2^N registers (N from 4 to 16) per channel instead of the exact set of addresses, without address ranges (0 is exact)");
+
 KNOB<string> KnobMonitorList(KNOB_MODE_WRITEONCE, "pintool", 
 	"use_monitor_list","", "Create output report files only for certain function(s) in the application and filter out the rest (the functions are listed in a text file whose name follows)");
 
@@ -261,11 +332,58 @@ KNOB<BOOL> KnobIncludeExternalImages(KNOB_MODE_WRITEONCE, "pintool",
 
 KNOB<BOOL> KnobVerbose_ON(KNOB_MODE_WRITEONCE, "pintool",
 	"verbose","0", "Print information on the console during application execution");
-    
-/* ===================================================================== */
 
-#include "tracing.cpp"
+KNOB<UINT32> KnobDwarfVerbose(KNOB_MODE_WRITEONCE, "pintool",
+	"dwarf_verbose","0", "Print the diagnostics of the DWARF symbol resolver: 1 the warnings about the debug information, 2 also the DIEs and entries indexed and the calls followed");
+
+KNOB<UINT32> KnobDwarfThreads(KNOB_MODE_WRITEONCE, "pintool",
+	"dwarf_threads","0", "Index the functions of all compile units on this many threads in the background, instead of only when an address in a unit is first resolved");
+
+KNOB<string> KnobSymbolCache(KNOB_MODE_WRITEONCE, "pintool",
+	"symbol_cache","", "Keep the DWARF symbol index of the application (or its ELF symbol table without DWARF information) in this directory, so later runs on the same binary (same build-id or contents) read it instead of indexing again");
 
+KNOB<BOOL> KnobFollowFork(KNOB_MODE_WRITEONCE, "pintool",
+	"follow_fork","1", "Profile forked child processes into their own output files (suffixed with the PID of the child)");
+
+KNOB<BOOL> KnobIpcChannels(KNOB_MODE_WRITEONCE, "pintool",
+	"ipc_channels","0", "Record pipe, socket and shared memory transfers as bindings with PIPE:/SOCK:/SHM: nodes, which quad-merge connects across processes");
+
+KNOB<unsigned int> KnobShards(KNOB_MODE_WRITEONCE, "pintool",
+	"shards","0", "Number of worker threads which analyze the memory accesses, each one owns a part of the address space (0 analyzes the accesses in the application threads)");
+
+KNOB<unsigned int> KnobReportThreads(KNOB_MODE_WRITEONCE, "pintool",
+	"report_threads","0", "Number of threads which help to prepare the reports at the end of the execution (0 prepares them in the exiting thread)");
+
+KNOB<string> KnobAnalyzerShm(KNOB_MODE_WRITEONCE, "pintool",
+	"analyzer_shm","", "Forward the memory accesses to quad-analyzer through the ring buffer in this file, quad-analyzer writes the reports");
+
+KNOB<string> KnobRecordTrace(KNOB_MODE_WRITEONCE, "pintool",
+	"record_trace","", "Only record the memory accesses and function calls in this trace file, quad-replay writes the reports from it");
+
+KNOB<BOOL> KnobSelfProfile(KNOB_MODE_WRITEONCE, "pintool",
+	"self_profile","0", "Write the counters of the work done by QUAD itself to QUAD_self_profile.txt at the end");
+
+KNOB<BOOL> KnobSelfProfileTimers(KNOB_MODE_WRITEONCE, "pintool",
+	"self_profile_timers","0", "Also measure the cycles spent in every stage of the analysis in the self profile (adds overhead)");
+
+KNOB<UINT32> KnobSelfProfileInterval(KNOB_MODE_WRITEONCE, "pintool",
+	"self_profile_interval","0", "Also write the self profile every so many million instructions");
+
+KNOB<UINT32> KnobMaxMemoryMB(KNOB_MODE_WRITEONCE, "pintool",
+	"max_memory_mb","0", "Limit the memory of the analysis to this many MB, first by dropping the unique address sets (UnMA becomes a lower bound), then by stopping the analysis (0 is unlimited)");
+
+KNOB<UINT32> KnobMemoryReportInterval(KNOB_MODE_WRITEONCE, "pintool",
+	"memory_report_interval","0", "Report the memory of the analysis every so many million instructions");
+
+KNOB<UINT32> KnobOverheadBudget(KNOB_MODE_WRITEONCE, "pintool",
+	"overhead_budget","0", "Keep the slowdown of the application under this factor by switching between full tracing, page sampled tracing and function call counting (0 always traces fully)");
+
+KNOB<UINT32> KnobNativeMIPS(KNOB_MODE_WRITEONCE, "pintool",
+	"native_mips","0", "The speed of the application without Pin in millions of instructions per second, for '-overhead_budget' (0 estimates it at startup, which takes up to 0.1 s)");
+
+KNOB<UINT32> KnobOverheadSample(KNOB_MODE_WRITEONCE, "pintool",
+	"overhead_sample","16", "Record the accesses to 1 out of this many pages in the page sampled phases of '-overhead_budget' (a power of two)");
+    
 /* ===================================================================== */
 
 const VariableSymbol* findVariable(CONTEXT* context, VOID* addr, INT32 size) {
@@ -292,105 +410,165 @@ VOID leaveFunction(const class ExecutionContext &context, VOID* addr, VOID* ret_
 }
 
 /* ===================================================================== */
-VOID EnterFC(CONTEXT *context, VOID *ip, char *name,bool flag) 
+
+// returns the dummy function number used for 'ftnName' in the bindings, a new one is created the first time we see the name
+ADDRINT FunctionId(const string &ftnName)
 {
-	// revise the following in case you want to exclude some unwanted functions under Windows and/or Linux
-	if (!flag) return;   // not found in the main image, so skip the current function name update
+	if(!SeenFname.count(ftnName))  // this is the first time I see this function name in charge of access
+	{
+		SeenFname.insert(ftnName);  // mark this function name as seen
+		GlobalfunctionNo++;      // create a dummy Function Number for this function
+		NametoADD[ftnName]=GlobalfunctionNo;   // create the string -> Number binding
+		Quad_Engine.defineFunction(GlobalfunctionNo, ftnName);   // create the Number -> String binding
+		if (Analyzer_Ring)
+			Analyzer_Ring->writeName(RING_FUNC_NAME, GlobalfunctionNo, ftnName);
+		if (Trace_Writer)
+			Trace_Writer->writeName(TRACE_FUNC_NAME, GlobalfunctionNo, ftnName);
+	} 
+	return NametoADD[ftnName];
+}
 
+/* ===================================================================== */
+// revise the following in case you want to exclude some unwanted functions under Windows and/or Linux
+BOOL IsUncommonFunctionName(const char *name)
+{
 	#ifdef WIN32
-	if (Uncommon_Functions_Filter)
-	{
-		if	(
-			//commented the following as the functions in libraries were needed (e.g. in KLT)
-			name[0]=='_' ||
-			name[0]=='?' ||
-			!strcmp(name,"GetPdbDll") || 
-			!strcmp(name,"DebuggerRuntime") || 
-			!strcmp(name,"atexit") || 
-			!strcmp(name,"failwithmessage") ||
-			!strcmp(name,"pre_c_init") ||
-			!strcmp(name,"pre_cpp_init") ||
-			!strcmp(name,"mainCRTStartup") ||
-			!strcmp(name,"NtCurrentTeb") ||
-			!strcmp(name,"check_managed_app") ||
-			!strcmp(name,"DebuggerKnownHandle") ||
-			!strcmp(name,"DebuggerProbe") ||
-			!strcmp(name,"failwithmessage") ||
-			!strcmp(name,"unnamedImageEntryPoint")
-			) 
-			return;
-	}
+	return	(
+		//commented the following as the functions in libraries were needed (e.g. in KLT)
+		name[0]=='_' ||
+		name[0]=='?' ||
+		!strcmp(name,"GetPdbDll") || 
+		!strcmp(name,"DebuggerRuntime") || 
+		!strcmp(name,"atexit") || 
+		!strcmp(name,"failwithmessage") ||
+		!strcmp(name,"pre_c_init") ||
+		!strcmp(name,"pre_cpp_init") ||
+		!strcmp(name,"mainCRTStartup") ||
+		!strcmp(name,"NtCurrentTeb") ||
+		!strcmp(name,"check_managed_app") ||
+		!strcmp(name,"DebuggerKnownHandle") ||
+		!strcmp(name,"DebuggerProbe") ||
+		!strcmp(name,"failwithmessage") ||
+		!strcmp(name,"unnamedImageEntryPoint")
+		);
 	#else
-	if (Uncommon_Functions_Filter)
-	{
-		if  (
-			//commented the following as the functions in libraries were needed (e.g. in KLT)
-			name[0]=='_' || 
-			name[0]=='?' || 
-			name[0]=='.' ||
-			!strcmp(name,"call_gmon_start") || 
-			!strcmp(name,"frame_dummy") 
-			) 
-			
-			return;
-	}
+	return  (
+		//commented the following as the functions in libraries were needed (e.g. in KLT)
+		name[0]=='_' || 
+		name[0]=='?' || 
+		name[0]=='.' ||
+		!strcmp(name,"call_gmon_start") || 
+		!strcmp(name,"frame_dummy") 
+		);
 	#endif
+}
+
+// the routines which leave frames without returning from them
+BOOL IsUnwindFunctionName(const string &name)
+{
+	return	name == "longjmp" ||
+		name == "_longjmp" ||
+		name == "siglongjmp" ||
+		name == "__longjmp_chk" ||
+		name == "_Unwind_RaiseException" ||
+		name == "_Unwind_Resume" ||
+		name == "_Unwind_ForcedUnwind";
+}
 
-	// update the current function name
-	string RName(name);
-	CallStack.push(RName);
+ShadowStack *GetShadowStack(THREADID tid)
+{
+	ShadowStack *&stack = ShadowStacks[tid];
 	
-	if(FunctionToCount.find(RName)==FunctionToCount.end()) {
-		FunctionToCount[RName]=1;
-	} else {
-		FunctionToCount[RName]++;
+	if (!stack)
+	{
+		// the bottom frame (Out_of_the_main_function_scope) is never left
+		stack = new ShadowStack;
+		stack->entrySps.push_back(~(ADDRINT)0);
+		stack->unwinding = FALSE;
 	}
+	return stack;
 }
 
-//============================================================================
+// pops the frames entered at or below 'sp' ('inclusive') or only below it, returns the number of popped frames
+inline UINT32 PopDeadFrames(ShadowStack *stack, ADDRINT sp, BOOL inclusive)
+{
+	UINT32 popped = 0;
+	
+	while (stack->entrySps.size() > 1 && (stack->entrySps.back() < sp || (inclusive && stack->entrySps.back() == sp)))
+	{
+		stack->entrySps.pop_back();
+		popped++;
+	}
+	return popped;
+}
 
-VOID EnterFC_EXTERNAL_OK(CONTEXT* context, VOID* ip, char *name) 
+VOID EnterFC(THREADID tid, ADDRINT sp, ADDRINT rtnId, BOOL counted) 
 {
-	// revise the following in case you want to exclude some unwanted functions under Windows and/or Linux
-	#ifdef WIN32
-	if (Uncommon_Functions_Filter)
-	{
-		if	(		
-			name[0]=='_' ||
-			name[0]=='?' ||
-			!strcmp(name,"GetPdbDll") || 
-			!strcmp(name,"DebuggerRuntime") || 
-			!strcmp(name,"atexit") || 
-			!strcmp(name,"failwithmessage") ||
-			!strcmp(name,"pre_c_init") ||
-			!strcmp(name,"pre_cpp_init") ||
-			!strcmp(name,"mainCRTStartup") ||
-			!strcmp(name,"NtCurrentTeb") ||
-			!strcmp(name,"check_managed_app") ||
-			!strcmp(name,"DebuggerKnownHandle") ||
-			!strcmp(name,"DebuggerProbe") ||
-			!strcmp(name,"failwithmessage") ||
-			!strcmp(name,"unnamedImageEntryPoint")
-			) 
-			return;
+	ShadowStack *stack = GetShadowStack(tid);
+	SelfProfile *profile = GetThreadProfile(tid);
+	UINT64 start = SelfTimerStart();
+	UINT32 popped;
+	
+	// a routine entered with the stack pointer of the current frame was reached by a tail call
+	popped = PopDeadFrames(stack, sp, TRUE);
+	if (popped)
+		Quad_Engine.onExit(tid, popped);
+	
+	// update the current function
+	stack->entrySps.push_back(sp);
+	Quad_Engine.onEnter(tid, rtnId, counted);
+	
+	if (Trace_Writer)
+	{
+		if (popped)
+			Trace_Writer->exit(tid, popped);
+		Trace_Writer->enter(tid, rtnId, counted);
 	}
-	#else
-	if (Uncommon_Functions_Filter)
-	{
- 		if(
-			name[0]=='_' || 
-			name[0]=='?' ||
-			name[0]=='.' ||
-			!strcmp(name,"call_gmon_start") || 
-			!strcmp(name,"frame_dummy")
-			) 
-			return;
+	
+	SelfTimerStop(profile, ST_CALLS, start);
+}
+
+VOID ShadowReturn(THREADID tid, ADDRINT sp)
+{
+	UINT64 start = SelfTimerStart();
+	
+	// the stack pointer points to the return address, which is where it pointed at the entry of the returning routine
+	UINT32 popped = PopDeadFrames(GetShadowStack(tid), sp, TRUE);
+	
+	if (popped)
+	{
+		Quad_Engine.onExit(tid, popped);
+		if (Trace_Writer)
+			Trace_Writer->exit(tid, popped);
+		SelfTimerStop(GetThreadProfile(tid), ST_CALLS, start);
 	}
-	#endif
+}
+
+VOID MarkUnwind(THREADID tid)
+{
+	GetShadowStack(tid)->unwinding = TRUE;
+}
 
-	// update the current function name	 
-	string RName(name);
-	CallStack.push(RName);
+// returns the function which is currently active in thread 'tid'
+inline ADDRINT CurrentFunctionId(THREADID tid, CONTEXT *context)
+{
+	ShadowStack *stack = GetShadowStack(tid);
+	
+	// after a longjmp or an exception the frames above the landing site are dead, as soon as we are
+	// back in a frame we knew
+	if (stack->unwinding)
+	{
+		UINT32 popped = PopDeadFrames(stack, PIN_GetContextReg(context, REG_STACK_PTR), FALSE);
+		if (popped)
+		{
+			stack->unwinding = FALSE;
+			Quad_Engine.onExit(tid, popped);
+			if (Trace_Writer)
+				Trace_Writer->exit(tid, popped);
+		}
+	}
+	
+	return Quad_Engine.currentFunction(tid);
 }
 
 //============================================================================
@@ -423,13 +601,6 @@ VOID  Return(CONTEXT *context)
 	const PinExecutionContext pin_context(context);
 
 	if (pin_context.getInstructionPointer(&ip) == 0) {
-		string fn_name = RTN_FindNameByAddress((ADDRINT)ip);
-
-		if(!(CallStack.empty()) && (CallStack.top()==fn_name))
-		{  
-			CallStack.pop();
-		}	
-
 		if (pin_context.getRegisterValue(EREG_STACK_POINTER, (unsigned long *) &sp) == 0) {
 			if (pin_context.getMemory((const char *) sp, sizeof(ADDRINT), (char *) &ret_addr) == sizeof(ADDRINT)) {
 				leaveFunction(pin_context, ip, (VOID *) ret_addr);
@@ -442,62 +613,448 @@ VOID  Return(CONTEXT *context)
 VOID UpdateCurrentFunctionName(RTN rtn,VOID *v)
 {
 	bool flag;
-	char *s=new char[120];
 	string RName;
 		
 	RName=RTN_Name(rtn);
-	strcpy(s,RName.c_str());
 	RTN_Open(rtn);
-            
-	// Insert a call at the entry point of a routine to push the current routine to Call Stack
-	if (!Include_External_Images)  // I need to know whether or not the function is in the main image
-	{
-		flag=(!((IMG_Name(SEC_Img(RTN_Sec(rtn))).find(main_image_name)) == string::npos));
-		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)EnterFC, IARG_CONTEXT, IARG_INST_PTR, IARG_PTR, s, IARG_BOOL, flag, IARG_END);    
-	}
-	else
+	
+	if (IsUnwindFunctionName(RName))
+		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)MarkUnwind, IARG_THREAD_ID, IARG_END);
+	
+	// I need to know whether or not the function is in the main image
+	flag = Include_External_Images || (!((IMG_Name(SEC_Img(RTN_Sec(rtn))).find(main_image_name)) == string::npos));
+	
+	if (flag && !(Uncommon_Functions_Filter && IsUncommonFunctionName(RName.c_str())))
 	{
-		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)EnterFC_EXTERNAL_OK, IARG_CONTEXT, IARG_INST_PTR, IARG_PTR, s, IARG_END);    
+		// the calls are only counted for the functions in the main image
+		BOOL counted = !Include_External_Images;
+		
+		// Insert a call at the entry point of a routine to push the current routine on the shadow call stack
+		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)EnterFC, 
+			IARG_THREAD_ID, 
+			IARG_REG_VALUE, REG_STACK_PTR, 
+			IARG_ADDRINT, FunctionId(RName), 
+			IARG_BOOL, counted, 
+			IARG_END);
 	}
 	
-	// Insert a call at the exit point of a routine to pop the current routine from Call Stack if we have the routine on the top
-	// RTN_InsertCall(rtn, IPOINT_AFTER, (AFUNPTR)exitFc, IARG_PTR, RName.c_str(), IARG_END);
+	// the routine is popped from the shadow call stack by the 'ret' (see Instruction)
 	RTN_Close(rtn);
 }
 
+/* ===================================================================== */
+// notes the fidelity of every phase of the run in the reports
+VOID NoteFidelityPhases()
+{
+	for (UINT32 i = 0; i < Fidelity_Phases.size(); i++)
+	{
+		string note = Fidelity_Names[Fidelity_Phases[i].fidelity] + string(" from ") + no2str(Fidelity_Phases[i].fromMIns) + " M to ";
+		
+		note += i + 1 < Fidelity_Phases.size() ? no2str(Fidelity_Phases[i + 1].fromMIns) + " M instructions" : "the end";
+		if (Fidelity_Phases[i].fidelity == FIDELITY_SAMPLED)
+			note += " (1 out of " + no2str(Overhead_Sample_Mask + 1) + " pages, not scaled)";
+		Quad_Engine.addNote(note);
+	}
+}
+
+/* ===================================================================== */
+// called before the Fini callbacks, while the internal threads of QUAD are still running
+VOID PrepareForFini(VOID *v)
+{
+#ifdef QUAD_LIBDWARF
+	if (dwarf_resolver != 0)
+		dwarf_resolver->stopIndexThreads();
+#endif
+	if (!Count_Only && !Analyzer_Ring && !Trace_Writer && Profile_This_Process)
+		Quad_Engine.prepareReport();
+	else
+		Quad_Engine.stop();
+}
+
 /* ===================================================================== */
 VOID Fini(INT32 code, VOID *v)
 {
     cerr << "\nFinished executing the instrumented application..." << endl;
 
 #ifdef QUAD_LIBDWARF
-	DwarfSymbolResolver::destroyDwarfSymbolResolver((DwarfSymbolResolver**) &symbol_resolver);
+	if (dwarf_resolver != 0)
+		dwarf_resolver->saveIndexCache();
+#endif
+	delete symbol_resolver;
+	symbol_resolver = 0;
+#ifdef QUAD_LIBDWARF
+	DwarfSymbolResolver::destroyDwarfSymbolResolver(&dwarf_resolver);
 
     if (dwarf_handle != 0) {
         dwarf_finish(dwarf_handle, &dwarf_error);
     }
 #endif
 #ifdef QUAD_LIBELF
+	delete elf_resolver;
+	elf_resolver = 0;
     elf_end(elf_handle);
 #endif
 
+	while (!Retired_SharedRegions.empty())
+	{
+		delete Retired_SharedRegions.back();
+		Retired_SharedRegions.pop_back();
+	}
+
     if (Count_Only)
     {
     	cerr << "Counted Instructions: " << Total_M_Ins << " M + " << Total_Ins << endl;
     }
-    else
+    else if (Analyzer_Ring)
     {
-	    CreateDSGraphFile();
-	    if(Monitor_ON)
-		    CreateTotalStatFile();
+	    Analyzer_Ring->close(); // quad-analyzer writes the reports
     }
+    else if (Trace_Writer)
+    {
+	    Trace_Writer->close(); // quad-replay writes the reports
+    }
+    else if (Profile_This_Process)
+    {
+	    if (Overhead_Budget > 0)
+		    NoteFidelityPhases();
+	    Quad_Engine.report();
+    }
+	
+    if (Self_Profile && Profile_This_Process)
+	    WriteSelfProfile("at the end of the execution");
 	
     cerr << "done!" << endl;
 }
 
 /* ===================================================================== */
+/* Forwarding to quad-analyzer and recording traces */
+/* ===================================================================== */
+
+// returns the number of variable 'vars' in the ring buffer or the trace, 0 if it is unknown
+UINT32 VariableId(const VariableSymbol *vars)
+{
+	char varname[256];
+	
+	if (!vars)
+		return 0;
+	
+	vars->getName(varname, 256);
+	// the name is written before the lock is released, so no access with the number precedes it
+	PIN_GetLock(&VariableIds_Lock, 1);
+	map<string, UINT32>::iterator it = VariableIds.find(varname);
+	if (it != VariableIds.end())
+	{
+		UINT32 id = it->second;
+		PIN_ReleaseLock(&VariableIds_Lock);
+		return id;
+	}
+	
+	UINT32 id = VariableIds.size() + 1;
+	VariableIds[varname] = id;
+	if (Analyzer_Ring)
+		Analyzer_Ring->writeName(RING_VAR_NAME, id, varname);
+	if (Trace_Writer)
+		Trace_Writer->writeName(TRACE_VAR_NAME, id, varname);
+	PIN_ReleaseLock(&VariableIds_Lock);
+	return id;
+}
+
+VOID ForwardAccess(ADDRINT addr, INT32 size, ADDRINT ftnId, const VariableSymbol *vars, bool writeFlag)
+{
+	if (Analyzer_Lost)
+		return;
+	
+	if (!Analyzer_Ring->writeAccess(addr, size, ftnId, VariableId(vars), writeFlag))
+	{
+		Analyzer_Lost = TRUE;
+		cerr << "\nquad-analyzer terminated, the remaining memory accesses are not analyzed..." << endl;
+	}
+}
+
+int AttachAnalyzer(const string &ringName)
+{
+	map<ADDRINT, string>::const_iterator it;
+	
+	if (!(Analyzer_Ring = AccessRing::attach(ringName)))
+		return 1;
+	
+	AccessRingOptions &ringOptions = Analyzer_Ring->header()->options;
+	const EngineOptions &options = Quad_Engine.options();
+	ringOptions.showBytes = options.showBytes;
+	ringOptions.showUnDVs = options.showUnDVs;
+	ringOptions.showRanges = options.showRanges;
+	ringOptions.rangesLimit = options.rangesLimit;
+	ringOptions.showVariables = options.showVariables;
+	ringOptions.variableCount = options.variableCount;
+	ringOptions.granularity = options.granularity;
+	ringOptions.samplePages = options.samplePages;
+	ringOptions.sampleAccesses = options.sampleAccesses;
+	ringOptions.unmaSketchBits = options.unmaSketchBits;
+	
+	for (it = Quad_Engine.functions().begin(); it != Quad_Engine.functions().end(); it++)
+		Analyzer_Ring->writeName(RING_FUNC_NAME, it->first, it->second);
+	return 0;
+}
+
+// creates the trace file and writes the names known so far to it
+int StartTrace(const string &traceName)
+{
+	map<ADDRINT, string>::const_iterator it;
+	map<string, UINT32>::const_iterator vit;
+	
+	if (!(Trace_Writer = TraceWriter::open(traceName)))
+		return 1;
+	
+	for (it = Quad_Engine.functions().begin(); it != Quad_Engine.functions().end(); it++)
+		Trace_Writer->writeName(TRACE_FUNC_NAME, it->first, it->second);
+	for (vit = VariableIds.begin(); vit != VariableIds.end(); vit++)
+		Trace_Writer->writeName(TRACE_VAR_NAME, vit->second, vit->first);
+	return 0;
+}
+
+/* ===================================================================== */
+/* Inter-process channels */
+/* ===================================================================== */
+
+// Data leaving the process through a pipe or socket is recorded as consumed by a 'PIPE:<inode>' 
+// (or 'SOCK:<inode>') node, data arriving through it as produced by that node. The node names 
+// only depend on the inode, so quad-merge can connect the producer in one process with the 
+// consumer in the other one. Shared memory mappings get a 'SHM:<...>' node in the same way.
+
+// returns the node name used for descriptor 'fd', or an empty string if it is not an inter-process channel
+string IpcChannelName(int fd)
+{
+	struct stat st;
+	
+	if (fstat(fd, &st) != 0)
+		return "";
+	if (S_ISFIFO(st.st_mode))
+		return "PIPE:" + no2str(st.st_ino);
+	if (S_ISSOCK(st.st_mode))
+		return "SOCK:" + no2str(st.st_ino);
+	return "";
+}
 
-static VOID RecordMem(CONTEXT * context, CHAR r, VOID * addr, INT32 size, BOOL isPrefetch)
+const SharedRegion *FindSharedRegion(const vector<SharedRegion> *regions, ADDRINT addr)
+{
+	for (unsigned int i=0; i<regions->size(); i++)
+		if ((*regions)[i].start <= addr && addr < (*regions)[i].end)
+			return &(*regions)[i];
+	return NULL;
+}
+
+// replaces the table of the shared regions with 'regions', called with SharedRegions_Lock held
+VOID PublishSharedRegions(const vector<SharedRegion> *regions)
+{
+	if (SharedRegions != 0)
+		Retired_SharedRegions.push_back((const vector<SharedRegion>*) SharedRegions);
+	// the regions are complete before another thread can see the table
+	__sync_synchronize();
+	SharedRegions = regions;
+}
+
+PendingSyscall &GetPendingSyscall(THREADID tid)
+{
+	PIN_GetLock(&Pending_Syscalls_Lock, 1);
+	// the entries of a map never move, so the reference stays valid after the lock
+	PendingSyscall &sc = Pending_Syscalls[tid];
+	PIN_ReleaseLock(&Pending_Syscalls_Lock);
+	return sc;
+}
+
+// a write to shared memory is handed over to the SHM node, which then becomes the producer of the location.
+// a read of a location that has no producer in this process was written by another process through the SHM node.
+VOID RecordSharedMemoryAccess(const SharedRegion *shm, ADDRINT addr, INT32 size, ADDRINT ftnId, const VariableSymbol *vars, bool writeFlag)
+{
+	for(int i=0;i<size;i++,addr++)
+	{
+		if (addr >= shm->end)
+		{
+			Quad_Engine.onAccess(addr, 1, ftnId, vars, writeFlag);
+			continue;
+		}
+		
+		if (!writeFlag && Quad_Engine.lastWriter(addr)==0)
+			Quad_Engine.onAccess(addr, 1, shm->id, 0, true);
+		
+		Quad_Engine.onAccess(addr, 1, ftnId, vars, writeFlag);
+		
+		if (writeFlag)
+		{
+			Quad_Engine.onAccess(addr, 1, shm->id, 0, false);
+			Quad_Engine.onAccess(addr, 1, shm->id, 0, true);
+		}
+	}
+}
+
+VOID RecordIpcTransfer(int fd, ADDRINT buffer, ADDRINT count, bool incoming)
+{
+	string name = IpcChannelName(fd);
+	if (name.empty()) 
+		return;
+	
+	Quad_Engine.onAccess(buffer, count, FunctionId(name), 0, incoming);
+}
+
+VOID SyscallEntry(THREADID tid, CONTEXT *ctxt, SYSCALL_STANDARD std, VOID *v)
+{
+	PendingSyscall &sc = GetPendingSyscall(tid);
+	
+	sc.number = PIN_GetSyscallNumber(ctxt, std);
+	for (UINT32 i=0; i<6; i++)
+		sc.args[i] = PIN_GetSyscallArgument(ctxt, std, i);
+}
+
+VOID SyscallExit(THREADID tid, CONTEXT *ctxt, SYSCALL_STANDARD std, VOID *v)
+{
+	PendingSyscall &sc = GetPendingSyscall(tid);
+	ADDRINT ret = PIN_GetSyscallReturn(ctxt, std);
+	
+	switch (sc.number)
+	{
+	case SYS_write:
+#ifdef SYS_sendto
+	case SYS_sendto:
+#endif
+		if ((long) ret > 0)
+			RecordIpcTransfer((int) sc.args[0], sc.args[1], ret, false);
+		break;
+	case SYS_read:
+#ifdef SYS_recvfrom
+	case SYS_recvfrom:
+#endif
+		if ((long) ret > 0)
+			RecordIpcTransfer((int) sc.args[0], sc.args[1], ret, true);
+		break;
+#ifdef SYS_mmap2
+	case SYS_mmap2:
+#else
+	case SYS_mmap:
+#endif
+		if (ret != (ADDRINT) MAP_FAILED && (sc.args[3] & MAP_SHARED))
+		{
+			struct stat st;
+			SharedRegion shm;
+			string name;
+			
+			// anonymous shared memory is inherited at the same address, files and shm objects have an inode
+			if (!(sc.args[3] & MAP_ANONYMOUS) && fstat((int) sc.args[4], &st) == 0)
+				name = "SHM:" + no2str(st.st_ino);
+			else
+				name = "SHM:" + no2str(ret);
+			
+			shm.start = ret;
+			shm.end = ret + sc.args[1];
+			shm.id = FunctionId(name);
+			
+			PIN_GetLock(&SharedRegions_Lock, 1);
+			vector<SharedRegion> *regions = SharedRegions ? new vector<SharedRegion>(*SharedRegions) : new vector<SharedRegion>();
+			regions->push_back(shm);
+			PublishSharedRegions(regions);
+			PIN_ReleaseLock(&SharedRegions_Lock);
+		}
+		break;
+	case SYS_munmap:
+		PIN_GetLock(&SharedRegions_Lock, 1);
+		if (SharedRegions != 0)
+			for (unsigned int i=0; i<SharedRegions->size(); i++)
+				if ((*SharedRegions)[i].start == sc.args[0])
+				{
+					vector<SharedRegion> *regions = new vector<SharedRegion>(*SharedRegions);
+					regions->erase(regions->begin()+i);
+					PublishSharedRegions(regions);
+					break;
+				}
+		PIN_ReleaseLock(&SharedRegions_Lock);
+		break;
+	}
+}
+
+/* ===================================================================== */
+
+// called in the parent process right before a fork, the shadow memory the child inherits has to be up to date
+VOID ForkBefore(THREADID tid, const CONTEXT *ctxt, VOID *v)
+{
+	Quad_Engine.quiesce(tid);
+	
+	// the child would write the buffered records of the parent again
+	if (Trace_Writer)
+		Trace_Writer->flush();
+#ifdef QUAD_LIBDWARF
+	if (dwarf_resolver != 0)
+		dwarf_resolver->quiesceIndexThreads();
+#endif
+}
+
+// called in the parent process right after a fork
+VOID ForkParent(THREADID tid, const CONTEXT *ctxt, VOID *v)
+{
+#ifdef QUAD_LIBDWARF
+	if (dwarf_resolver != 0)
+		dwarf_resolver->resumeIndexThreads();
+#endif
+}
+
+// called in the child process right after a fork
+VOID ForkChild(THREADID tid, const CONTEXT *ctxt, VOID *v)
+{
+#ifdef QUAD_LIBDWARF
+	if (dwarf_resolver != 0)
+		dwarf_resolver->restartIndexThreads();
+#endif
+
+	// the other threads of the parent, which may have held the locks, do not exist in the child
+	PIN_InitLock(&VariableIds_Lock);
+	if (Ipc_Channels)
+	{
+		PIN_InitLock(&SharedRegions_Lock);
+		PIN_InitLock(&Pending_Syscalls_Lock);
+	}
+
+	// quad-analyzer only follows the initial process, a followed child is analyzed here 
+	// (without the history of the parent, which is in quad-analyzer)
+	if (Analyzer_Ring)
+	{
+		delete Analyzer_Ring;
+		Analyzer_Ring = NULL;
+	}
+	
+	// the trace of the parent stays with the parent
+	if (Trace_Writer)
+	{
+		Trace_Writer->abandon();
+		delete Trace_Writer;
+		Trace_Writer = NULL;
+		
+		// a followed child records its own trace, starting in the frames of the forking thread
+		if (KnobFollowFork.Value())
+		{
+			string traceName = suffixFileName(KnobRecordTrace.Value(), "." + no2str(PIN_GetPid()));
+			if (StartTrace(traceName) == 0)
+			{
+				const vector<ADDRINT> &stack = Quad_Engine.callStack(tid);
+				for (UINT32 i=1; i<stack.size(); i++)
+					Trace_Writer->enter(tid, stack[i], FALSE);
+			}
+		}
+	}
+	
+	if (!KnobFollowFork.Value())
+	{
+		Profile_This_Process = FALSE; // only the initial process writes output files
+		return;
+	}
+	
+	// the child gets its own output files, and starts without the bindings of its parent
+	Quad_Engine.restart("." + no2str(PIN_GetPid()), KnobXML.Value(), KnobApplication.Value());
+	
+	cerr << "\nFollowing forked child process " << PIN_GetPid() << "..." << endl;
+}
+
+/* ===================================================================== */
+
+// 'isStatic' tells that the variable of the access was resolved when it was instrumented, it is 'staticVars'
+static VOID RecordMem(THREADID tid, CONTEXT * context, CHAR r, VOID * addr, INT32 size, BOOL isPrefetch, BOOL isStatic, const VariableSymbol *staticVars)
 {
 	if(!isPrefetch) // if this is not a prefetch memory access instruction  
 	{
@@ -507,10 +1064,19 @@ static VOID RecordMem(CONTEXT * context, CHAR r, VOID * addr, INT32 size, BOOL i
 			if (addr >= esp) return;  // if we are reading from the stack range, ignore this access
 		}
 
-		string ftnName=CallStack.top(); //top of the stack is the currently open function
+		// the accesses which are not sampled are not even resolved, quad-analyzer and quad-replay sample themselves
+		if (!Analyzer_Ring && !Trace_Writer && !Quad_Engine.samples(tid, (ADDRINT)addr, size))
+			return;
+
+		SelfProfile *profile=GetThreadProfile(tid);
+		ADDRINT ftnId=CurrentFunctionId(tid, context); //top of the stack is the currently open function
+		ADDRINT topId=ftnId;
+		
+		profile->counters[SP_ACCESSES]++;
 		
 		if(BBMODE)
 		{
+			string ftnName=Quad_Engine.functionName(ftnId);
 			string filename;    // This will hold the source file name.
 			INT32 line = 0;     // This will hold the line number within the file.
 			
@@ -521,34 +1087,186 @@ static VOID RecordMem(CONTEXT * context, CHAR r, VOID * addr, INT32 size, BOOL i
 			ADDRINT ip = PIN_GetContextReg(context, REG_EIP);
 			PIN_GetSourceLocation(ip, NULL, &line, &filename);
 			PIN_UnlockClient();
-			ftnName = bblist.probeBB(filename, ftnName, line);
+			string bbName = bblist.probeBB(filename, ftnName, line);
 			
-			if(NameToFunction.find(ftnName)==NameToFunction.end()) {
-				NameToFunction[ftnName]=CallStack.top();
-			}
+			Quad_Engine.defineBasicBlock(bbName, ftnName);
+			ftnId=FunctionId(bbName);
 		}
 		
-		if(!SeenFname.count(ftnName))  // this is the first time I see this function name in charge of access
+		UINT64 start=SelfTimerStart();
+		const VariableSymbol* vars = isStatic ? staticVars : findVariable(context, addr, size);
+		if (symbol_resolver != 0 && !isStatic)
 		{
-			SeenFname.insert(ftnName);  // mark this function name as seen
-			GlobalfunctionNo++;      // create a dummy Function Number for this function
-			NametoADD[ftnName]=GlobalfunctionNo;   // create the string -> Number binding
-			ADDtoName[GlobalfunctionNo]=ftnName;   // create the Number -> String binding
-		} 
+			profile->counters[SP_RESOLVER_CALLS]++;
+			if (vars)
+				profile->counters[SP_RESOLVER_HITS]++;
+			SelfTimerStop(profile, ST_RESOLVER, start);
+		}
+
+		if (Analyzer_Ring)
+		{
+			ForwardAccess((ADDRINT)addr, size, ftnId, vars, r=='W');
+			return;
+		}
+
+		if (Trace_Writer)
+		{
+			// quad-replay follows the calls, the function is only recorded for basic blocks
+			Trace_Writer->access(tid, (ADDRINT)addr, size, ftnId, VariableId(vars), r=='W', ftnId != topId);
+			return;
+		}
 
-		const VariableSymbol* vars = findVariable(context, addr, size);
+		const vector<SharedRegion> *regions = (const vector<SharedRegion>*) SharedRegions;
+		if (Ipc_Channels && regions != 0 && !regions->empty())
+		{
+			const SharedRegion *shm = FindSharedRegion(regions, (ADDRINT)addr);
+			if (shm)
+			{
+				RecordSharedMemoryAccess(shm, (ADDRINT)addr, size, ftnId, vars, r=='W');
+				return;
+			}
+		}
 
-		for(int i=0;i<size;i++)
-		{	
-			RecordMemoryAccess((ADDRINT)addr,NametoADD[ftnName], vars, r=='W');
-			addr=((char *)addr)+1;  // cast not needed anyway!
-		} //end for
+		Quad_Engine.onAccess((ADDRINT)addr, size, ftnId, vars, r=='W');
 
 	}// end of not a prefetch
 }
 
 /* ===================================================================== */
 
+// reports the memory of the analysis and checks it with the symbol tables against the limit, once every million
+// instructions (the engine also checks its limit itself as its shards grow)
+VOID CheckMemory()
+{
+	UINT64 symbolBytes;
+	
+	// the accesses are not analyzed in this process
+	if (Count_Only || Analyzer_Ring || Trace_Writer || !Profile_This_Process)
+		return;
+	
+	symbolBytes = symbol_resolver != 0 ? symbol_resolver->memoryUsage() : 0;
+	if (Memory_Report_Interval > 0 && Total_M_Ins % Memory_Report_Interval == 0)
+	{
+		EngineStatistics stats;
+		
+		Quad_Engine.statistics(stats);
+		cerr << "\nMemory after " << Total_M_Ins << " M instructions (KB): shadow " << (stats.shadowBytes >> 10)
+			<< ", bindings " << (stats.bindingBytes >> 10) << ", UnMA sets " << (stats.unmaBytes >> 10)
+			<< ", symbols " << (symbolBytes >> 10)
+			<< ", total " << ((stats.shadowBytes + stats.bindingBytes + stats.unmaBytes + symbolBytes) >> 10)
+			<< ", resident " << residentKB() << endl;
+	}
+	if (Max_Memory_MB > 0)
+		Quad_Engine.checkMemory(symbolBytes);
+}
+
+// estimates the instructions per second of this machine without Pin, with a loop of simple
+// instructions (the tool itself is not instrumented). Real applications execute less instructions
+// per cycle, so this overestimates the slowdown, which keeps the overhead under the budget.
+// The loop delays the start of the application by at most CALIBRATION_SECONDS.
+#define CALIBRATION_SECONDS 0.1
+
+// runs 'iterations' (at least one) iterations of a loop of simple instructions, returns the number
+// of instructions executed
+static UINT64 CalibrationLoop(UINT32 iterations)
+{
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	UINT32 x = 1, y = 3, n = iterations;
+	
+	// written in assembly, so the optimizer can not change the 4 instructions of an iteration
+	__asm__ __volatile__ (
+		"1:\n\t"
+		"addl %1, %0\n\t"
+		"xorl %0, %1\n\t"
+		"decl %2\n\t"
+		"jnz 1b\n\t"
+		: "+r"(x), "+r"(y), "+r"(n) : : "cc");
+	return 4ULL * iterations;
+#else
+	volatile UINT32 sink;
+	UINT32 x = 1;
+	
+	// about 5 instructions an iteration (multiply, add, increment, compare and branch), depending on the compiler
+	for (UINT32 i = 0; i < iterations; i++)
+		x = x * 1103515245 + 12345;
+	sink = x;
+	(void)sink;
+	return 5ULL * iterations;
+#endif
+}
+
+double CalibrateNativeIPS()
+{
+	const UINT32 chunk = 1000000, max_chunks = 50;
+	UINT64 instructions = 0;
+	UINT32 chunks = 0;
+	double start = wallSeconds(), elapsed;
+	
+	do
+	{
+		instructions += CalibrationLoop(chunk);
+		chunks++;
+		elapsed = wallSeconds() - start;
+	}
+	while (chunks < max_chunks && elapsed < CALIBRATION_SECONDS);
+	return elapsed > 0 ? instructions / elapsed : 1e9;
+}
+
+// the instrumentation changes at the next code cache miss: the code cache is flushed, the traces
+// running now finish with their old instrumentation
+VOID SetFidelity(UINT32 fidelity, double slowdown)
+{
+	FidelityPhase phase = {fidelity, Total_M_Ins};
+	
+	cerr << "\nSlowdown " << fixed << setprecision(1) << slowdown << "x (budget " << Overhead_Budget << "x), switching to "
+		<< Fidelity_Names[fidelity] << " after " << Total_M_Ins << " M instructions" << endl;
+	Stepped_Up = fidelity < Current_Fidelity;
+	Current_Fidelity = fidelity;
+	Fidelity_Phases.push_back(phase);
+	Windows_At_Fidelity = 0;
+	PIN_RemoveInstrumentation();
+}
+
+// measures the slowdown of the application over the last second and changes the fidelity of the
+// instrumentation to keep it within the budget, once every million instructions
+VOID ControlOverhead()
+{
+	double now, slowdown;
+	
+	// the accesses are not analyzed in this process
+	if (Count_Only || Analyzer_Ring || Trace_Writer || !Profile_This_Process)
+		return;
+	
+	PIN_GetLock(&Overhead_Lock, 1);
+	now = wallSeconds();
+	if (now - Window_Start < 1.0)
+	{
+		PIN_ReleaseLock(&Overhead_Lock);
+		return;
+	}
+	slowdown = Native_IPS * (now - Window_Start) / ((Total_M_Ins - Window_Start_M_Ins) * 1e6);
+	Window_Start = now;
+	Window_Start_M_Ins = Total_M_Ins;
+	
+	// the first window after a change also pays for instrumenting the code again
+	if (Windows_At_Fidelity++ == 0)
+	{
+		PIN_ReleaseLock(&Overhead_Lock);
+		return;
+	}
+	
+	if (slowdown > Overhead_Budget && Current_Fidelity != FIDELITY_CALLS)
+	{
+		// over the budget right after stepping up: wait twice as long before the next try
+		if (Stepped_Up && Windows_At_Fidelity <= 2 && Step_Up_Backoff < 64)
+			Step_Up_Backoff *= 2;
+		SetFidelity(Current_Fidelity + 1, slowdown);
+	}
+	else if (slowdown < Overhead_Budget / 2.0 && Current_Fidelity != FIDELITY_FULL && Windows_At_Fidelity > Step_Up_Backoff)
+		SetFidelity(Current_Fidelity - 1, slowdown);
+	PIN_ReleaseLock(&Overhead_Lock);
+}
+
 // increment routine for the total instruction counter
 VOID IncreaseTotalInstCounter()
 {
@@ -561,6 +1279,12 @@ VOID IncreaseTotalInstCounter()
 			cout<<(char)(13)<<"                                                                   ";
 			cout<<(char)(13)<<"Instructions executed so far = "<<Total_M_Ins<<" M";
 		}
+		if (Self_Profile && Self_Profile_Interval > 0 && Total_M_Ins % Self_Profile_Interval == 0)
+			WriteSelfProfile("after " + no2str(Total_M_Ins) + " M instructions");
+		if (Max_Memory_MB > 0 || Memory_Report_Interval > 0)
+			CheckMemory();
+		if (Overhead_Budget > 0)
+			ControlOverhead();
 	}
 	if (!Count_Only && (Progress_Ins > 0 || Progress_M_Ins > 0)) {
 		double PTot = Progress_Ins / 100 + Progress_M_Ins * 10000 /*one million divided by one hundred*/;
@@ -579,6 +1303,58 @@ VOID IncreaseTotalInstCounter()
 
 /* ===================================================================== */
 
+// true on the pages recorded at FIDELITY_SAMPLED (inlined by Pin). With a power of two '-sample_pages'
+// the pages of the smaller sample are all in the larger one, so producers and consumers still meet
+static ADDRINT OnSampledPage(ADDRINT addr)
+{
+	return (pageHash(addr) & Overhead_Sample_Mask) == 0;
+}
+
+// resolves the variable of the memory operand of 'ins' when it is at a fixed offset of the stack or frame
+// pointer ([esp+k], [ebp+k]), so it is not resolved on every access. Returns TRUE if the variable is known,
+// *vars may still be NULL if there is no variable at the operand.
+static BOOL StaticVariable(INS ins, const VariableSymbol **vars)
+{
+	enum eRegister base;
+	
+	*vars = NULL;
+	if (symbol_resolver == 0 || INS_MemoryOperandCount(ins) != 1)
+		return FALSE;
+	
+	for (UINT32 op = 0; op < INS_OperandCount(ins); op++)
+	{
+		// push, pop, call and ret access the stack implicitly
+		if (!INS_OperandIsMemory(ins, op) || INS_OperandIsImplicit(ins, op))
+			continue;
+		if (INS_OperandMemoryIndexReg(ins, op) != REG_INVALID() ||
+			PinExecutionContext::mapRegisterFromPin(INS_OperandMemoryBaseReg(ins, op), &base) != 0 ||
+			(base != EREG_STACK_POINTER && base != EREG_BASE_POINTER))
+			return FALSE;
+		return symbol_resolver->resolveStaticVariable((void*)INS_Address(ins), base, (long)INS_OperandMemoryDisplacement(ins, op),
+			INS_MemoryOperandSize(ins, 0), vars) <= 1;
+	}
+	return FALSE;
+}
+
+// records the access of 'ins' at 'ea' ('size' bytes), at FIDELITY_SAMPLED only on the sampled pages
+static VOID InsertRecordMem(INS ins, UINT32 r, IARG_TYPE ea, IARG_TYPE size)
+{
+	const VariableSymbol *vars;
+	BOOL isStatic = StaticVariable(ins, &vars);
+	
+	if (Current_Fidelity == FIDELITY_SAMPLED)
+	{
+		INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)OnSampledPage, ea, IARG_END);
+		INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
+			IARG_THREAD_ID, IARG_CONTEXT, IARG_UINT32, r, ea, size, IARG_UINT32, INS_IsPrefetch(ins),
+			IARG_BOOL, isStatic, IARG_PTR, vars, IARG_END);
+	}
+	else
+		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
+			IARG_THREAD_ID, IARG_CONTEXT, IARG_UINT32, r, ea, size, IARG_UINT32, INS_IsPrefetch(ins),
+			IARG_BOOL, isStatic, IARG_PTR, vars, IARG_END);
+}
+
 // Is called for every instruction and instruments reads and writes and the Ret instruction
 VOID Instruction(INS ins, VOID *v)
 {
@@ -587,66 +1363,36 @@ VOID Instruction(INS ins, VOID *v)
 	INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)IncreaseTotalInstCounter, IARG_END);
 
 	if (INS_IsProcedureCall(ins)) {
-		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)Call, IARG_CONTEXT, IARG_BRANCH_TARGET_ADDR, IARG_END);
+		// the symbol resolver needs the full context, do not pay for it otherwise
+		if (symbol_resolver != 0)
+			INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)Call, IARG_CONTEXT, IARG_BRANCH_TARGET_ADDR, IARG_END);
 	}
 	else if (INS_IsRet(ins))  	
 	{
 		// we are monitoring the 'ret' instructions since we need to know when we are leaving functions 
-		//in order to update our own virtual 'Call Stack'. The mechanism to inject instrumentation code 
-		//to update the Call Stack (pop) upon leave is not implemented directly contrary to the dive 
-		//in mechanism. Could be a point for further improvement?! ...
-		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)Return, IARG_CONTEXT, IARG_END);
+		//in order to update our shadow call stack, the frames are matched on the stack pointer
+		INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)ShadowReturn, IARG_THREAD_ID, IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+		if (symbol_resolver != 0)
+			INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)Return, IARG_CONTEXT, IARG_END);
 	}
-	else if (!Count_Only) //no need to record memory accesses in count only mode
+	else if (!Count_Only && Current_Fidelity != FIDELITY_CALLS) //no need to record memory accesses in count only mode
 	{
 		//Real filter for functions in Monitor List
 		//record memory access by those functions only which are inside the selected instrumentation function list
-		string currFtnName = CallStack.top();
+		RTN rtn = INS_Rtn(ins);
+		string currFtnName = RTN_Valid(rtn) ? RTN_Name(rtn) : "";
 		bool inSIFList = ( std::find(SIFL_OUTPUT.begin(), SIFL_OUTPUT.end(), currFtnName) != SIFL_OUTPUT.end() );
 			
 		if( (Select_Instr_ON == FALSE) || (inSIFList == TRUE ) )
 		{
 			if (INS_IsMemoryRead(ins) || INS_IsStackRead(ins) )
-			{
-				INS_InsertPredicatedCall
-					(
-					ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
-					IARG_CONTEXT,
-					IARG_UINT32, 'R',
-					IARG_MEMORYREAD_EA,
-					IARG_MEMORYREAD_SIZE,
-					IARG_UINT32, INS_IsPrefetch(ins),
-					IARG_END
-					);
-			}
+				InsertRecordMem(ins, 'R', IARG_MEMORYREAD_EA, IARG_MEMORYREAD_SIZE);
 
 			if (INS_HasMemoryRead2(ins))
-			{
-				INS_InsertPredicatedCall
-					(
-					ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
-					IARG_CONTEXT,
-					IARG_UINT32, 'R',
-					IARG_MEMORYREAD2_EA,
-					IARG_MEMORYREAD_SIZE,
-					IARG_UINT32, INS_IsPrefetch(ins),
-					IARG_END
-					);
-			}
+				InsertRecordMem(ins, 'R', IARG_MEMORYREAD2_EA, IARG_MEMORYREAD_SIZE);
 
 			if (INS_IsMemoryWrite(ins) || INS_IsStackWrite(ins) ) 
-			{
-				INS_InsertPredicatedCall
-					(
-					ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
-					IARG_CONTEXT,
-					IARG_UINT32, 'W',
-					IARG_MEMORYWRITE_EA,
-					IARG_MEMORYWRITE_SIZE,
-					IARG_UINT32, INS_IsPrefetch(ins),
-					IARG_END
-					);
-			}
+				InsertRecordMem(ins, 'W', IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE);
 		}
 	}
 }
@@ -670,15 +1416,15 @@ int main(int argc, char *argv[])
 	string applicationName;
 	char temp[100];
 
-	// assume Out_of_the_main_function_scope as the first routine
-	CallStack.push("Out_of_the_main_function_scope");
+	// assume Out_of_the_main_function_scope as the first routine (the bottom of every shadow call stack)
 	SeenFname.insert("Out_of_the_main_function_scope");
 	NametoADD["Out_of_the_main_function_scope"]=GlobalfunctionNo; 
-	ADDtoName[GlobalfunctionNo]="Out_of_the_main_function_scope";
+	Quad_Engine.defineFunction(GlobalfunctionNo, "Out_of_the_main_function_scope");
+	Quad_Engine.setBottomFunction(GlobalfunctionNo);
 
 	// reserve the function ID #0 for the case of reading from a memory with no producer!
 	NametoADD["UNKNOWN_PRODUCER(CONSTANT_DATA)"]=0x0; 
-	ADDtoName[0x0]="UNKNOWN_PRODUCER(CONSTANT_DATA)";
+	Quad_Engine.defineFunction(0x0, "UNKNOWN_PRODUCER(CONSTANT_DATA)");
 
 	PIN_InitSymbols();
 
@@ -706,6 +1452,75 @@ int main(int argc, char *argv[])
 	Uncommon_Functions_Filter=KnobIgnoreUncommonFNames.Value(); // interested in uncommon function names or not?
 	Include_External_Images=KnobIncludeExternalImages.Value(); // include/exclude external image files?
 	Verbose_ON=KnobVerbose_ON.Value();  // print something or not during execution
+	Dwarf_Verbose=KnobDwarfVerbose.Value(); // the diagnostics of the DWARF symbol resolver
+	Dwarf_Threads=KnobDwarfThreads.Value(); // index the DWARF information in the background or not?
+	Symbol_Cache_Dir=KnobSymbolCache.Value(); // keep the symbol index between runs or not?
+	Ipc_Channels=KnobIpcChannels.Value(); // record inter-process transfers or not?
+	Num_Shard_Workers=KnobShards.Value(); // analyze the accesses in worker threads or not?
+	Num_Report_Workers=KnobReportThreads.Value(); // prepare the reports in parallel or not?
+	Self_Profile=KnobSelfProfile.Value(); // write the self profile or not?
+	Self_Profile_Timers=KnobSelfProfileTimers.Value(); // measure the stages of the analysis or not?
+	Self_Profile_Interval=KnobSelfProfileInterval.Value();
+	Max_Memory_MB=KnobMaxMemoryMB.Value(); // keep the analysis within a memory limit or not?
+	Memory_Report_Interval=KnobMemoryReportInterval.Value();
+	Overhead_Budget=KnobOverheadBudget.Value(); // switch the instrumentation level at run time or not?
+	Overhead_Sample_Mask=KnobOverheadSample.Value() - 1;
+	if (Overhead_Budget > 0 && (KnobOverheadSample.Value() == 0 || (KnobOverheadSample.Value() & Overhead_Sample_Mask)))
+	{
+		cerr << "\n'-overhead_sample' must be a power of two... Aborting!\n";
+		return 4;
+	}
+	
+	// what to show in the reports
+	EngineOptions options;
+	options.bbFuncCount=KnobBBFuncCount.Value();
+	options.showBytes=KnobDotShowBytes.Value();
+	options.showUnDVs=KnobDotShowUnDVs.Value();
+	options.showRanges=KnobDotShowRanges.Value();
+	options.rangesLimit=KnobDotShowRangesLimit.Value();
+	options.showVariables=KnobElf.Value();
+	options.variableCount=KnobVariableCount.Value();
+	options.granularity=KnobGranularity.Value();
+	options.samplePages=KnobSamplePages.Value();
+	options.sampleAccesses=KnobSampleAccesses.Value();
+	options.unmaSketchBits=KnobUnMASketch.Value();
+	Quad_Engine.setOptions(options);
+	Quad_Engine.setMemoryLimit((UINT64)Max_Memory_MB << 20);
+
+	PIN_InitLock(&VariableIds_Lock);
+	
+	if (!Count_Only && !KnobAnalyzerShm.Value().empty())
+	{
+		if (Ipc_Channels)
+		{
+			cerr << "\nThe inter-process channels can not be recorded with quad-analyzer, ignoring '-ipc_channels'..." << endl;
+			Ipc_Channels = FALSE;
+		}
+		if (AttachAnalyzer(KnobAnalyzerShm.Value()))
+		{
+			cerr << "\nCan not attach to quad-analyzer (" << KnobAnalyzerShm.Value() << ")... Aborting!\n";
+			return 4;
+		}
+	}
+
+	if (!Count_Only && !KnobRecordTrace.Value().empty())
+	{
+		if (Analyzer_Ring)
+		{
+			cerr << "\nThe accesses can not be both forwarded to quad-analyzer and recorded in a trace... Aborting!\n";
+			return 4;
+		}
+		if (Ipc_Channels)
+		{
+			cerr << "\nThe inter-process channels can not be recorded in a trace, ignoring '-ipc_channels'..." << endl;
+			Ipc_Channels = FALSE;
+		}
+		if (StartTrace(KnobRecordTrace.Value()))
+		{
+			cerr << "\nCan not create the trace file (" << KnobRecordTrace.Value() << ")... Aborting!\n";
+			return 4;
+		}
+	}
 
 	if (!Count_Only)
 	{
@@ -717,13 +1532,15 @@ int main(int argc, char *argv[])
 		}
 		// ----------------------------------------------------------------------------------
 		
-		// ------------------ XML file pre-processing ---------------------------------------   
-		string ns("q2:");
-		q2xml = new Q2XMLFile(xmlfilename,ns,applicationName);
+		// ------------------ XML file, shadow memory shards and their worker threads --------
+		if (Quad_Engine.start(xmlfilename, applicationName, Num_Shard_Workers, Num_Report_Workers))
+		{
+			cerr<<"\nCan not start the tracing engine... Aborting!\n";
+			return 5;
+		}
 		// ----------------------------------------------------------------------------------
 		
 		// ------------------ flag setting and image name ------------------------------------   
-		Monitor_ON = !monitorfilename.empty();	//set the flag if monitor file is specified
 		Select_Instr_ON = !selInstrfilename.empty(); //set the flag if selected instrumentation file is specified
 		
 		// parse the command line arguments for the main image name
@@ -771,7 +1588,7 @@ int main(int argc, char *argv[])
 		}
 		
 		// ------------------ Monitorlist file processing -----------------------------------
-		if (Monitor_ON)  // user is interested in filtering out 
+		if (!monitorfilename.empty())  // user is interested in filtering out 
 		{
 			ifstream monitorin;
 			monitorin.open(monitorfilename.c_str());
@@ -781,7 +1598,6 @@ int main(int argc, char *argv[])
 				return 4;
 			}
 		
-			TTL_ML_Data_Pack * DPP;
 			string item;
 			int itemCount=0;	//count of the items on list, to give a warning in case its empty
 			while(!monitorin.eof())
@@ -789,24 +1605,7 @@ int main(int argc, char *argv[])
 				monitorin>>item;	// get the next function name in the monitor list
 				if (!item.empty())
 				{
-					
-					DPP=new TTL_ML_Data_Pack;
-					if (!DPP) 
-					{
-						cerr<<"\nMemory allocation failure in monitor list construction... Aborting!\n";
-						return 5;
-					}
-				
-					DPP->total_IN_ML=0;
-					DPP->total_OUT_ML=0;
-					DPP->total_IN_ML_UMA=0;
-					DPP->total_OUT_ML_UMA=0;
-					DPP->total_IN_ALL=0;
-					DPP->total_OUT_ALL=0;
-					DPP->total_IN_ALL_UMA=0;
-					DPP->total_OUT_ALL_UMA=0;
-				
-					ML_OUTPUT[item]=DPP;
+					Quad_Engine.monitor(item);
 					itemCount++;
 				}
 			}
@@ -823,9 +1622,22 @@ int main(int argc, char *argv[])
 
 
 		RTN_AddInstrumentFunction(UpdateCurrentFunctionName,0);
+		
+		if (Ipc_Channels)
+		{
+			PIN_InitLock(&SharedRegions_Lock);
+			PIN_InitLock(&Pending_Syscalls_Lock);
+			PIN_AddSyscallEntryFunction(SyscallEntry, 0);
+			PIN_AddSyscallExitFunction(SyscallExit, 0);
+		}
 	}
 	
+	PIN_AddForkFunction(FPOINT_BEFORE, ForkBefore, 0);
+	PIN_AddForkFunction(FPOINT_AFTER_IN_PARENT, ForkParent, 0);
+	PIN_AddForkFunction(FPOINT_AFTER_IN_CHILD, ForkChild, 0);
+	
 	INS_AddInstrumentFunction(Instruction, 0);
+	PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
 	PIN_AddFiniFunction(Fini, 0); 
 
 	cerr << "Starting the application to be analysed..." << endl;
@@ -843,10 +1655,19 @@ int main(int argc, char *argv[])
 #ifdef QUAD_LIBDWARF
 		if (elf_handle != NULL) {
 			cerr << "Creating DWARF symbol resolver" << endl;
-			DwarfSymbolResolver::createDwarfSymbolResolver(elf_handle, (DwarfSymbolResolver**) &symbol_resolver);
+			if (DwarfSymbolResolver::createDwarfSymbolResolver(elf_handle, &dwarf_resolver, Dwarf_Verbose,
+					Symbol_Cache_Dir.empty() ? 0 : Symbol_Cache_Dir.c_str()) == 0) {
+				symbol_resolver = new CachingSymbolResolver(dwarf_resolver);
+				if (Dwarf_Threads > 0)
+					dwarf_resolver->startIndexThreads(main_image_path, Dwarf_Threads);
+			}
 			cerr << "Success." << endl;
 		}
 #endif // QUAD_LIBDWARF
+		// without DWARF information the functions and globals of the symbol table are resolved
+		if (symbol_resolver == 0 && ElfSymbolResolver::createElfSymbolResolver(&elf_resolver, main_image_path,
+				Symbol_Cache_Dir.empty() ? 0 : Symbol_Cache_Dir.c_str()) == 0)
+			symbol_resolver = new CachingSymbolResolver(elf_resolver);
 		// We read the symbol array
 
 		if(elf_handle==NULL) {
@@ -888,8 +1709,8 @@ int main(int argc, char *argv[])
 								  elf_strptr(elf_handle, shdr.sh_link, sym.st_name),
 								  (int)sym.st_value, (int)sym.st_size);
 							}
-							globalSymbols[string(elf_strptr(elf_handle, shdr.sh_link, sym.st_name))] =
-							  new GlobalSymbol((int)sym.st_value, (int)sym.st_size);
+							Quad_Engine.defineGlobalSymbol(string(elf_strptr(elf_handle, shdr.sh_link, sym.st_name)),
+							  (int)sym.st_value, (int)sym.st_size);
 						}
 					}
 				}
@@ -899,6 +1720,17 @@ int main(int argc, char *argv[])
 	}
 #endif // QUAD_LIBELF
 
+	if (Overhead_Budget > 0 && !Count_Only)
+	{
+		FidelityPhase phase = {FIDELITY_FULL, 0};
+		
+		Native_IPS = KnobNativeMIPS.Value() > 0 ? KnobNativeMIPS.Value() * 1e6 : CalibrateNativeIPS();
+		cerr << "Keeping the slowdown under " << Overhead_Budget << "x of " << (UINT64)(Native_IPS / 1e6) << " M instructions per second" << endl;
+		PIN_InitLock(&Overhead_Lock);
+		Fidelity_Phases.push_back(phase);
+		Window_Start = wallSeconds();
+	}
+
 	PIN_StartProgram(); // Never returns
 
 	return 0;
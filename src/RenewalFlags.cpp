@@ -27,13 +27,15 @@ case 1: If the consumer is already available and the status is OLD, nothing will
 case 2: If the consumer is already available and the status is FRESH, it will be set to OLD and true will be returned.
 case 3: If this consumer is not already available (not known) then it will be added to the array with OLD status.
 case 4: When adding new consumers, if there is no capacity, then it is created and this new consumer is added with OLD Status.
+The number of flags compared is added to 'scanned' (self profile).
 */
-bool FNodeList::ClearFlag(ADDRINT cons)
+bool FNodeList::ClearFlag(ADDRINT cons, UINT64 &scanned)
 {
 	int i;
 	
 	for(i=0; i<Size; i++)
 	{
+		scanned++;
 		if(Array[i].getConsumer() == cons )
 		{
 			if(Array[i].getFlag() == OLD ) //case 1
@@ -57,12 +59,11 @@ bool FNodeList::ClearFlag(ADDRINT cons)
 		for(i=0; i<Size; i++)
 			tempArray[i] = Array[i];
 		
+		delete [] Array;
 		Array = tempArray;
 		Array[i].setConsumer(cons);
 		Array[i].setFlag(OLD);
 		Size++;
-		
-		delete [] tempArray;
 	}
 	return true;
 }
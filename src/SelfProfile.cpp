@@ -0,0 +1,154 @@
+/*
+ * SelfProfile.cpp
+ *
+ * This file contains the self profile of QUAD, see SelfProfile.h.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+
+#include "SelfProfile.h"
+#include "tracing.h"
+#include "Utility.h"
+#include "ThreadTable.h"
+
+BOOL Self_Profile_Timers = FALSE;
+
+// the profiles of the application threads and of the shard workers, created on first use
+static ThreadTable<SelfProfile*> Thread_Profiles;
+static ThreadTable<SelfProfile*> Shard_Profiles;
+
+static const char *Counter_Names[SP_NUM_COUNTERS] = {
+	"memory accesses instrumented",
+	"bytes recorded in the shadow memory",
+	"shadow trie nodes allocated",
+	"shadow leaves allocated",
+	"binding lookups",
+	"bindings created",
+	"ClearFlag calls",
+	"ClearFlag flags scanned",
+	"symbol resolver calls",
+	"symbol resolver hits",
+	"symbol resolver cache hits",
+	"calls tracked",
+	"frames popped",
+	"report items written"
+};
+
+static const char *Timer_Names[ST_NUM_TIMERS] = {
+	"shadow memory (with bindings)",
+	"bindings",
+	"symbol resolver",
+	"call tracking",
+	"reports"
+};
+
+// every slot is used by one thread only, so it is never created twice
+static SelfProfile *GetSelfProfile(ThreadTable<SelfProfile*> &profiles, unsigned int slot)
+{
+	SelfProfile *&profile = profiles[slot];
+
+	if (!profile)
+		profile = new SelfProfile();
+	return profile;
+}
+
+SelfProfile *GetThreadProfile(THREADID tid)
+{
+	return GetSelfProfile(Thread_Profiles, tid);
+}
+
+SelfProfile *GetShardProfile(unsigned int shard)
+{
+	return GetSelfProfile(Shard_Profiles, shard);
+}
+
+static VOID ResetSelfProfiles(ThreadTable<SelfProfile*> &profiles)
+{
+	SelfProfile **profile;
+
+	for (unsigned int s = 0; s < profiles.size(); s++)
+		if ((profile = profiles.find(s)) && *profile)
+			**profile = SelfProfile();
+}
+
+VOID ResetSelfProfile()
+{
+	ResetSelfProfiles(Thread_Profiles);
+	ResetSelfProfiles(Shard_Profiles);
+}
+
+// adds the profiles of 'profiles' to 'total'
+static VOID SumSelfProfiles(ThreadTable<SelfProfile*> &profiles, SelfProfile &total)
+{
+	SelfProfile **profile;
+
+	for (unsigned int s = 0; s < profiles.size(); s++)
+	{
+		if (!(profile = profiles.find(s)) || !*profile)
+			continue;
+		for (unsigned int c = 0; c < SP_NUM_COUNTERS; c++)
+			total.counters[c] += (*profile)->counters[c];
+		for (unsigned int t = 0; t < ST_NUM_TIMERS; t++)
+			total.cycles[t] += (*profile)->cycles[t];
+	}
+}
+
+// the ratio of two counters, 0 if there is nothing to divide
+static double Ratio(UINT64 a, UINT64 b)
+{
+	return b ? (double)a / b : 0.0;
+}
+
+int WriteSelfProfile(const string &when)
+{
+	string fileName = suffixFileName("QUAD_self_profile.txt", Output_Suffix);
+	ofstream out(fileName.c_str());
+	SelfProfile total = SelfProfile();
+	UINT64 timed = 0;
+
+	if (!out)
+	{
+		cerr << "Can not create " << fileName << endl;
+		return 1;
+	}
+
+	// the other threads may still be counting, the sum is only a snapshot
+	SumSelfProfiles(Thread_Profiles, total);
+	SumSelfProfiles(Shard_Profiles, total);
+
+	out << "QUAD self profile, " << when << endl << endl;
+
+	out << setw(40) << left << "counter" << setw(20) << right << "total" << endl;
+	for (unsigned int c = 0; c < SP_NUM_COUNTERS; c++)
+		out << setw(40) << left << Counter_Names[c] << setw(20) << right << total.counters[c] << endl;
+
+	out << endl << fixed << setprecision(2);
+	out << setw(40) << left << "ClearFlag average scan length" << setw(20) << right
+		<< Ratio(total.counters[SP_CLEARFLAG_SCANNED], total.counters[SP_CLEARFLAG_CALLS]) << endl;
+	out << setw(40) << left << "symbol resolver hit rate (%)" << setw(20) << right
+		<< 100 * Ratio(total.counters[SP_RESOLVER_HITS], total.counters[SP_RESOLVER_CALLS]) << endl;
+	out << setw(40) << left << "symbol resolver cache hit rate (%)" << setw(20) << right
+		<< 100 * Ratio(total.counters[SP_RESOLVER_CACHE_HITS], total.counters[SP_RESOLVER_CALLS]) << endl;
+	out << setw(40) << left << "shadow bytes per access" << setw(20) << right
+		<< Ratio(total.counters[SP_SHADOW_BYTES], total.counters[SP_ACCESSES]) << endl;
+
+	if (!Self_Profile_Timers)
+	{
+		out << endl << "(run with '-self_profile_timers 1' for the cycles spent in every stage)" << endl;
+		return 0;
+	}
+
+	// the bindings are part of the shadow memory stage
+	for (unsigned int t = 0; t < ST_NUM_TIMERS; t++)
+		if (t != ST_BINDINGS)
+			timed += total.cycles[t];
+
+	out << endl << setw(40) << left << "timer" << setw(20) << right << "cycles" << setw(10) << "share" << endl;
+	for (unsigned int t = 0; t < ST_NUM_TIMERS; t++)
+		out << setw(40) << left << Timer_Names[t] << setw(20) << right << total.cycles[t]
+			<< setw(9) << 100 * Ratio(total.cycles[t], timed) << "%" << endl;
+	return 0;
+}
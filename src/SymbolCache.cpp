@@ -0,0 +1,235 @@
+/*****
+ *
+ * SymbolCache.cpp
+ *
+ * The index cache files of the symbol resolvers, see SymbolCache.h.
+ *
+ *****/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#include "SymbolCache.h"
+#include "gelf.h"
+
+#ifndef NT_GNU_BUILD_ID
+#define NT_GNU_BUILD_ID 3
+#endif
+
+using namespace std;
+
+static string toHex(const unsigned char *bytes, size_t size) {
+	ostringstream	digits;
+
+	for (size_t i = 0; i < size; i++) {
+		digits << setw(2) << setfill('0') << std::hex << (unsigned int) bytes[i];
+	}
+	return digits.str();
+}
+
+// the notes are a name and a descriptor of 4-byte aligned sizes, after a header of three 32-bit words
+static string findBuildId(const unsigned char *notes, size_t size) {
+	size_t	pos = 0;
+
+	while (pos + 12 <= size) {
+		unsigned int namesz, descsz, type;
+
+		memcpy(&namesz, notes + pos, 4);
+		memcpy(&descsz, notes + pos + 4, 4);
+		memcpy(&type, notes + pos + 8, 4);
+		pos += 12;
+
+		size_t name = pos;
+		size_t desc = name + ((namesz + 3) & ~3U);
+		pos = desc + ((descsz + 3) & ~3U);
+		if (pos > size) {
+			break;
+		}
+		if (type == NT_GNU_BUILD_ID && namesz == 4 && memcmp(notes + name, "GNU", 4) == 0 && descsz > 0) {
+			return toHex(notes + desc, descsz);
+		}
+	}
+	return "";
+}
+
+string getSymbolCacheKey(Elf *elf) {
+	Elf_Scn		*scn = NULL;
+	GElf_Shdr	shdr;
+	Elf_Data	*data;
+	char		*raw;
+	size_t		size;
+
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		if (gelf_getshdr(scn, &shdr) == &shdr && shdr.sh_type == SHT_NOTE) {
+			if ((data = elf_getdata(scn, NULL)) != NULL && data->d_buf != NULL) {
+				string id = findBuildId((const unsigned char*) data->d_buf, data->d_size);
+				if (!id.empty()) {
+					return id;
+				}
+			}
+		}
+	}
+
+	// no build-id: the FNV-1a hash of the file, with its size
+	if ((raw = elf_rawfile(elf, &size)) == NULL) {
+		return "";
+	}
+
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ (unsigned char) raw[i]) * 0x100000001b3ULL;
+	}
+
+	ostringstream key;
+	key << "hash-" << std::hex << setw(16) << setfill('0') << hash << "-" << size;
+	return key.str();
+}
+
+string getSymbolCachePath(const string &dir, const string &key, const char *kind) {
+	return dir + "/" + key + "." + kind;
+}
+
+SymbolCacheWriter::SymbolCacheWriter(const string &path, const string &key) : path(path), key(key) {
+}
+
+void SymbolCacheWriter::encode(string &out, unsigned long long value) {
+	while (value >= 0x80) {
+		out += (char) (0x80 | (value & 0x7f));
+		value >>= 7;
+	}
+	out += (char) value;
+}
+
+void SymbolCacheWriter::putNumber(unsigned long long value) {
+	encode(records, value);
+}
+
+void SymbolCacheWriter::putName(const string &name) {
+	map<string, unsigned long long>::iterator	nit = name_ids.find(name);
+
+	if (nit == name_ids.end()) {
+		nit = name_ids.insert(make_pair(name, (unsigned long long) names.size())).first;
+		names.push_back(&nit->first);
+	}
+	encode(records, nit->second);
+}
+
+unsigned int SymbolCacheWriter::close() {
+	string		header(SYMBOL_CACHE_MAGIC, SYMBOL_CACHE_MAGIC_SIZE);
+	FILE		*file;
+	ostringstream	temp;
+
+	encode(header, key.size());
+	header += key;
+	encode(header, names.size());
+	for (size_t n = 0; n < names.size(); n++) {
+		encode(header, names[n]->size());
+		header += *names[n];
+	}
+
+	temp << path << ".tmp." << getpid();
+	if ((file = fopen(temp.str().c_str(), "wb")) == NULL) {
+		return 1;
+	}
+	if (fwrite(header.data(), 1, header.size(), file) != header.size() ||
+	    fwrite(records.data(), 1, records.size(), file) != records.size()) {
+		fclose(file);
+		remove(temp.str().c_str());
+		return 2;
+	}
+	if (fclose(file) != 0 || rename(temp.str().c_str(), path.c_str()) != 0) {
+		remove(temp.str().c_str());
+		return 3;
+	}
+	return 0;
+}
+
+SymbolCacheReader::SymbolCacheReader() : mapping(0), size(0), pos(0), end(0), failed(false) {
+}
+
+SymbolCacheReader::~SymbolCacheReader() {
+	if (mapping != 0) {
+		munmap(mapping, size);
+	}
+}
+
+unsigned int SymbolCacheReader::open(const string &path, const string &key) {
+	int		fd;
+	struct stat	st;
+
+	if ((fd = ::open(path.c_str(), O_RDONLY)) < 0) {
+		return 1;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < SYMBOL_CACHE_MAGIC_SIZE) {
+		::close(fd);
+		return 2;
+	}
+	size = st.st_size;
+	mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) {
+		mapping = 0;
+		return 3;
+	}
+
+	pos = (const unsigned char*) mapping;
+	end = pos + size;
+	if (memcmp(pos, SYMBOL_CACHE_MAGIC, SYMBOL_CACHE_MAGIC_SIZE) != 0) {
+		return 4;
+	}
+	pos += SYMBOL_CACHE_MAGIC_SIZE;
+
+	unsigned long long key_size = getNumber();
+	if (!ok() || key_size != key.size() || (size_t) (end - pos) < key_size || memcmp(pos, key.data(), key_size) != 0) {
+		return 5;
+	}
+	pos += key_size;
+
+	unsigned long long count = getNumber();
+	for (unsigned long long n = 0; n < count && ok(); n++) {
+		unsigned long long name_size = getNumber();
+		if ((size_t) (end - pos) < name_size) {
+			failed = true;
+			break;
+		}
+		names.push_back(string((const char*) pos, name_size));
+		pos += name_size;
+	}
+	return ok() ? 0 : 6;
+}
+
+unsigned long long SymbolCacheReader::getNumber() {
+	unsigned long long	value = 0;
+	unsigned int		shift = 0;
+
+	while (pos < end && shift < 64) {
+		unsigned char byte = *pos++;
+		value |= (unsigned long long) (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+		shift += 7;
+	}
+	failed = true;
+	return 0;
+}
+
+const string& SymbolCacheReader::getName() {
+	unsigned long long id = getNumber();
+
+	if (id >= names.size()) {
+		failed = true;
+		return empty;
+	}
+	return names[id];
+}
+
+bool SymbolCacheReader::ok() const {
+	return !failed;
+}
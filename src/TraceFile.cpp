@@ -0,0 +1,269 @@
+/*
+ * TraceFile.cpp
+ *
+ * This file contains the member functions of the TraceWriter and TraceReader classes,
+ * which write and read the trace files of '-record_trace'.
+ *
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+#include "TraceFile.h"
+
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+static unsigned char *putNumber(unsigned char *p, UINT64 value)
+{
+	while (value >= 0x80)
+	{
+		*p++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (unsigned char)value;
+	return p;
+}
+
+// small differences (in both directions) get small numbers
+static UINT64 zigzag(ADDRINT from, ADDRINT to)
+{
+	INT64 delta = sizeof(ADDRINT) == 8 ? (INT64)(to - from) : (INT64)(INT32)(to - from);
+	return ((UINT64)delta << 1) ^ (UINT64)(delta >> 63);
+}
+
+static ADDRINT unzigzag(ADDRINT from, UINT64 value)
+{
+	return from + (ADDRINT)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+/* ===================================================================== */
+
+TraceWriter::TraceWriter(FILE *file)
+	:m_file(file), m_tid(INVALID_THREADID), m_addr(0)
+{
+	PIN_InitLock(&m_lock);
+}
+
+TraceWriter::~TraceWriter()
+{
+	if (m_file)
+		fclose(m_file);
+}
+
+TraceWriter *TraceWriter::open(const string &path)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+
+	if (!file)
+	{
+		cerr << "Can not create the trace file " << path << ": " << strerror(errno) << endl;
+		return NULL;
+	}
+	setvbuf(file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+	fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_SIZE, file);
+	return new TraceWriter(file);
+}
+
+// called with the lock held
+void TraceWriter::selectThread(THREADID tid, unsigned char *&p)
+{
+	if (tid != m_tid)
+	{
+		*p++ = TRACE_THREAD;
+		p = putNumber(p, tid);
+		m_tid = tid;
+	}
+}
+
+// called with the lock held, writes m_record up to 'end' and releases the lock
+void TraceWriter::putRecord(unsigned char *end)
+{
+	if (m_file)
+		fwrite(m_record, 1, end - m_record, m_file);
+	PIN_ReleaseLock(&m_lock);
+}
+
+void TraceWriter::writeName(UINT32 tag, UINT64 id, const string &name)
+{
+	unsigned char *p;
+
+	PIN_GetLock(&m_lock, 1);
+	p = m_record;
+	*p++ = (unsigned char)tag;
+	p = putNumber(p, id);
+	p = putNumber(p, name.size());
+	if (m_file)
+	{
+		fwrite(m_record, 1, p - m_record, m_file);
+		fwrite(name.data(), 1, name.size(), m_file);
+	}
+	PIN_ReleaseLock(&m_lock);
+}
+
+void TraceWriter::enter(THREADID tid, UINT64 id, bool counted)
+{
+	unsigned char *p;
+
+	PIN_GetLock(&m_lock, 1);
+	p = m_record;
+	selectThread(tid, p);
+	*p++ = counted ? TRACE_ENTER_COUNTED : TRACE_ENTER;
+	p = putNumber(p, id);
+	putRecord(p);
+}
+
+void TraceWriter::exit(THREADID tid, UINT32 frames)
+{
+	unsigned char *p;
+
+	PIN_GetLock(&m_lock, 1);
+	p = m_record;
+	selectThread(tid, p);
+	*p++ = TRACE_EXIT;
+	p = putNumber(p, frames);
+	putRecord(p);
+}
+
+void TraceWriter::access(THREADID tid, ADDRINT addr, UINT32 size, UINT64 func, UINT64 var, bool write, bool explicitFunc)
+{
+	unsigned char *p;
+
+	PIN_GetLock(&m_lock, 1);
+	p = m_record;
+	selectThread(tid, p);
+	*p++ = TRACE_ACCESS | (write ? TRACE_WRITE : 0) | (explicitFunc ? TRACE_EXPLICIT_FUNC : 0) | (var ? TRACE_HAS_VAR : 0);
+	p = putNumber(p, zigzag(m_addr, addr));
+	p = putNumber(p, size);
+	if (explicitFunc)
+		p = putNumber(p, func);
+	if (var)
+		p = putNumber(p, var);
+	m_addr = addr;
+	putRecord(p);
+}
+
+void TraceWriter::flush()
+{
+	PIN_GetLock(&m_lock, 1);
+	if (m_file)
+		fflush(m_file);
+	PIN_ReleaseLock(&m_lock);
+}
+
+void TraceWriter::close()
+{
+	PIN_GetLock(&m_lock, 1);
+	if (m_file)
+		fclose(m_file);
+	m_file = NULL;
+	PIN_ReleaseLock(&m_lock);
+}
+
+void TraceWriter::abandon()
+{
+	// the buffer of the stream still holds records of the parent, only the descriptor is closed
+	if (m_file)
+		::close(fileno(m_file));
+	m_file = NULL;
+}
+
+/* ===================================================================== */
+
+TraceReader::TraceReader(FILE *file)
+	:m_file(file), m_tid(0), m_addr(0)
+{
+}
+
+TraceReader::~TraceReader()
+{
+	fclose(m_file);
+}
+
+TraceReader *TraceReader::open(const string &path)
+{
+	char magic[TRACE_MAGIC_SIZE];
+	FILE *file = fopen(path.c_str(), "rb");
+
+	if (!file)
+	{
+		cerr << "Can not open the trace file " << path << ": " << strerror(errno) << endl;
+		return NULL;
+	}
+	if (fread(magic, 1, TRACE_MAGIC_SIZE, file) != TRACE_MAGIC_SIZE || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE))
+	{
+		cerr << "The file " << path << " is not a trace recorded by QUAD" << endl;
+		fclose(file);
+		return NULL;
+	}
+	setvbuf(file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+	return new TraceReader(file);
+}
+
+bool TraceReader::getNumber(UINT64 *value)
+{
+	unsigned int shift = 0;
+	int c;
+
+	*value = 0;
+	do
+	{
+		if ((c = getc(m_file)) == EOF || shift > 63)
+			return false;
+		*value |= (UINT64)(c & 0x7f) << shift;
+		shift += 7;
+	}
+	while (c & 0x80);
+	return true;
+}
+
+int TraceReader::next(TraceRecord &record)
+{
+	UINT64 value, length;
+	int tag;
+
+	// thread switches are folded into the next record
+	while ((tag = getc(m_file)) == TRACE_THREAD)
+	{
+		if (!getNumber(&value))
+			return -1;
+		m_tid = value;
+	}
+	if (tag == EOF)
+		return 0;
+
+	record.tag = tag;
+	record.tid = m_tid;
+	switch (tag)
+	{
+		case TRACE_FUNC_NAME:
+		case TRACE_VAR_NAME:
+			if (!getNumber(&record.id) || !getNumber(&length))
+				return -1;
+			record.name.resize(length);
+			if (length && fread(&record.name[0], 1, length, m_file) != length)
+				return -1;
+			return 1;
+		case TRACE_ENTER:
+		case TRACE_ENTER_COUNTED:
+		case TRACE_EXIT:
+			return getNumber(&record.id) ? 1 : -1;
+	}
+
+	if ((tag & ~(TRACE_WRITE | TRACE_EXPLICIT_FUNC | TRACE_HAS_VAR)) != TRACE_ACCESS)
+		return -1;
+	if (!getNumber(&value))
+		return -1;
+	m_addr = record.addr = unzigzag(m_addr, value);
+	if (!getNumber(&value))
+		return -1;
+	record.size = value;
+	record.func = 0;
+	record.var = 0;
+	if ((tag & TRACE_EXPLICIT_FUNC) && !getNumber(&record.func))
+		return -1;
+	if ((tag & TRACE_HAS_VAR) && !getNumber(&record.var))
+		return -1;
+	return 1;
+}
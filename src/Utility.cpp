@@ -9,6 +9,12 @@
 
 #include<sstream>
 #include<cstring>
+#include<cstdio>
+#include<ctime>
+#ifdef __linux__
+#include<unistd.h>
+#include<sys/time.h>
+#endif
 
 #include"Utility.h"
 
@@ -31,3 +37,45 @@ std::string no2str(unsigned long no)
 	return ss.str();//return a string with the contents of the stream
 }
 
+// inserts 'suffix' in front of the extension of 'name' (QDUGraph.dot -> QDUGraph<suffix>.dot)
+std::string suffixFileName(const std::string& name, const std::string& suffix)
+{
+	std::string::size_type dot = name.rfind('.');
+	std::string::size_type slash = name.find_last_of("/\\");
+	
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return name + suffix;
+	
+	return name.substr(0, dot) + suffix + name.substr(dot);
+}
+
+// the resident memory of this process in KB (everything, also the application under Pin), 0 if unknown
+unsigned long residentKB()
+{
+	unsigned long size = 0, resident = 0;
+#ifdef __linux__
+	FILE *statm = fopen("/proc/self/statm", "r");
+	
+	if (!statm)
+		return 0;
+	if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(statm);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+	return resident;
+#endif
+}
+
+// the wall clock time in seconds, from an arbitrary origin
+double wallSeconds()
+{
+#ifdef __linux__
+	struct timeval tv;
+	
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,261 @@
+/*
+ * quad-analyzer.cpp
+ *
+ * This file contains the quad-analyzer utility. quad-analyzer runs the tracing engine of
+ * QUAD (libquadcore) in its own process: QUAD started with '-analyzer_shm <file>' only
+ * forwards the memory accesses of the application through a ring buffer in <file>,
+ * quad-analyzer builds the bindings and writes the QDU graph and the XML profile. The
+ * analysis runs on another core than the application, and the profile is still written
+ * when the application (or Pin) crashes or is killed.
+ *
+ * Without Pin, quad-analyzer can read a synthetic access stream from a text file:
+ *
+ *	F <id> <name>			name of function <id>
+ *	V <id> <name>			name of variable <id>
+ *	W <addr> <size> <func> [<var>]	<size> bytes at <addr> written by function <func>
+ *	R <addr> <size> <func> [<var>]	<size> bytes at <addr> read by function <func>
+ *
+ * Lines starting with '#' are ignored, numbers can be decimal or hexadecimal (0x...).
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+
+#include "Platform.h"
+#include "Symbols.h"
+#include "NamedVariable.h"
+#include "AccessRing.h"
+#include "Engine.h"
+
+using namespace std;
+
+Engine Quad_Engine;
+
+/* ===================================================================== */
+
+UINT64 Records = 0;
+
+int ApplyAccess(ADDRINT addr, UINT32 size, UINT32 func, UINT32 var, bool write)
+{
+	const VariableSymbol *symbol = LookupVariable(var);
+
+	Records++;
+	// the ring does not tell the threads apart, all its accesses are counted as one thread's
+	if (!Quad_Engine.samples(0, addr, size))
+		return 0;
+	return Quad_Engine.onAccess(addr, size, func, symbol, write);
+}
+
+/* ===================================================================== */
+
+// waits for QUAD to attach to 'ring' and takes the options of the engine from it
+VOID WaitForWriter(AccessRing *ring)
+{
+	cerr << "Waiting for QUAD to attach to the ring buffer..." << endl;
+	while (ring->header()->writerPid == 0)
+		PIN_Sleep(10);
+
+	AccessRingOptions &ringOptions = ring->header()->options;
+	EngineOptions options;
+	options.showBytes = ringOptions.showBytes;
+	options.showUnDVs = ringOptions.showUnDVs;
+	options.showRanges = ringOptions.showRanges;
+	options.rangesLimit = ringOptions.rangesLimit;
+	options.showVariables = ringOptions.showVariables;
+	options.variableCount = ringOptions.variableCount;
+	options.granularity = ringOptions.granularity;
+	options.samplePages = ringOptions.samplePages;
+	options.sampleAccesses = ringOptions.sampleAccesses;
+	options.unmaSketchBits = ringOptions.unmaSketchBits;
+	Quad_Engine.setOptions(options);
+}
+
+int ReadRing(AccessRing *ring)
+{
+	AccessRingSlot record;
+	string name;
+	unsigned int idle = 0;
+	int status;
+
+	cerr << "Analyzing the memory accesses of process " << ring->header()->writerPid << "..." << endl;
+	while ((status = ring->read(record, name)) != RING_CLOSED)
+	{
+		if (status == RING_EMPTY)
+		{
+			if (++idle < 64)
+				PIN_Yield();
+			else
+				PIN_Sleep(1);
+			continue;
+		}
+		idle = 0;
+
+		switch (record.type)
+		{
+			case RING_FUNC_NAME:
+				Quad_Engine.defineFunction(record.addr, name);
+				break;
+			case RING_VAR_NAME:
+				DefineVariable(record.addr, name);
+				break;
+			case RING_READ:
+			case RING_WRITE:
+				if (ApplyAccess(record.addr, record.size, record.func, record.var, record.type == RING_WRITE))
+				{
+					cerr << "Memory allocation failed in the tracing engine..." << endl;
+					return 1;
+				}
+				break;
+		}
+	}
+
+	if (!ring->header()->closed)
+		cerr << "QUAD (process " << ring->header()->writerPid << ") terminated without closing the ring buffer, writing the profile collected so far..." << endl;
+	return 0;
+}
+
+int ReadTextStream(const string &filename)
+{
+	ifstream in(filename.c_str());
+	string line;
+	unsigned int lineNo = 0;
+
+	if (!in)
+	{
+		cerr << "Can not open the access stream " << filename << endl;
+		return 1;
+	}
+
+	while (getline(in, line))
+	{
+		istringstream fields(line);
+		string type, addr, size, func, var;
+
+		lineNo++;
+		if (!(fields >> type) || type[0] == '#')
+			continue;
+
+		if (type == "F" || type == "V")
+		{
+			string name;
+			fields >> addr >> ws;
+			getline(fields, name);
+			if (type == "F")
+				Quad_Engine.defineFunction(strtoull(addr.c_str(), NULL, 0), name);
+			else
+				DefineVariable(strtoul(addr.c_str(), NULL, 0), name);
+		}
+		else if ((type == "W" || type == "R") && (fields >> addr >> size >> func))
+		{
+			fields >> var;
+			if (ApplyAccess(strtoull(addr.c_str(), NULL, 0), strtoul(size.c_str(), NULL, 0),
+				strtoul(func.c_str(), NULL, 0), strtoul(var.c_str(), NULL, 0), type == "W"))
+			{
+				cerr << "Memory allocation failed in the tracing engine..." << endl;
+				return 1;
+			}
+		}
+		else
+			cerr << filename << ":" << lineNo << ": ignoring malformed record" << endl;
+	}
+	return 0;
+}
+
+/* ===================================================================== */
+
+int usage()
+{
+	cerr << "Usage: quad-analyzer [options] -shm <ring file>" << endl
+		<< "       quad-analyzer [options] -stream <access stream>" << endl
+		<< "Builds the QUAD profile of the memory accesses forwarded by 'QUAD -analyzer_shm <ring file>'," << endl
+		<< "or of a synthetic access stream in a text file." << endl
+		<< "Options:" << endl
+		<< "  -slots <n>           number of slots in the ring buffer (default " << ACCESS_RING_DEFAULT_SLOTS << ")" << endl
+		<< "  -xmlfile <file>      the output XML file (default q2profiling.xml)" << endl
+		<< "  -applic <name>       the application name in the XML file (default testAPPlication)" << endl
+		<< "  -shards <n>          number of analysis worker threads (default 0)" << endl
+		<< "  -report_threads <n>  number of threads preparing the reports (default 0)" << endl;
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	string ringName, streamName;
+	string xmlName("q2profiling.xml");
+	string applicName("testAPPlication");
+	UINT64 slots = ACCESS_RING_DEFAULT_SLOTS;
+	unsigned int shards = 0, reportThreads = 0;
+	AccessRing *ring = NULL;
+	int status;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-shm") && i + 1 < argc)
+			ringName = argv[++i];
+		else if (!strcmp(argv[i], "-stream") && i + 1 < argc)
+			streamName = argv[++i];
+		else if (!strcmp(argv[i], "-slots") && i + 1 < argc)
+			slots = strtoull(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-xmlfile") && i + 1 < argc)
+			xmlName = argv[++i];
+		else if (!strcmp(argv[i], "-applic") && i + 1 < argc)
+			applicName = argv[++i];
+		else if (!strcmp(argv[i], "-shards") && i + 1 < argc)
+			shards = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-report_threads") && i + 1 < argc)
+			reportThreads = strtoul(argv[++i], NULL, 0);
+		else
+			return usage();
+	}
+
+	if (ringName.empty() == streamName.empty())
+		return usage();
+
+	// the options of the engine come with the ring, they are set before the engine starts
+	if (!ringName.empty())
+	{
+		if (!(ring = AccessRing::create(ringName, slots)))
+			return 2;
+		WaitForWriter(ring);
+	}
+
+	if (Quad_Engine.start(xmlName, applicName, shards, reportThreads))
+	{
+		if (ring)
+		{
+			delete ring;
+			unlink(ringName.c_str());
+		}
+		return 2;
+	}
+
+	// function #0 is the producer of the memory nobody wrote, as in the Pin tool
+	Quad_Engine.defineFunction(0x0, "UNKNOWN_PRODUCER(CONSTANT_DATA)");
+
+	if (ring)
+	{
+		status = ReadRing(ring);
+		delete ring;
+		unlink(ringName.c_str());
+	}
+	else
+		status = ReadTextStream(streamName);
+
+	if (status)
+		return 3;
+
+	cerr << "Analyzed " << Records << " access records" << endl;
+	if (Quad_Engine.report())
+		return 4;
+	return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * quad-merge.cpp
+ *
+ * This file contains the quad-merge utility. When QUAD follows a forking application every
+ * process writes its own profile (q2profiling.xml, q2profiling.<pid>.xml, ...). quad-merge
+ * combines the channels of these profiles into one XML profile and one QDU graph.
+ *
+ * Channels with the same producer and consumer are summed. The UnMA of a merged channel is
+ * computed from the union of the address ranges, as forked processes share their layout.
+ * The PIPE:/SOCK:/SHM: nodes recorded with '-ipc_channels 1' have the same name in every
+ * process, so they connect the producers in one process with the consumers in another one.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "Channel.h"
+#include "Q2XMLFile.h"
+#include "ticpp.h"
+
+using namespace std;
+
+typedef struct
+{
+	ULL Bytes;
+	ULL Values;
+	ULL UnMA;		// only used when some profile has no ranges for this channel
+	bool RangesComplete;
+	vector<Range> Ranges;
+}
+MergedChannel;
+
+typedef map<pair<string, string>, MergedChannel> ChannelMap;
+
+bool rangecmp(const Range &lhs, const Range &rhs)
+{
+	return lhs.lower < rhs.lower;
+}
+
+// sorts and joins overlapping or adjacent ranges, returns the number of addresses covered
+ULL unionRanges(vector<Range> &ranges)
+{
+	vector<Range> merged;
+	ULL unma = 0;
+	unsigned int i;
+
+	sort(ranges.begin(), ranges.end(), rangecmp);
+	for (i = 0; i < ranges.size(); i++)
+	{
+		if (!merged.empty() && ranges[i].lower <= merged.back().upper + 1)
+		{
+			if (ranges[i].upper > merged.back().upper)
+				merged.back().upper = ranges[i].upper;
+		}
+		else
+			merged.push_back(ranges[i]);
+	}
+
+	for (i = 0; i < merged.size(); i++)
+		unma += merged[i].upper - merged[i].lower + 1;
+
+	ranges = merged;
+	return unma;
+}
+
+int readProfile(const string &filename, const string &applicName, ChannelMap &channels)
+{
+	string ns("q2:");
+	vector<Channel*> profile;
+
+	try
+	{
+		Q2XMLFile q2xml(filename, ns, applicName);
+		q2xml.getChannels(profile);
+	}
+	catch (ticpp::Exception& ex)
+	{
+		cerr << "Error occurred while reading " << filename << " ...\n" << ex.what() << endl;
+		return 1;
+	}
+
+	for (unsigned int i = 0; i < profile.size(); i++)
+	{
+		Channel *ch = profile[i];
+		pair<string, string> key(ch->getProducer(), ch->getConsumer());
+		ChannelMap::iterator it = channels.find(key);
+		vector<Range> ranges;
+
+		if (it == channels.end())
+		{
+			MergedChannel mc;
+			mc.Bytes = mc.Values = mc.UnMA = 0;
+			mc.RangesComplete = true;
+			it = channels.insert(make_pair(key, mc)).first;
+		}
+
+		ch->getRanges(ranges);
+		it->second.Bytes += ch->getBytes();
+		it->second.Values += ch->getValues();
+		it->second.UnMA += ch->getUnMA();
+		if (ranges.empty() && ch->getUnMA() > 0)
+			it->second.RangesComplete = false;
+		it->second.Ranges.insert(it->second.Ranges.end(), ranges.begin(), ranges.end());
+
+		delete ch;
+	}
+
+	cerr << "Read " << profile.size() << " channels from " << filename << endl;
+	return 0;
+}
+
+int writeDotFile(const string &filename, ChannelMap &channels)
+{
+	FILE *gfp;
+	map<string, int> nodes;
+	ChannelMap::iterator it;
+
+	if (!(gfp = fopen(filename.c_str(), "wt")))
+		return 1;
+
+	fprintf(gfp,"digraph {\ngraph [];\nnode [fontcolor=black, style=filled, fontsize=20];\nedge [fontsize=14, arrowhead=vee, arrowsize=0.5];\n");
+	for (it = channels.begin(); it != channels.end(); it++)
+	{
+		const string *names[2] = { &it->first.first, &it->first.second };
+		for (int n = 0; n < 2; n++)
+		{
+			if (nodes.find(*names[n]) == nodes.end())
+			{
+				int id = nodes.size();
+				nodes[*names[n]] = id;
+				fprintf(gfp,"\"%08x\" [label=\"%s\"];\n", id, names[n]->c_str());
+			}
+		}
+
+		fprintf(gfp,"\"%08x\" -> \"%08x\"  [label=\"%llu Bytes\\n%llu UnMAs \\n%llu UnDVs\\n\"]\n",
+			nodes[it->first.first], nodes[it->first.second], it->second.Bytes, it->second.UnMA, it->second.Values);
+	}
+	fprintf(gfp,"}\n");
+	fclose(gfp);
+	return 0;
+}
+
+int usage()
+{
+	cerr << "Usage: quad-merge [-o <merged.xml>] [-dot <merged.dot>] [-applic <name>] <profile.xml> [<profile.xml> ...]" << endl
+		<< "Combines the per-process QUAD profiles of a forking application into one profile." << endl;
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	string outName("q2profiling.merged.xml");
+	string dotName("QDUGraph.merged.dot");
+	string applicName("testAPPlication");
+	vector<string> inputs;
+	ChannelMap channels;
+	ChannelMap::iterator it;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			outName = argv[++i];
+		else if (!strcmp(argv[i], "-dot") && i + 1 < argc)
+			dotName = argv[++i];
+		else if (!strcmp(argv[i], "-applic") && i + 1 < argc)
+			applicName = argv[++i];
+		else if (argv[i][0] == '-')
+			return usage();
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if (inputs.empty())
+		return usage();
+
+	for (unsigned int i = 0; i < inputs.size(); i++)
+		if (readProfile(inputs[i], applicName, channels))
+			return 2;
+
+	for (it = channels.begin(); it != channels.end(); it++)
+		if (it->second.RangesComplete)
+			it->second.UnMA = unionRanges(it->second.Ranges);
+
+	// start from an empty file, otherwise the ranges would be appended to the ones of a previous merge
+	remove(outName.c_str());
+	try
+	{
+		string ns("q2:");
+		Q2XMLFile q2xml(outName, ns, applicName);
+
+		for (it = channels.begin(); it != channels.end(); it++)
+		{
+			Channel ch(it->first.first, it->first.second, it->second.Ranges, it->second.UnMA, it->second.Bytes, it->second.Values);
+			q2xml.insertChannel(&ch);
+		}
+		q2xml.save();
+	}
+	catch (ticpp::Exception& ex)
+	{
+		cerr << "Error occurred while saving XML file ... \n" << ex.what() << endl;
+		return 3;
+	}
+
+	if (writeDotFile(dotName, channels))
+	{
+		cerr << "Can not create " << dotName << endl;
+		return 4;
+	}
+
+	cerr << "Merged " << channels.size() << " channels from " << inputs.size() << " profiles into " << outName << " and " << dotName << endl;
+	return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * quad-replay.cpp
+ *
+ * This file contains the quad-replay utility. QUAD started with '-record_trace <file>'
+ * only records the memory accesses and the function calls of the application in a
+ * trace file, which is much cheaper than analyzing them. quad-replay runs the tracing
+ * engine of QUAD (libquadcore) on such a trace and writes the QDU graph and the XML
+ * profile, so the same execution can be analyzed again (e.g. with another monitor list)
+ * without running the application again.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+
+#include "Platform.h"
+#include "Symbols.h"
+#include "NamedVariable.h"
+#include "TraceFile.h"
+#include "Engine.h"
+#include "SelfProfile.h"
+
+using namespace std;
+
+Engine Quad_Engine;
+
+/* ===================================================================== */
+
+UINT64 Records = 0;
+
+int ApplyAccess(const TraceRecord &record)
+{
+	const VariableSymbol *symbol = LookupVariable(record.var);
+	BOOL write = (record.tag & TRACE_WRITE) != 0;
+
+	Records++;
+	if (!Quad_Engine.samples(record.tid, record.addr, record.size))
+		return 0;
+	// counted like the accesses QUAD instruments, so the self profile has the same per access figures
+	GetThreadProfile(record.tid)->counters[SP_ACCESSES]++;
+	if (record.tag & TRACE_EXPLICIT_FUNC)
+		return Quad_Engine.onAccess(record.addr, record.size, record.func, symbol, write);
+	if (write)
+		return Quad_Engine.onWrite(record.tid, record.addr, record.size, symbol);
+	return Quad_Engine.onRead(record.tid, record.addr, record.size, symbol);
+}
+
+int ReplayTrace(const string &traceName)
+{
+	TraceReader *reader = TraceReader::open(traceName);
+	TraceRecord record;
+	int status;
+
+	if (!reader)
+		return 1;
+
+	while ((status = reader->next(record)) > 0)
+	{
+		switch (record.tag)
+		{
+			case TRACE_FUNC_NAME:
+				Quad_Engine.defineFunction(record.id, record.name);
+				if (record.name == "Out_of_the_main_function_scope")
+					Quad_Engine.setBottomFunction(record.id);
+				break;
+			case TRACE_VAR_NAME:
+				DefineVariable(record.id, record.name);
+				break;
+			case TRACE_ENTER:
+			case TRACE_ENTER_COUNTED:
+				Quad_Engine.onEnter(record.tid, record.id, record.tag == TRACE_ENTER_COUNTED);
+				break;
+			case TRACE_EXIT:
+				Quad_Engine.onExit(record.tid, record.id);
+				break;
+			default:
+				if (ApplyAccess(record))
+				{
+					cerr << "Memory allocation failed in the tracing engine..." << endl;
+					delete reader;
+					return 1;
+				}
+		}
+	}
+
+	delete reader;
+	if (status < 0)
+	{
+		cerr << "The trace " << traceName << " is truncated or corrupt, writing the profile of the records read so far..." << endl;
+	}
+	return 0;
+}
+
+// reads the functions of the monitor list, like QUAD does with '-use_monitor_list'
+int ReadMonitorList(const string &monitorName)
+{
+	ifstream monitorin(monitorName.c_str());
+	string item;
+	unsigned int itemCount = 0;
+
+	if (!monitorin)
+	{
+		cerr << "Can not open the monitor list file " << monitorName << endl;
+		return 1;
+	}
+
+	while (monitorin >> item)
+	{
+		Quad_Engine.monitor(item);
+		itemCount++;
+	}
+
+	if (itemCount == 0)
+	{
+		cerr << "The monitor list file " << monitorName << " is empty" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+/* ===================================================================== */
+
+int usage()
+{
+	cerr << "Usage: quad-replay [options] <trace file>" << endl
+		<< "Builds the QUAD profile of a trace recorded by 'QUAD -record_trace <trace file>'." << endl
+		<< "Options:" << endl
+		<< "  -xmlfile <file>           the output XML file (default q2profiling.xml)" << endl
+		<< "  -applic <name>            the application name in the XML file (default testAPPlication)" << endl
+		<< "  -use_monitor_list <file>  also write the summary of the functions listed in <file>" << endl
+		<< "  -bbFuncCount <0|1>        dump the number of calls of every function to the XML file (default 0)" << endl
+		<< "  -dotShowBytes <0|1>       print 'Bytes' on the edges (default 1)" << endl
+		<< "  -dotShowUnDVs <0|1>       print 'UnDVs' on the edges (default 1)" << endl
+		<< "  -dotShowRanges <0|1>      print the address ranges on the edges (default 1)" << endl
+		<< "  -dotShowRangesLimit <n>   the maximum number of ranges on an edge (default 3)" << endl
+		<< "  -elf <0|1>                print the names of the variables on the edges (default 0)" << endl
+		<< "  -varcnt <n>               the maximum number of variable names on an edge (default 5)" << endl
+		<< "  -granularity <n>          track the memory in blocks of <n> bytes, a power of two (default 1)" << endl
+		<< "  -sample_pages <n>         only analyze 1 of every <n> pages, the reports are estimates (default 1)" << endl
+		<< "  -sample_accesses <n>      only analyze 1 of every <n> accesses, the reports are estimates (default 1)" << endl
+		<< "  -unma_sketch <n>          estimate UnMA with HyperLogLog sketches of 2^<n> registers (default 0, exact)" << endl
+		<< "  -shards <n>               number of analysis worker threads (default 0)" << endl
+		<< "  -report_threads <n>       number of threads preparing the reports (default 0)" << endl
+		<< "  -self_profile <0|1>       write the counters of the engine to QUAD_self_profile.txt (default 0)" << endl
+		<< "  -self_profile_timers <0|1> also measure the cycles spent in every stage (default 0)" << endl
+		<< "  -max_memory_mb <n>        limit the memory of the engine to <n> MB (default 0, unlimited)" << endl;
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	string traceName, monitorName;
+	string xmlName("q2profiling.xml");
+	string applicName("testAPPlication");
+	unsigned int shards = 0, reportThreads = 0;
+	BOOL selfProfile = FALSE;
+	EngineOptions options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (argv[i][0] != '-' && traceName.empty())
+			traceName = argv[i];
+		else if (i + 1 >= argc)
+			return usage();
+		else if (!strcmp(argv[i], "-xmlfile"))
+			xmlName = argv[++i];
+		else if (!strcmp(argv[i], "-applic"))
+			applicName = argv[++i];
+		else if (!strcmp(argv[i], "-use_monitor_list"))
+			monitorName = argv[++i];
+		else if (!strcmp(argv[i], "-bbFuncCount"))
+			options.bbFuncCount = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-dotShowBytes"))
+			options.showBytes = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-dotShowUnDVs"))
+			options.showUnDVs = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-dotShowRanges"))
+			options.showRanges = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-dotShowRangesLimit"))
+			options.rangesLimit = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-elf"))
+			options.showVariables = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-varcnt"))
+			options.variableCount = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-granularity"))
+			options.granularity = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-sample_pages"))
+			options.samplePages = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-sample_accesses"))
+			options.sampleAccesses = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-unma_sketch"))
+			options.unmaSketchBits = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-shards"))
+			shards = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-report_threads"))
+			reportThreads = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-self_profile"))
+			selfProfile = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-self_profile_timers"))
+			Self_Profile_Timers = atoi(argv[++i]) != 0;
+		else if (!strcmp(argv[i], "-max_memory_mb"))
+			Quad_Engine.setMemoryLimit(strtoull(argv[++i], NULL, 0) << 20);
+		else
+			return usage();
+	}
+
+	if (traceName.empty())
+		return usage();
+	if (!monitorName.empty() && ReadMonitorList(monitorName))
+		return 2;
+
+	Quad_Engine.setOptions(options);
+	if (Quad_Engine.start(xmlName, applicName, shards, reportThreads))
+		return 2;
+
+	// function #0 is the producer of the memory nobody wrote, as in the Pin tool
+	Quad_Engine.defineFunction(0x0, "UNKNOWN_PRODUCER(CONSTANT_DATA)");
+
+	if (ReplayTrace(traceName))
+		return 3;
+
+	cerr << "Replayed " << Records << " access records" << endl;
+	if (Quad_Engine.report())
+		return 4;
+	if (selfProfile && WriteSelfProfile("at the end of the replay"))
+		return 4;
+	return 0;
+}
@@ -54,7 +54,7 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 //==============================================================================
 /* tracing.cpp: 
- * The tracing routines, used by QUAD tool
+ * The tracing routines of QUAD, built into libquadcore and used through the Engine class
  *
  *  Authors: Arash Ostadzadeh
  *           Roel Meeuws
@@ -64,16 +64,62 @@ THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "tracing.h"
 
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <algorithm>
+
+#include "Symbols.h"
 #include "Exception.h"
 #include "Q2XMLFile.h"
 #include "Channel.h"
 #include "RenewalFlags.h"
+#include "HyperLogLog.h"
+#include "Utility.h"
+#include "SelfProfile.h"
 #include <list>
+#include <cstdarg>
 
 #define max(a,b) ((a)>(b)?(a):(b))
 #define min(a,b) ((a)<(b)?(a):(b))
 
 typedef ADDRINT addr_t; 
+
+BOOL BB_Func_Count=FALSE;	// annotate the nodes with the number of calls
+BOOL Dot_Show_Bytes=TRUE;
+BOOL Dot_Show_UnDVs=TRUE;
+BOOL Dot_Show_Ranges=TRUE;
+int Dot_Show_Ranges_Limit=3;
+BOOL Show_Variables=FALSE;	// annotate the edges with the variables that were exchanged
+unsigned int Variable_Count=5;
+
+// the shadow memory tracks aligned blocks of Granularity (a power of two) bytes
+unsigned int Granularity=1;
+unsigned int Granularity_Shift=0;
+
+// the sampling of the accesses (see Engine::samples), the reports scale the sampled bindings up
+unsigned int Sample_Pages=1;	// only one of every Sample_Pages pages of 4 KB is analyzed
+unsigned int Sample_Accesses=1;	// only one of every Sample_Accesses accesses is analyzed
+
+vector<string> Report_Notes;	// noted in the QDU graph and the XML file, e.g. the fidelity of the phases of a run
+
+unsigned int UnMA_Sketch_Bits=0;	// UnMA is estimated with HyperLogLog sketches of 2^bits registers, 0 keeps the exact sets
+
+// the degradation of the analysis when QUAD exceeds its memory limit (Engine::checkMemory)
+BOOL Unique_Cells_Dropped=FALSE;	// the sets of unique addresses do not grow anymore
+BOOL Analysis_Stopped=FALSE;	// the accesses are not analyzed anymore
+volatile BOOL Memory_Check_Due=FALSE;	// set by RecordShardAccess, cleared by Engine::onAccess
+
+Q2XMLFile *q2xml=NULL;
+map <ADDRINT,string> ADDtoName;	// function number -> function (or basic block) name
+map <string, GlobalSymbol*> globalSymbols;
+map <string, string> NameToFunction;	// basic block -> the function it is part of
+map <string, int> FunctionToCount;	// the number of calls of each function
+map <string,TTL_ML_Data_Pack *> ML_OUTPUT;	// used to maintain info regarding monitor list statistics
+BOOL Monitor_ON=FALSE;
+string Output_Suffix;	// inserted in the names of the output files, empty for the initial process and ".<pid>" for forked children
+
 FILE* gfp,*ufa;
 
 addr_t MaxLabel=0;
@@ -82,14 +128,135 @@ addr_t MaxLabel=0;
 typedef struct 
 {
 	unsigned long long data_exchange;
+	unsigned long long reads;	// the (sampled) reads recorded in data_exchange
 	unsigned long long UniqueValues;
 	ADDRINT producer;
 	ADDRINT consumer;
 	set<ADDRINT>* UniqueMemCells;
+	HyperLogLog* UnMASketch;	// instead of UniqueMemCells with '-unma_sketch', NULL otherwise
 	map<string, unsigned long long>* variable_exchange;
 } 
 Binding;
 
+// the unique memory addresses of a binding, a block counts for all its bytes
+inline unsigned long int UnMAOf(const Binding *binding)
+{
+	if (binding->UnMASketch)
+		return binding->UnMASketch->estimate() << Granularity_Shift;
+	return binding->UniqueMemCells->size() << Granularity_Shift;
+}
+
+// the unique data values of a binding in bytes, like UnMA a renewed block counts for all its bytes
+inline unsigned long long UnDVOf(const Binding *binding)
+{
+	return binding->UniqueValues << Granularity_Shift;
+}
+
+// the estimates of the bytes, the unique addresses and the unique values of a binding with their 95% 
+// confidence bounds, they are the recorded values when the accesses are not sampled. A high bound of 0 is unknown.
+typedef struct
+{
+	unsigned long long bytes, bytesLow, bytesHigh;
+	unsigned long long unma, unmaLow, unmaHigh;
+	unsigned long long undv, undvLow, undvHigh;
+}
+BindingEstimate;
+
+// the bounds of 'estimate' with a variance of 'variance', at least 'recorded'
+static void ConfidenceBounds(double estimate, double variance, unsigned long long recorded, unsigned long long &low, unsigned long long &high)
+{
+	double margin=1.96*sqrt(variance);
+	
+	low=estimate-margin > recorded ? (unsigned long long)(estimate-margin) : recorded;
+	high=(unsigned long long)(estimate+margin+0.5);
+}
+
+// scales 'recorded' (the bytes or the unique values of a binding) by the page sampling factor 'n'. The 
+// counts per page are not kept, they are taken proportional to the UnMA of the page, whose scaled sum 
+// has a variance of 'variance'.
+static void ScaleWithUnMA(double n, double variance, unsigned long long unma, unsigned long long recorded, 
+	unsigned long long &estimate, unsigned long long &low, unsigned long long &high)
+{
+	if (unma>0)
+		variance*=((double)recorded/unma)*((double)recorded/unma);
+	estimate=(unsigned long long)(n*recorded);
+	ConfidenceBounds(n*recorded, variance, recorded, low, high);
+}
+
+void EstimateBinding(const Binding *binding, BindingEstimate &est)
+{
+	unsigned long long bytes=binding->data_exchange, unma=UnMAOf(binding), undv=UnDVOf(binding);
+	double n, variance;
+	
+	est.bytes=est.bytesLow=est.bytesHigh=bytes;
+	est.unma=est.unmaLow=est.unmaHigh=unma;
+	est.undv=est.undvLow=est.undvHigh=undv;
+	
+	if (binding->UnMASketch)
+	{
+		double margin=1.96*binding->UnMASketch->error()*unma;
+		est.unmaLow=margin<unma ? (unsigned long long)(unma-margin) : 0;
+		est.unmaHigh=(unsigned long long)(unma+margin+0.5);
+	}
+	
+	if (Sample_Pages>1 && binding->UnMASketch)
+	{
+		// the sketch does not know the pages, the variance is bounded by taking every sampled 
+		// page as full (the sum of the squares is at most unma times the page size)
+		n=Sample_Pages;
+		variance=n*(n-1)*(double)unma*4096;
+		est.unma=(unsigned long long)(n*unma);
+		ConfidenceBounds(n*unma, variance, 0, est.unmaLow, est.unmaHigh);
+		est.unmaLow=(unsigned long long)(est.unmaLow*(1-1.96*binding->UnMASketch->error()));
+		est.unmaHigh=(unsigned long long)(est.unmaHigh*(1+1.96*binding->UnMASketch->error()));
+		
+		ScaleWithUnMA(n, variance, unma, bytes, est.bytes, est.bytesLow, est.bytesHigh);
+		ScaleWithUnMA(n, variance, unma, undv, est.undv, est.undvLow, est.undvHigh);
+	}
+	else if (Sample_Pages>1)
+	{
+		// every page is sampled with probability 1/n, the variance of the scaled sum is n(n-1) 
+		// times the sum of the squares of the sampled pages
+		double squares=0, cells=0;
+		ADDRINT page=0;
+		set<ADDRINT>::const_iterator it;
+		
+		for (it=binding->UniqueMemCells->begin(); it!=binding->UniqueMemCells->end(); it++)
+		{
+			if (((*it << Granularity_Shift) >> 12) != page && cells>0)
+			{
+				squares+=cells*cells;
+				cells=0;
+			}
+			page=(*it << Granularity_Shift) >> 12;
+			cells+=Granularity;
+		}
+		squares+=cells*cells;
+		
+		n=Sample_Pages;
+		variance=n*(n-1)*squares;
+		est.unma=(unsigned long long)(n*unma);
+		ConfidenceBounds(n*unma, variance, unma, est.unmaLow, est.unmaHigh);
+		
+		ScaleWithUnMA(n, variance, unma, bytes, est.bytes, est.bytesLow, est.bytesHigh);
+		ScaleWithUnMA(n, variance, unma, undv, est.undv, est.undvLow, est.undvHigh);
+	}
+	else if (Sample_Accesses>1 && binding->reads>0)
+	{
+		// every read is sampled with probability 1/n, the reads are taken to be of the same size
+		n=Sample_Accesses;
+		variance=n*(n-1)*bytes*((double)bytes/binding->reads);
+		est.bytes=(unsigned long long)(n*bytes);
+		ConfidenceBounds(n*bytes, variance, bytes, est.bytesLow, est.bytesHigh);
+		
+		// the same addresses are read again and again, scaling would overestimate UnMA: the 
+		// recorded UnMA is a lower bound. A renewal is only counted when both its write and a
+		// read of it were sampled, so the recorded UnDV is a lower bound too.
+		est.unmaHigh=0;
+		est.undvHigh=0;
+	}
+}
+
 bool paircmp (pair<string, unsigned long long> lhs, pair<string, unsigned long long> rhs) {
 	return lhs.second > rhs.second;
 }
@@ -103,13 +270,93 @@ struct trieNode
     };
     FNodeList * RenewalFlags;
 } 
-*trieRoot=NULL,*graphRoot=NULL,*uflist=NULL;
+*uflist=NULL;
 struct trieLeaf
 {
     ADDRINT lastWrite;
     const class VariableSymbol *writtenSymbol;
 };
 
+// one access as it is queued to a shard worker
+typedef struct
+{
+	ADDRINT addr;
+	UINT32 bytes;
+	ADDRINT func;
+	const class VariableSymbol *symbol;
+	bool write;
+}
+AccessRecord;
+
+#define SHARD_CHUNK_RECORDS 1024
+#define MAX_QUEUED_CHUNKS 256
+#define SHARD_STRIPE_SHIFT 12	// the shards own stripes of 4 KB of the address space
+#define SET_NODE_BYTES (sizeof(ADDRINT)+4*sizeof(void*))	// a node of set<ADDRINT>: the value, the links and the color
+#define MEMORY_CHECK_BYTES (1<<20)	// the memory limit is checked whenever a shard grew by this much (a few thousand allocations)
+
+typedef struct AccessChunk
+{
+	unsigned int count;
+	AccessRecord records[SHARD_CHUNK_RECORDS];
+	struct AccessChunk *next;
+}
+AccessChunk;
+
+// A shard owns the shadow memory (trieRoot) and the bindings (graphRoot) of its part of the 
+// address space. Without shard workers there is a single shard updated by the application.
+typedef struct
+{
+	struct trieNode *trieRoot;
+	struct trieNode *graphRoot;
+	addr_t MaxLabel;
+	
+	UINT64 shadowBytes;		// the trie nodes, leaves and renewal flags in trieRoot
+	UINT64 bindingBytes;		// the trie nodes and bindings in graphRoot (without their sets)
+	UINT64 unmaBytes;		// the sets of unique addresses of the bindings
+	UINT64 checkedBytes;		// the memory of the shard when it last set Memory_Check_Due
+	UINT64 bindings;
+	UINT64 communications;		// the accesses recorded in the bindings
+	SelfProfile *profile;		// the self profile of the thread working on this shard
+	
+	PIN_LOCK fillLock;		// orders the accesses of all application threads in 'filling'
+	AccessChunk *filling;		// the chunk the application threads append to
+	PIN_LOCK lock;			// protects the queue and the free list
+	AccessChunk *head, *tail;	// chunks waiting for the worker
+	AccessChunk *freeChunks;
+	volatile unsigned int queued;
+	volatile BOOL busy;		// the worker is processing a chunk
+	volatile BOOL finished;		// the worker has stopped
+	PIN_THREAD_UID uid;
+}
+Shard;
+
+Shard *Shards=NULL;
+unsigned int Num_Shards=0;
+BOOL Shard_Workers=FALSE;
+volatile BOOL Shards_Stopping=FALSE;
+
+inline Shard* ShardOf(ADDRINT locAddr)
+{
+	return &Shards[(locAddr >> SHARD_STRIPE_SHIFT) % Num_Shards];
+}
+
+// allocates a trie node with all its children cleared, NULL if the memory is exhausted.
+// The node is only linked into a trie after it is cleared, so the trie can be inspected 
+// by another thread while a shard worker is growing it.
+struct trieNode* NewTrieNode()
+{
+	struct trieNode* node=(struct trieNode*)malloc(sizeof(struct trieNode));
+	int i;
+	
+	if (node)
+	{
+		for (i=0;i<16;i++) 
+			node->list[i]=NULL;
+		node->RenewalFlags=NULL;
+	}
+	return node;
+}
+
 struct AddressSplitter
 {
     unsigned int h0:4;
@@ -160,14 +407,14 @@ int CreateTotalStatFile()
 
 	map <string,TTL_ML_Data_Pack*> :: const_iterator pIter;
 
-	out.open("ML_OV_Summary.txt");
+	out.open(suffixFileName("ML_OV_Summary.txt", Output_Suffix).c_str());
 	if(!out) 
 	{
 		cerr<<"\nCan not create the summary report file containing information about the functions specified in the monitor list..."<<endl;
 		return 1;
 	}
 
-	cerr<< "\nCreating summary report file (ML_OV_Summary.txt) containing information about the functions specified in the monitor list..." << endl;
+	cerr<< "\nCreating summary report file ("<<suffixFileName("ML_OV_Summary.txt", Output_Suffix)<<") containing information about the functions specified in the monitor list..." << endl;
 
 	out <<setw(30)<<setiosflags(ios::left)<<"Function"<<setw(12)<<"   IN_ML"
 		<<setw(12)<<" IN_ML_UnMA"
@@ -207,7 +454,7 @@ int CreateTotalStatFile()
 		
 		// store the list of communicating functions for each kernel in ML
 		// consumers
-		out_list.open((pIter -> first+"_(p).txt").c_str());
+		out_list.open(suffixFileName(pIter -> first+"_(p).txt", Output_Suffix).c_str());
 		if(!out_list) 
 		{
 		cerr<<"\nCan not create the report file containing the list of communicating functions for kernels ..."<<endl;
@@ -220,7 +467,7 @@ int CreateTotalStatFile()
 		out_list.close();
 
 		// producers
-		out_list.open((pIter -> first+"_(c).txt").c_str());
+		out_list.open(suffixFileName(pIter -> first+"_(c).txt", Output_Suffix).c_str());
 		if(!out_list) 
 		{
 			cerr<<"\nCan not create the report file containing the list of communicating functions for kernels ..."<<endl;
@@ -272,14 +519,11 @@ int IsNewFunc(ADDRINT fadd)
 	{
 		if(! (currentLP->list[addressArray[currentLevel]]) ) /* create new level on demand */
 		{
-			if(!(currentLP->list[addressArray[currentLevel]]=(struct trieNode*)malloc(sizeof(struct trieNode))) ) 
+			if(!(currentLP->list[addressArray[currentLevel]]=NewTrieNode()) ) 
 			{
 				fprintf(stderr,"Memory allocation failed in \'IsNewFunc()\'...");
 				return 2; /* memory allocation failed*/
 			}
-			else
-				for (i=0;i<16;i++) 
-					(currentLP->list[addressArray[currentLevel]])->list[i]=NULL;
 		}
 
 		currentLP=currentLP->list[addressArray[currentLevel]];
@@ -293,6 +537,7 @@ int IsNewFunc(ADDRINT fadd)
 	return 0; /* function address exists in the list */
 }
 //------------------------------------------------------------------------------------------
+// the ranges of the blocks in UnMAs, every block covers Granularity bytes
 void set2ranges(set<ADDRINT>* UnMAs, vector<Range> & ranges)
 {
 	ADDRINT curr, next; 
@@ -303,192 +548,456 @@ void set2ranges(set<ADDRINT>* UnMAs, vector<Range> & ranges)
 		curr= *pos;
 		next= *(++pos);
 		//cout<<curr<<'-';
-		r.lower = curr;
+		r.lower = curr << Granularity_Shift;
 		while( (next == curr + 1 ) && (pos != UnMAs->end() )  )
 		{
 			curr=*pos;
 			next= *(++pos);
 		}
 		//cout<<curr<<endl;
-		r.upper = curr;
+		r.upper = (curr << Granularity_Shift) + Granularity - 1;
 		
 		ranges.push_back(r);
 	}  
 }
 
-void recTrieTraverse(struct trieNode* current,int level)
+//------------------------------------------------------------------------------------------
+// The reports are generated in two phases. The parallel phase formats the DOT edge and 
+// prepares the XML channel of every binding, the bindings are distributed over a pool of 
+// report threads which steal work from each other. The serial phase emits the prepared 
+// fragments in the order of the binding trie, so the reports do not depend on the scheduling.
+//------------------------------------------------------------------------------------------
+typedef struct
 {
-    int i;
-	vector<Range> ranges;
+	Binding *binding;
+	string prodName;
+	string consName;
+	bool producer_in_ML;
+	bool consumer_in_ML;
+	int consCount;		// number of calls of the consumer, only with '-bb_func_count 1'
+	string edge;		// the DOT edge, formatted in the parallel phase
+	Channel *channel;	// the XML channel, created in the parallel phase
+}
+ReportItem;
+
+vector<ReportItem> Report_Items;
+BOOL Report_Prepared=FALSE;
+
+// a range [head,tail) of report items, the owner takes from the head and the thieves from the tail
+typedef struct
+{
+	PIN_LOCK lock;
+	unsigned int head;
+	unsigned int tail;
+}
+ReportQueue;
+
+#define MAX_REPORT_THREADS 64
+
+ReportQueue Report_Queues[MAX_REPORT_THREADS+1]; // the last queue belongs to the thread which started the report
+unsigned int Num_Report_Threads=0;
+volatile BOOL Report_Pool_Go=FALSE;
+volatile BOOL Report_Pool_Exit=FALSE;
+volatile unsigned int Report_Pool_Done=0;
+unsigned int Report_Pool_Round=0;
+PIN_LOCK Report_Pool_Lock;	// protects Report_Pool_Done
+
+void appendf(string &str, const char *format, ...)
+{
+	char buffer[512];
+	va_list args;
+	
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	str += buffer;
+}
+
+// collects the bindings in trie order, everything which needs the (not thread safe) global 
+// maps is looked up here
+void CollectReportItems(struct trieNode* current,int level)
+{
+	int i;
 	
 	if (level==15)
-	{   
+	{
 		Binding *temp;
 		bool producer_in_ML=false,consumer_in_ML=false;
 		for (i=0; i<16; i++)
 		{
-		   temp= current->bindings[i];
-		   if (temp) 
-		   {
-				string prodName,consName;
-				int color;
-				prodName = ADDtoName[temp->producer];
-				consName = ADDtoName[temp->consumer];
+			temp= current->bindings[i];
+			if (!temp) 
+				continue;
 			
-				// If monitor list is specified, lets see we like the current functions' names or not!!
-				// if we do not like the names skip to the next binding!
-				if (Monitor_ON)
-				{
-					producer_in_ML = ( ML_OUTPUT.find(prodName) != ML_OUTPUT.end() );
-					consumer_in_ML = ( ML_OUTPUT.find(consName) != ML_OUTPUT.end() );
-					if( ! (producer_in_ML || consumer_in_ML) ) 
-						break;
-				}	
-				
-				if(IsNewFunc( temp->producer ) ) 
-				{
-					fprintf(gfp,"\"%08x\" [label=\"%s", (unsigned int)temp->producer, prodName.c_str());
-					if(KnobBBFuncCount.Value()==TRUE) { 
-						fprintf(gfp," count:%d", FunctionToCount[NameToFunction[prodName]]);
-					}
-					fprintf(gfp,"\"];\n");
-				}
+			ReportItem item;
+			item.binding=temp;
+			item.prodName = ADDtoName[temp->producer];
+			item.consName = ADDtoName[temp->consumer];
+			
+			// If monitor list is specified, lets see we like the current functions' names or not!!
+			// if we do not like the names skip to the next binding!
+			if (Monitor_ON)
+			{
+				producer_in_ML = ( ML_OUTPUT.find(item.prodName) != ML_OUTPUT.end() );
+				consumer_in_ML = ( ML_OUTPUT.find(item.consName) != ML_OUTPUT.end() );
+				if( ! (producer_in_ML || consumer_in_ML) ) 
+					break;
+			}
+			item.producer_in_ML=producer_in_ML;
+			item.consumer_in_ML=consumer_in_ML;
+			item.consCount = (BB_Func_Count==TRUE) ? FunctionToCount[NameToFunction[item.consName]] : 0;
+			item.channel=NULL;
+			
+			Report_Items.push_back(item);
+		}
+		return;
+	}
+	
+	for (i=0;i<16;i++)
+		if (current->list[i]) 
+			CollectReportItems(current->list[i],level+1);
+}
 
-				if(IsNewFunc( temp->consumer ) ) 
-				{
-					fprintf(gfp,"\"%08x\" [label=\"%s", (unsigned int)temp->consumer, consName.c_str());
-					if(KnobBBFuncCount.Value()==TRUE) { 
-						fprintf(gfp," count:%d", FunctionToCount[NameToFunction[consName]]);
-					}
-					fprintf(gfp,"\"];\n");
-				}
+// formats the DOT edge and creates the XML channel of a binding, only reads shared data
+void PrepareReportItem(ReportItem &item)
+{
+	Binding *temp=item.binding;
+	vector<Range> ranges;
+	string &edge=item.edge;
+	BindingEstimate est;
+	int color;
+	
+	color = (int) (  1023 *  log((double)(temp->UniqueValues)) / log((double)MaxLabel)  ); 
+	
+	EstimateBinding(temp, est);
+	unsigned long int unma = est.unma;
+	float unmaPerCall = 0;
+	if(BB_Func_Count==TRUE && item.consCount>0) 
+	{
+		unmaPerCall = ((float)unma/item.consCount);
+	}
+	
+	appendf(edge,"\"%08x\" -> \"%08x\"  [label=",(unsigned int)temp->producer,(unsigned int)temp->consumer);
+	if(Dot_Show_Bytes==TRUE && est.bytesHigh!=est.bytesLow) 
+	{
+		appendf(edge,"\"~%llu Bytes (%llu-%llu)\\n",est.bytes,est.bytesLow,est.bytesHigh);
+	}
+	else if(Dot_Show_Bytes==TRUE) 
+	{
+		appendf(edge,"\"%llu Bytes\\n",temp->data_exchange);
+	}
+	if (est.unmaHigh==0)
+	{
+		appendf(edge,">=%lu UnMAs \\n",unma);
+	}
+	else if (est.unmaHigh!=est.unmaLow)
+	{
+		appendf(edge,"~%lu UnMAs (%llu-%llu) \\n",unma,est.unmaLow,est.unmaHigh);
+	}
+	else
+	{
+		appendf(edge,"%lu UnMAs \\n",unma);
+	}
+	if(BB_Func_Count==TRUE && item.consCount>0) 
+	{
+		appendf(edge,"%8.3f UnMAs/call\\n",unmaPerCall);
+	}
 
-				color = (int) (  1023 *  log((double)(temp->UniqueValues)) / log((double)MaxLabel)  ); 
-				//fprintf(gfp,"\"%08x\" -> \"%08x\"  [label=\"%llu Bytes (%lu UnMAs %llu UnDVs)\" color=\"#%02x%02x%02x\"]\n",(unsigned int)temp->producer,(unsigned int)temp->consumer,temp->data_exchange,(unsigned long int)temp->UniqueMemCells->size(),temp->UniqueValues, max(0,color-768),min(255,512-abs(color-512)), max(0,min(255,512-color)));
-				
-				unsigned long int unma = temp->UniqueMemCells->size();
-				float unmaPerCall = 0;
-				if(KnobBBFuncCount.Value()==TRUE && 
-				  FunctionToCount[NameToFunction[consName]]>0) 
-				{
-					unmaPerCall = ((float)unma/FunctionToCount[NameToFunction[consName]]);
-				}
-				
-				fprintf(gfp,"\"%08x\" -> \"%08x\"  [label=",(unsigned int)temp->producer,(unsigned int)temp->consumer);
-				if(KnobDotShowBytes.Value()==TRUE) 
-				{
-					fprintf(gfp,"\"%llu Bytes\\n",temp->data_exchange);
-				}
-				fprintf(gfp,"%lu UnMAs \\n",unma);
-				if(KnobBBFuncCount.Value()==TRUE && 
-				  FunctionToCount[NameToFunction[consName]]>0) 
-				{
-					fprintf(gfp,"%8.3f UnMAs/call\\n",unmaPerCall);
-				}
+	if(Dot_Show_UnDVs==TRUE && est.undvHigh==0) 
+	{
+		appendf(edge,">=%llu UnDVs\\n",est.undv);
+	}
+	else if(Dot_Show_UnDVs==TRUE && est.undvHigh!=est.undvLow) 
+	{
+		appendf(edge,"~%llu UnDVs (%llu-%llu)\\n",est.undv,est.undvLow,est.undvHigh);
+	}
+	else if(Dot_Show_UnDVs==TRUE) 
+	{
+		appendf(edge,"%llu UnDVs\\n",est.undv);
+	}
 
-				if(KnobDotShowUnDVs.Value()==TRUE) 
+	if (Show_Variables) {
+		std::list<pair<string, unsigned long long> >::iterator varit;
+		std::list<pair<string, unsigned long long> > variables(temp->variable_exchange->begin(), temp->variable_exchange->end());
+		variables.sort(&paircmp);
+		unsigned int varcnt = 0;
+		for (varit = variables.begin(); varcnt < Variable_Count && varit != variables.end(); varcnt++, varit++) {
+			edge += varit->first;
+			appendf(edge," (%llu)\\n", varit->second);
+		}
+		if (varit != variables.end()) {
+			edge += "and other...\\n";
+		}
+	}
+	
+	// the addresses of the sampled accesses are only a part of the ranges, they are left out like with the sketches
+	if (Sample_Accesses<=1)
+		set2ranges(temp->UniqueMemCells, ranges);
+	item.channel = new Channel(item.prodName,item.consName,ranges,unma,est.bytes,est.undv);
+	if (Sample_Pages>1 || Sample_Accesses>1 || temp->UnMASketch)
+		item.channel->setBounds(est.unmaLow,est.unmaHigh,est.bytesLow,est.bytesHigh,est.undvLow,est.undvHigh);
+
+	if(Dot_Show_Ranges==TRUE) 
+	{
+		vector<Range>::iterator it = ranges.begin();
+		int crt=0;
+		while(it!=ranges.end()) 
+		{
+			appendf(edge,"(%8x-%8x)",(*it).lower,(*it).upper);
+#ifdef QUAD_LIBELF
+			map<string,GlobalSymbol*>::const_iterator its = globalSymbols.begin();
+			while(its!=globalSymbols.end()) 
+			{
+				if(its->second->start<=it->lower &&
+				  its->second->start+its->second->size>=it->upper) 
 				{
-					fprintf(gfp,"%llu UnDVs\\n",temp->UniqueValues);
+					edge += " from " + its->first;
+					appendf(edge," (%2.1f%%)",
+					  its->second->size!=0?((it->upper-it->lower+1)/(float)its->second->size)*100:100);
+					break;
 				}
+				its++;
+			}
+#endif
+			edge += "\\n";
+			it++;
+			crt++;
+			if(Dot_Show_Ranges_Limit<crt+1) 
+			{
+				break;
+			}
+		}
+		
+		if(it!=ranges.end()) 
+		{
+			edge += " and other...\\n";
+		}
+	}
 
-				if (KnobElf.Value()) {
-					std::list<pair<string, unsigned long long> >::iterator varit;
-					std::list<pair<string, unsigned long long> > variables(temp->variable_exchange->begin(), temp->variable_exchange->end());
-					variables.sort(&paircmp);
-					unsigned int varcnt = 0;
-					for (varit = variables.begin(); varcnt < KnobVariableCount.Value() && varit != variables.end(); varcnt++, varit++) {
-						fprintf(gfp,"%s (%llu)\\n", varit->first.c_str(), varit->second);
-					}
-					if (varit != variables.end()) {
-						fprintf(gfp, "and other...\\n");
-					}
-				}
-				
-				//Put_Binding_in_XML_file(prodName,consName,temp->data_exchange,temp->UniqueMemCells->size());
-// 				q2xml->insertChannel(new Channel(prodName,consName,temp->UniqueMemCells->size(),temp->data_exchange,temp->UniqueValues));
-				set2ranges(temp->UniqueMemCells, ranges);
-				q2xml->insertChannel(new Channel(prodName,consName,ranges,temp->UniqueMemCells->size(),temp->data_exchange,temp->UniqueValues));
+	appendf(edge,"\" color=\"#%02x%02x%02x\"]\n", max(0,color-768),min(255,512-abs(color-512)), max(0,min(255,512-color)));
+}
 
-				if(KnobDotShowRanges.Value()==TRUE) 
-				{
-					vector<Range>::iterator it = ranges.begin();
-					int crt=0;
-					while(it!=ranges.end()) 
-					{
-						fprintf(gfp,"(%8x-%8x)",(*it).lower,(*it).upper);
-#ifdef QUAD_LIBELF
-						map<string,GlobalSymbol*>::iterator its = globalSymbols.begin();
-						while(its!=globalSymbols.end()) 
-						{
-							if(its->second->start<=it->lower &&
-							  its->second->start+its->second->size>=it->upper) 
-							{
-								fprintf(gfp," from %s (%2.1f%%)",its->first.c_str(),
-								  its->second->size!=0?((it->upper-it->lower+1)/(float)its->second->size)*100:100);
-								break;
-							}
-							its++;
-						}
-#endif
-						fprintf(gfp,"\\n");
-						it++;
-						crt++;
-						if(KnobDotShowRangesLimit.Value()<crt+1) 
-						{
-							break;
-						}
-					}
-					
-					if(it!=ranges.end()) 
-					{
-						fprintf(gfp," and other...\\n");
-					}
-				}
+// takes the next item of queue 'q', from the head for its owner and from the tail for a thief
+BOOL TakeReportItem(ReportQueue *q, BOOL steal, unsigned int *index)
+{
+	BOOL found=FALSE;
+	
+	PIN_GetLock(&q->lock, 1);
+	if (q->head < q->tail)
+	{
+		*index = steal ? --q->tail : q->head++;
+		found=TRUE;
+	}
+	PIN_ReleaseLock(&q->lock);
+	return found;
+}
 
-				fprintf(gfp,"\" color=\"#%02x%02x%02x\"]\n", max(0,color-768),min(255,512-abs(color-512)), max(0,min(255,512-color)));
-
-				// do we need the total statistics file always or not? ... should be modified if we need this in any case... 
-				// do not forget to make also the relevant modifications in the monitor list input file processing ... 
-				// this can also be moved up in the previous condition if we need output file only when monitor list is specified!			
-				if (Monitor_ON)  
-					Update_total_statistics(
-						prodName,
-						consName,
-						temp->data_exchange,
-						temp->UniqueMemCells->size(),
-						producer_in_ML,
-						consumer_in_ML);
-		   } // end of this item in the last level of the trie has a binding we need to check!   
-		} // end of for which goes thru all the items in the last level of the trie...
-	 return;
-	} // end of if ...(we reached the last level of the trie, time to check binding items!)
-  
-	for (i=0;i<16;i++)   // we have not reached the last level of trie, we are in the middle somewhere! DO spawn further searches deep in the trie, covering everywhere!
-		if (current->list[i]) 
-			recTrieTraverse(current->list[i],level+1);
+// prepares the items of queue 'self', then helps the others until all the queues are empty
+VOID RunReportQueue(unsigned int self, unsigned int queues)
+{
+	unsigned int index = 0, victim;
+	
+	while (TRUE)
+	{
+		if (TakeReportItem(&Report_Queues[self], FALSE, &index))
+		{
+			PrepareReportItem(Report_Items[index]);
+			continue;
+		}
+		
+		for (victim=1; victim<queues; victim++)
+			if (TakeReportItem(&Report_Queues[(self+victim)%queues], TRUE, &index))
+				break;
+		
+		if (victim==queues)
+			return; /* no work left anywhere */
+		PrepareReportItem(Report_Items[index]);
+	}
+}
 
-  return;
+// the report threads are started with the application and wait until the report is prepared
+VOID ReportThread(VOID *arg)
+{
+	unsigned int self=(unsigned int)(ADDRINT)arg;
+	unsigned int round=0;
+	
+	while (!Report_Pool_Exit)
+	{
+		if (Report_Pool_Go && round!=Report_Pool_Round)
+		{
+			round=Report_Pool_Round;
+			RunReportQueue(self, Num_Report_Threads+1);
+			PIN_GetLock(&Report_Pool_Lock, 1);
+			Report_Pool_Done++;
+			PIN_ReleaseLock(&Report_Pool_Lock);
+		}
+		else
+			PIN_Sleep(10);
+	}
 }
+
+int InitReportThreads(unsigned int threads)
+{
+	PIN_THREAD_UID uid;
+	
+	PIN_InitLock(&Report_Pool_Lock);
+	for (unsigned int t=0; t<MAX_REPORT_THREADS+1; t++)
+		PIN_InitLock(&Report_Queues[t].lock);
+	
+	Num_Report_Threads=0;
+	for (unsigned int t=0; t<threads && t<MAX_REPORT_THREADS; t++)
+	{
+		if (PIN_SpawnInternalThread(ReportThread, (VOID*)(ADDRINT)t, DEFAULT_THREAD_STACK_SIZE, &uid) == INVALID_THREADID)
+		{
+			fprintf(stderr,"Can not spawn report thread %u...\n", t);
+			break;
+		}
+		Num_Report_Threads++;
+	}
+	return 0;
+}
+
+VOID StopReportThreads()
+{
+	Report_Pool_Exit=TRUE;
+}
+
+// runs the parallel phase of the report generation with the report threads and the calling thread
+VOID PrepareReportItems()
+{
+	unsigned int queues=Num_Report_Threads+1;
+	unsigned int items=Report_Items.size();
+	
+	for (unsigned int q=0; q<queues; q++)
+	{
+		Report_Queues[q].head=(unsigned int)((unsigned long long)items*q/queues);
+		Report_Queues[q].tail=(unsigned int)((unsigned long long)items*(q+1)/queues);
+	}
+	
+	if (Num_Report_Threads>0 && !Report_Pool_Exit)
+	{
+		Report_Pool_Done=0;
+		Report_Pool_Round++;
+		Report_Pool_Go=TRUE;
+	}
+	
+	RunReportQueue(Num_Report_Threads, queues);
+	
+	if (Report_Pool_Go)
+	{
+		while (Report_Pool_Done<Num_Report_Threads)
+			PIN_Sleep(1);
+		Report_Pool_Go=FALSE;
+	}
+}
+
+// finishes the analysis and runs the parallel phase of the reports, it has to be called while 
+// the internal threads are still running (i.e. before the Fini callbacks)
+int PrepareReport()
+{
+	if (Report_Prepared)
+		return 0;
+	Report_Prepared=TRUE;
+	
+	StopShards();
+	if (MergeShards())
+	{
+		cerr << "Memory allocation failed while merging the shards..." << endl;
+		return 1;
+	}
+	
+	cerr << "\npreparing the QDU graph with " << Num_Report_Threads << " report threads..." << endl;
+	if(Shards[0].graphRoot)
+		CollectReportItems(Shards[0].graphRoot,0);
+	PrepareReportItems();
+	return 0;
+}
+
 //------------------------------------------------------------------------------------------
 int CreateDSGraphFile()
 {
-   int i;
+   unsigned int i;
 
-   if (!(gfp=fopen("QDUGraph.dot","wt")) ) return 1; /*can't create the output file */
+   PrepareReport(); /* in case it has not been done before the Fini callbacks */
+   
+   if (!(gfp=fopen(suffixFileName("QDUGraph.dot", Output_Suffix).c_str(),"wt")) ) return 1; /*can't create the output file */
    
-   if(!(uflist=(struct trieNode*)malloc(sizeof(struct trieNode)) ) ) return 2; /* memory allocation failed*/
-   else
-        for (i=0;i<16;i++) 
-			uflist->list[i]=NULL;
+   if(!(uflist=NewTrieNode()) ) return 2; /* memory allocation failed*/
 
    cerr << "\nwriting QDU graph preamble..." << endl;
 
    /* write prologue */
    fprintf(gfp,"digraph {\ngraph [];\nnode [fontcolor=black, style=filled, fontsize=20];\nedge [fontsize=14, arrowhead=vee, arrowsize=0.5];\n");
+   unsigned int factor=Sample_Pages>1 ? Sample_Pages : Sample_Accesses;
+   const char *sampling=Sample_Pages>1 ? "pages" : "accesses";
+   q2xml->setGranularity(Granularity);
+   q2xml->setSampling(sampling, factor);
+   q2xml->setUnMASketch(UnMA_Sketch_Bits);
+   q2xml->setNotes(Report_Notes);
+   for (vector<string>::const_iterator note=Report_Notes.begin(); note!=Report_Notes.end(); note++)
+	   fprintf(gfp,"// %s\n",note->c_str());
+   if (Granularity>1)
+	   fprintf(gfp,"// QUAD tracked the memory in blocks of %u bytes, UnMA and UnDV count every block for all its bytes\n",Granularity);
+   if (UnMA_Sketch_Bits)
+	   fprintf(gfp,"// UnMA is estimated with HyperLogLog sketches of %u registers (%.1f%% standard error), without address ranges\n",
+		   1U<<UnMA_Sketch_Bits,104.0/sqrt((double)(1U<<UnMA_Sketch_Bits)));
+   if (factor>1)
+	   fprintf(gfp,"// QUAD sampled 1 of every %u %s, Bytes, UnMA and UnDV are estimates with their 95%% confidence bounds\n",factor,sampling);
+   if (Unique_Cells_Dropped)
+   {
+	   cerr << "QUAD reached its memory limit, the UnMA counts are lower bounds..." << endl;
+	   fprintf(gfp,"// QUAD reached its memory limit, the UnMA counts are lower bounds\n");
+   }
+   if (Analysis_Stopped)
+   {
+	   cerr << "QUAD reached its memory limit, the profile only holds the accesses before that..." << endl;
+	   fprintf(gfp,"// QUAD reached its memory limit, the profile only holds the accesses before that\n");
+   }
 
    cerr << "writing QDU graph..." << endl; 
-   if(graphRoot)
-		recTrieTraverse(graphRoot,0);
+   GetThreadProfile(PIN_ThreadId())->counters[SP_REPORT_ITEMS]+=Report_Items.size();
+   for (i=0; i<Report_Items.size(); i++)
+   {
+		ReportItem &item=Report_Items[i];
+		Binding *temp=item.binding;
+		
+		if(IsNewFunc( temp->producer ) ) 
+		{
+			fprintf(gfp,"\"%08x\" [label=\"%s", (unsigned int)temp->producer, item.prodName.c_str());
+			if(BB_Func_Count==TRUE) { 
+				fprintf(gfp," count:%d", FunctionToCount[NameToFunction[item.prodName]]);
+			}
+			fprintf(gfp,"\"];\n");
+		}
+
+		if(IsNewFunc( temp->consumer ) ) 
+		{
+			fprintf(gfp,"\"%08x\" [label=\"%s", (unsigned int)temp->consumer, item.consName.c_str());
+			if(BB_Func_Count==TRUE) { 
+				fprintf(gfp," count:%d", FunctionToCount[NameToFunction[item.consName]]);
+			}
+			fprintf(gfp,"\"];\n");
+		}
+		
+		fputs(item.edge.c_str(), gfp);
+		
+		q2xml->insertChannel(item.channel);
+
+		// do we need the total statistics file always or not? ... should be modified if we need this in any case... 
+		// do not forget to make also the relevant modifications in the monitor list input file processing ... 
+		// this can also be moved up in the previous condition if we need output file only when monitor list is specified!			
+		if (Monitor_ON)  
+			Update_total_statistics(
+				item.prodName,
+				item.consName,
+				item.channel->getBytes(),
+				item.channel->getUnMA(),
+				item.producer_in_ML,
+				item.consumer_in_ML);
+		delete item.channel;
+		item.channel=NULL;
+   }
+   Report_Items.clear();
 
    /* write epilogue */
    cerr << "writing QDU graph epilogue..." << endl; 
@@ -512,16 +1021,93 @@ int CreateDSGraphFile()
 }
 
 //------------------------------------------------------------------------------------------
-int RecordCommunicationInDSGraph(ADDRINT producer, ADDRINT consumer, ADDRINT locAddr, const class VariableSymbol *writtenSymbol, const class VariableSymbol *readSymbol, struct trieNode * currentLPold)
+void FreeBindingTrie(struct trieNode* current,int level)
+{
+	int i;
+	
+	for (i=0;i<16;i++)
+	{
+		if (!current->list[i]) 
+			continue;
+		
+		if (level==15)
+		{
+			delete current->bindings[i]->UniqueMemCells;
+			delete current->bindings[i]->UnMASketch;
+			delete current->bindings[i]->variable_exchange;
+			free(current->bindings[i]);
+		}
+		else
+			FreeBindingTrie(current->list[i],level+1);
+	}
+	free(current);
+}
+
+// forget all the bindings recorded so far (e.g. in a freshly forked child), the shadow memory 
+// with the last writers is kept as the child inherits the memory contents of its parent
+void ResetBindings()
+{
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		if (Shards[s].graphRoot)
+		{
+			FreeBindingTrie(Shards[s].graphRoot,0);
+			Shards[s].graphRoot=NULL;
+		}
+		Shards[s].MaxLabel=0;
+		Shards[s].bindingBytes=Shards[s].unmaBytes=Shards[s].bindings=0;
+		Shards[s].checkedBytes=Shards[s].shadowBytes;
+	}
+	MaxLabel=0;
+}
+
+//------------------------------------------------------------------------------------------
+// returns the function responsible for the last write to locAddr, 0 if nobody wrote it so far.
+// With shard workers this is a snapshot, the worker may not have processed the latest accesses yet.
+ADDRINT LookupLastWrite(ADDRINT locAddr)
+{
+	int currentLevel=0;
+	struct trieNode* currentLP=ShardOf(locAddr)->trieRoot;
+	ADDRINT block=locAddr>>Granularity_Shift;
+	
+	unsigned int addressArray[8];
+	struct AddressSplitter* ASP= (struct AddressSplitter *)&block;
+	addressArray[0]=ASP->h0;
+	addressArray[1]=ASP->h1;
+	addressArray[2]=ASP->h2;
+	addressArray[3]=ASP->h3;
+	addressArray[4]=ASP->h4;
+	addressArray[5]=ASP->h5;
+	addressArray[6]=ASP->h6;
+	addressArray[7]=ASP->h7;
+	
+	while(currentLP && currentLevel<7)
+	{
+		currentLP=currentLP->list[addressArray[currentLevel]];
+		currentLevel++;
+	}
+	
+	if (!currentLP || !currentLP->leafs[addressArray[currentLevel]])
+		return 0;
+	
+	return currentLP->leafs[addressArray[currentLevel]]->lastWrite;
+}
+
+//------------------------------------------------------------------------------------------
+// returns the binding between producer and consumer in the graph trie of 'shard', a new (empty) 
+// binding is created if it does not exist yet. NULL is returned if the memory is exhausted.
+Binding* FindOrCreateBinding(Shard *shard, ADDRINT producer, ADDRINT consumer)
 {
 	int currentLevel=0;
 	Binding* tempptr;
-	int i;
 	struct trieNode* currentLP;
+	struct trieNode* newLP;
 	unsigned int addressArray[16];
 
 	struct AddressSplitter* ASP;
 	
+	shard->profile->counters[SP_BINDING_LOOKUPS]++;
+	
 	ASP= (struct AddressSplitter *)&producer;
 	addressArray[0]=ASP->h0;
 	addressArray[1]=ASP->h1;
@@ -542,26 +1128,22 @@ int RecordCommunicationInDSGraph(ADDRINT producer, ADDRINT consumer, ADDRINT loc
 	addressArray[14]=ASP->h6;
 	addressArray[15]=ASP->h7;
 
-	if(!graphRoot)  /* create the first level in graph trie */
+	if(!shard->graphRoot)  /* create the first level in graph trie */
 	{
-		if(!(graphRoot=(struct trieNode*)malloc(sizeof(struct trieNode)) ) ) 
-			return 1; /* memory allocation failed*/
-		else
-			for (i=0;i<16;i++) 
-				graphRoot->list[i]=NULL;
+		if(!(shard->graphRoot=NewTrieNode()) ) 
+			return NULL; /* memory allocation failed*/
+		shard->bindingBytes+=sizeof(struct trieNode);
 	}                         
 			
-	currentLP=graphRoot;                
+	currentLP=shard->graphRoot;                
 	while(currentLevel<15)  /* proceed to the last level */
 	{
 		if(! (currentLP->list[addressArray[currentLevel]]) ) /* create new level on demand */
 		{
-				if(!(currentLP->list[addressArray[currentLevel]]=(struct trieNode*)malloc(sizeof(struct trieNode))) ) return 1; /* memory allocation failed*/
-				else
-				{
-					for (i=0;i<16;i++) 
-						(currentLP->list[addressArray[currentLevel]])->list[i]=NULL;
-				}
+			if(!(newLP=NewTrieNode()) ) 
+				return NULL; /* memory allocation failed*/
+			currentLP->list[addressArray[currentLevel]]=newLP;
+			shard->bindingBytes+=sizeof(struct trieNode);
 		}
 		currentLP=currentLP->list[addressArray[currentLevel]];
 		currentLevel++;
@@ -570,24 +1152,46 @@ int RecordCommunicationInDSGraph(ADDRINT producer, ADDRINT consumer, ADDRINT loc
 	/* create new bucket to store number of accesses between the two functions*/
 	if( currentLP->bindings[addressArray[currentLevel]] == NULL ) 
 	{
-		if(!(  currentLP->bindings[addressArray[currentLevel]] = (Binding *) malloc(sizeof(Binding)) ) ) 
-			return 1; /* memory allocation failed*/
-		else 
+		if(!(  tempptr = (Binding *) malloc(sizeof(Binding)) ) ) 
+			return NULL; /* memory allocation failed*/
+		
+		tempptr->data_exchange=0;  /* set number of times to zero */
+		tempptr->reads=0;
+		tempptr->UniqueValues=0;
+		tempptr->producer=producer;
+		tempptr->consumer=consumer;
+		tempptr->UniqueMemCells=new set<ADDRINT>;
+		tempptr->UnMASketch=NULL;
+		if (UnMA_Sketch_Bits)
 		{
-			tempptr= currentLP->bindings[addressArray[currentLevel]];
-			tempptr->data_exchange=0;  /* set number of times to zero */
-			tempptr->UniqueValues=0;
-			tempptr->producer=producer;
-			tempptr->consumer=consumer;
-			tempptr->UniqueMemCells=new set<ADDRINT>;
-			tempptr->variable_exchange = new map<string, unsigned long long>;
-			if (!tempptr->UniqueMemCells || !tempptr->variable_exchange) 
-				return 1; /* memory allocation failed*/
-		}	
+			tempptr->UnMASketch=new HyperLogLog(UnMA_Sketch_Bits);
+			shard->unmaBytes+=HyperLogLog::bytes(UnMA_Sketch_Bits);
+		}
+		tempptr->variable_exchange = new map<string, unsigned long long>;
+		if (!tempptr->UniqueMemCells || !tempptr->variable_exchange) 
+			return NULL; /* memory allocation failed*/
+		
+		currentLP->bindings[addressArray[currentLevel]]=tempptr;
+		shard->bindingBytes+=sizeof(Binding)+sizeof(set<ADDRINT>)+sizeof(map<string, unsigned long long>);
+		shard->bindings++;
+		shard->profile->counters[SP_BINDINGS]++;
 	}
 
-	tempptr= currentLP->bindings[addressArray[currentLevel]];
-	tempptr->data_exchange=tempptr->data_exchange+1;
+	return currentLP->bindings[addressArray[currentLevel]];
+}
+
+//------------------------------------------------------------------------------------------
+int RecordCommunicationInDSGraph(Shard *shard, ADDRINT producer, ADDRINT consumer, ADDRINT block, UINT32 bytes, const class VariableSymbol *writtenSymbol, const class VariableSymbol *readSymbol, struct trieNode * currentLPold)
+{
+	Binding* tempptr;
+	UINT64 start=SelfTimerStart();
+
+	if (!(tempptr=FindOrCreateBinding(shard, producer, consumer)))
+		return 1; /* memory allocation failed*/
+
+	tempptr->data_exchange=tempptr->data_exchange+bytes;
+	tempptr->reads++;
+	shard->communications++;
 	
 	string key = "unknown";
 	const VariableSymbol *varsymbol = 0;
@@ -608,7 +1212,8 @@ int RecordCommunicationInDSGraph(ADDRINT producer, ADDRINT consumer, ADDRINT loc
 	//make the status of this location as OLD by ClearFlag() for this consumer. 
 	//A true will be returned if this value is fresh and now it will be set to old
 	//A false will be returned if this value is already old (read) and is being re-read
- 	if(currentLPold->RenewalFlags->ClearFlag(consumer)) {
+	shard->profile->counters[SP_CLEARFLAG_CALLS]++;
+ 	if(currentLPold->RenewalFlags->ClearFlag(consumer, shard->profile->counters[SP_CLEARFLAG_SCANNED])) {
 		if (iterator == tempptr->variable_exchange->end()) {
 			(*tempptr->variable_exchange)[key] = 1;
 		} else {
@@ -619,23 +1224,36 @@ int RecordCommunicationInDSGraph(ADDRINT producer, ADDRINT consumer, ADDRINT loc
 	}
 
 	// only needed for graph visualization coloring!
-	if (tempptr->UniqueValues > MaxLabel) 
-		MaxLabel=tempptr->UniqueValues; 
+	if (tempptr->UniqueValues > shard->MaxLabel) 
+		shard->MaxLabel=tempptr->UniqueValues; 
 	
-	tempptr->UniqueMemCells->insert(locAddr);
+	// above the memory limit the unique addresses are not collected anymore, UnMA becomes a lower bound.
+	// The sketches do not grow, they are always updated.
+	if (tempptr->UnMASketch)
+		tempptr->UnMASketch->insert(block);
+	else if (!Unique_Cells_Dropped && tempptr->UniqueMemCells->insert(block).second)
+		shard->unmaBytes+=SET_NODE_BYTES;
 
 	//********* what to do if insertion is not successful, memory problems !!!!!!!!!!!!
+	SelfTimerStop(shard->profile, ST_BINDINGS, start);
 	return 0; /* successful recording */
 }
 //------------------------------------------------------------------------------------------
-int RecordMemoryAccess(ADDRINT locAddr, ADDRINT func, const class VariableSymbol *symbol, bool writeFlag)
+// records an access of 'bytes' bytes to the block of locAddr. With a granularity above one byte a 
+// partial access counts for the whole block: a write makes func the last writer of the block, a 
+// read consumes the block.
+int RecordShardAccess(Shard *shard, ADDRINT locAddr, UINT32 bytes, ADDRINT func, const class VariableSymbol *symbol, bool writeFlag)
 {
 	int currentLevel=0;
-	int i,retv;
+	int retv;
 	struct trieNode* currentLP; //current level pointer
+	struct trieNode* newLP;
+	struct trieLeaf* newLeaf;
+	UINT64 start=SelfTimerStart();
+	ADDRINT block=locAddr>>Granularity_Shift;
 	
 	unsigned int addressArray[8];	
-	struct AddressSplitter* ASP= (struct AddressSplitter *)&locAddr;
+	struct AddressSplitter* ASP= (struct AddressSplitter *)&block;
 	addressArray[0]=ASP->h0;
 	addressArray[1]=ASP->h1;
 	addressArray[2]=ASP->h2;
@@ -645,25 +1263,25 @@ int RecordMemoryAccess(ADDRINT locAddr, ADDRINT func, const class VariableSymbol
 	addressArray[6]=ASP->h6;
 	addressArray[7]=ASP->h7;
 
-	if(!trieRoot)  /* create the first level in trie */
+	if(!shard->trieRoot)  /* create the first level in trie */
 	{
-		if(!(trieRoot=(struct trieNode*)malloc(sizeof(struct trieNode)) ) ) 
+		if(!(shard->trieRoot=NewTrieNode()) ) 
 			return 1; /* memory allocation failed*/
-		else
-			for (i=0;i<16;i++) 
-				trieRoot->list[i]=NULL;
+		shard->shadowBytes+=sizeof(struct trieNode);
+		shard->profile->counters[SP_TRIE_NODES]++;
 	}
-	currentLP=trieRoot;
+	currentLP=shard->trieRoot;
+	shard->profile->counters[SP_SHADOW_BYTES]+=bytes;
 	
 	while(currentLevel<7)  /* proceed to the last level */
 	{
 		if(! (currentLP->list[addressArray[currentLevel]]) ) /* create new level on demand */
 		{
-			if(!(currentLP->list[addressArray[currentLevel]]=(struct trieNode*)malloc(sizeof(struct trieNode))) ) 
+			if(!(newLP=NewTrieNode()) ) 
 				return 1; /* memory allocation failed*/
-			else
-				for (i=0;i<16;i++) 
-					(currentLP->list[addressArray[currentLevel]])->list[i]=NULL;
+			currentLP->list[addressArray[currentLevel]]=newLP;
+			shard->shadowBytes+=sizeof(struct trieNode);
+			shard->profile->counters[SP_TRIE_NODES]++;
 		}
 		
 		currentLP=currentLP->list[addressArray[currentLevel]];
@@ -672,14 +1290,15 @@ int RecordMemoryAccess(ADDRINT locAddr, ADDRINT func, const class VariableSymbol
 
 	if(!currentLP->list[addressArray[currentLevel]]) /* create new bucket to store last function's access to this memory location */
 	{
-		if(!(currentLP->leafs[addressArray[currentLevel]]=(struct trieLeaf*) malloc(sizeof(struct trieLeaf)) ) ) //ADDRINT
+		if(!(newLeaf=(struct trieLeaf*) malloc(sizeof(struct trieLeaf)) ) ) //ADDRINT
 			return 1; /* memory allocation failed*/
-		else 
-		{
-			currentLP->leafs[addressArray[currentLevel]]->lastWrite = 0; /* no write access has been recorded yet!!! */
-			currentLP->leafs[addressArray[currentLevel]]->writtenSymbol = 0; /* no write access has been recorded yet!!! */
- 			currentLP->RenewalFlags = new FNodeList(); //RenewalFlags for Unique value computations
-		}
+
+		newLeaf->lastWrite = 0; /* no write access has been recorded yet!!! */
+		newLeaf->writtenSymbol = 0; /* no write access has been recorded yet!!! */
+		currentLP->RenewalFlags = new FNodeList(); //RenewalFlags for Unique value computations
+		currentLP->leafs[addressArray[currentLevel]]=newLeaf;
+		shard->shadowBytes+=sizeof(struct trieLeaf)+sizeof(FNodeList)+10*sizeof(FNode); // the initial capacity of the flags
+		shard->profile->counters[SP_SHADOW_LEAVES]++;
 	}           
 	if (writeFlag)
 	{
@@ -692,9 +1311,334 @@ int RecordMemoryAccess(ADDRINT locAddr, ADDRINT func, const class VariableSymbol
 	else 
 	{
 		/* producer , consumer , address used for making this binding! , location in the tree */
-		retv=RecordCommunicationInDSGraph(currentLP->leafs[addressArray[currentLevel]]->lastWrite, func, locAddr, currentLP->leafs[addressArray[currentLevel]]->writtenSymbol, symbol, currentLP); 
+		retv=RecordCommunicationInDSGraph(shard, currentLP->leafs[addressArray[currentLevel]]->lastWrite, func, block, bytes, currentLP->leafs[addressArray[currentLevel]]->writtenSymbol, symbol, currentLP); 
 		//DS = Data Structure Graph
 		if (retv) return 1; /* memory exhausted */
 	}
+	// the memory limit is checked from the allocations rather than only every million instructions
+	if (shard->shadowBytes+shard->bindingBytes+shard->unmaBytes >= shard->checkedBytes+MEMORY_CHECK_BYTES)
+	{
+		shard->checkedBytes=shard->shadowBytes+shard->bindingBytes+shard->unmaBytes;
+		Memory_Check_Due=TRUE;
+	}
+	SelfTimerStop(shard->profile, ST_SHADOW, start);
+	return 0; /* successful trace */
+}
+
+//------------------------------------------------------------------------------------------
+// Shard workers: the application threads append their accesses to one chunk per shard, under
+// the fill lock of the shard, so the worker replays the accesses to its stripes in the order
+// the threads made them (a write of one thread is never replayed after a later read of
+// another one). Full chunks are queued to the worker.
+//------------------------------------------------------------------------------------------
+AccessChunk* GetFreeChunk(Shard *shard)
+{
+	AccessChunk *chunk;
+	
+	PIN_GetLock(&shard->lock, 1);
+	chunk=shard->freeChunks;
+	if (chunk)
+		shard->freeChunks=chunk->next;
+	PIN_ReleaseLock(&shard->lock);
+	
+	if (!chunk)
+		chunk=new AccessChunk;
+	chunk->count=0;
+	chunk->next=NULL;
+	return chunk;
+}
+
+VOID QueueChunk(Shard *shard, AccessChunk *chunk)
+{
+	// keep the application from running too far ahead of a worker
+	while (shard->queued >= MAX_QUEUED_CHUNKS)
+		PIN_Yield();
+	
+	PIN_GetLock(&shard->lock, 1);
+	if (shard->tail)
+		shard->tail->next=chunk;
+	else
+		shard->head=chunk;
+	shard->tail=chunk;
+	shard->queued++;
+	PIN_ReleaseLock(&shard->lock);
+}
+
+AccessChunk* DequeueChunk(Shard *shard)
+{
+	AccessChunk *chunk;
+	
+	PIN_GetLock(&shard->lock, 1);
+	chunk=shard->head;
+	if (chunk)
+	{
+		shard->head=chunk->next;
+		if (!shard->head)
+			shard->tail=NULL;
+		shard->queued--;
+		shard->busy=TRUE;
+	}
+	PIN_ReleaseLock(&shard->lock);
+	return chunk;
+}
+
+VOID ReleaseChunk(Shard *shard, AccessChunk *chunk)
+{
+	PIN_GetLock(&shard->lock, 1);
+	chunk->next=shard->freeChunks;
+	shard->freeChunks=chunk;
+	shard->busy=FALSE;
+	PIN_ReleaseLock(&shard->lock);
+}
+
+VOID ProcessChunk(Shard *shard, AccessChunk *chunk)
+{
+	for (unsigned int i=0; i<chunk->count; i++)
+	{
+		AccessRecord &rec=chunk->records[i];
+		if (RecordShardAccess(shard, rec.addr, rec.bytes, rec.func, rec.symbol, rec.write))
+		{
+			fprintf(stderr,"Memory allocation failed in shard worker...\n");
+			break;
+		}
+	}
+}
+
+VOID ShardWorker(VOID *arg)
+{
+	Shard *shard=(Shard*)arg;
+	AccessChunk *chunk;
+	unsigned int idle=0;
+	
+	while (TRUE)
+	{
+		if ((chunk=DequeueChunk(shard)))
+		{
+			ProcessChunk(shard, chunk);
+			ReleaseChunk(shard, chunk);
+			idle=0;
+		}
+		else if (Shards_Stopping)
+			break;
+		else if (++idle < 64)
+			PIN_Yield();
+		else
+			PIN_Sleep(1);
+	}
+	shard->finished=TRUE;
+}
+
+VOID StartShardWorkers()
+{
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		Shards[s].finished=FALSE;
+		if (PIN_SpawnInternalThread(ShardWorker, &Shards[s], DEFAULT_THREAD_STACK_SIZE, &Shards[s].uid) == INVALID_THREADID)
+		{
+			fprintf(stderr,"Can not spawn the worker thread of shard %u, the accesses are recorded by the application threads...\n", s);
+			Shard_Workers=FALSE;
+			return;
+		}
+	}
+}
+
+// 'shards' == 0 records every access in the application thread, otherwise the address space is 
+// divided in 'shards' parts (in stripes of SHARD_STRIPE_SIZE bytes), each with its own worker thread
+int InitShards(unsigned int shards)
+{
+	Num_Shards = shards>0 ? shards : 1;
+	Shard_Workers = (shards>0);
+	Shards = new Shard[Num_Shards];
+	
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		Shards[s].trieRoot=NULL;
+		Shards[s].graphRoot=NULL;
+		Shards[s].MaxLabel=0;
+		Shards[s].shadowBytes=Shards[s].bindingBytes=Shards[s].unmaBytes=Shards[s].bindings=Shards[s].communications=0;
+		Shards[s].checkedBytes=0;
+		Shards[s].profile=GetShardProfile(s);
+		Shards[s].head=Shards[s].tail=Shards[s].freeChunks=Shards[s].filling=NULL;
+		Shards[s].queued=0;
+		Shards[s].busy=FALSE;
+		Shards[s].finished=TRUE;
+		PIN_InitLock(&Shards[s].lock);
+		PIN_InitLock(&Shards[s].fillLock);
+	}
+	
+	if (Shard_Workers)
+		StartShardWorkers();
+	return 0;
+}
+
+// hands the partially filled chunks over to the workers
+VOID FlushPendingAccesses()
+{
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		PIN_GetLock(&Shards[s].fillLock, 1);
+		if (Shards[s].filling && Shards[s].filling->count>0)
+		{
+			QueueChunk(&Shards[s], Shards[s].filling);
+			Shards[s].filling=NULL;
+		}
+		PIN_ReleaseLock(&Shards[s].fillLock);
+	}
+}
+
+// waits until the workers have processed all the accesses recorded so far ('tid' is the
+// thread asking, e.g. the one about to fork)
+VOID QuiesceShards(THREADID tid)
+{
+	if (!Shard_Workers)
+		return;
+	
+	FlushPendingAccesses();
+	
+	for (unsigned int s=0; s<Num_Shards; s++)
+		while (Shards[s].head || Shards[s].busy)
+			PIN_Sleep(1);
+}
+
+// the workers do not survive a fork, the child needs its own
+VOID RestartShardWorkers()
+{
+	if (!Shard_Workers)
+		return;
+	
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		PIN_InitLock(&Shards[s].lock);
+		PIN_InitLock(&Shards[s].fillLock);
+		Shards[s].busy=FALSE;
+	}
+	StartShardWorkers();
+}
+
+// stops the workers after they processed all the pending accesses
+VOID StopShards()
+{
+	if (!Shard_Workers)
+		return;
+	
+	FlushPendingAccesses();
+	
+	Shards_Stopping=TRUE;
+	for (unsigned int s=0; s<Num_Shards; s++)
+		while (!Shards[s].finished)
+			PIN_Sleep(1);
+	
+	// in case a worker could not be started, its queue is still waiting
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		AccessChunk *chunk;
+		while ((chunk=DequeueChunk(&Shards[s])))
+		{
+			ProcessChunk(&Shards[s], chunk);
+			ReleaseChunk(&Shards[s], chunk);
+		}
+	}
+	Shard_Workers=FALSE;
+}
+
+//------------------------------------------------------------------------------------------
+// adds all the bindings in the graph trie below 'current' to the graph trie of 'target'
+int MergeBindingTrie(Shard *target, struct trieNode* current, int level)
+{
+	int i;
+	
+	for (i=0;i<16;i++)
+	{
+		if (!current->list[i]) 
+			continue;
+		
+		if (level==15)
+		{
+			Binding *from=current->bindings[i];
+			Binding *to=FindOrCreateBinding(target, from->producer, from->consumer);
+			if (!to)
+				return 1; /* memory allocation failed*/
+			
+			to->data_exchange+=from->data_exchange;
+			to->reads+=from->reads;
+			to->UniqueValues+=from->UniqueValues;
+			if (from->UnMASketch)
+				to->UnMASketch->merge(*from->UnMASketch);
+			size_t cells=to->UniqueMemCells->size();
+			to->UniqueMemCells->insert(from->UniqueMemCells->begin(), from->UniqueMemCells->end());
+			target->unmaBytes+=(to->UniqueMemCells->size()-cells)*SET_NODE_BYTES;
+			
+			map<string, unsigned long long>::const_iterator it;
+			for (it=from->variable_exchange->begin(); it!=from->variable_exchange->end(); it++)
+				(*to->variable_exchange)[it->first]+=it->second;
+			
+			if (to->UniqueValues > target->MaxLabel)
+				target->MaxLabel=to->UniqueValues;
+		}
+		else if (MergeBindingTrie(target, current->list[i], level+1))
+			return 1;
+	}
+	return 0;
+}
+
+// merges the bindings of all the shards into the first one, which is used for the reports.
+// the shards own disjoint addresses, so the unique memory cells of a binding can simply be joined.
+int MergeShards()
+{
+	for (unsigned int s=1; s<Num_Shards; s++)
+	{
+		if (Shards[s].graphRoot)
+		{
+			if (MergeBindingTrie(&Shards[0], Shards[s].graphRoot, 0))
+				return 1;
+			FreeBindingTrie(Shards[s].graphRoot,0);
+			Shards[s].graphRoot=NULL;
+			Shards[s].bindingBytes=Shards[s].unmaBytes=Shards[s].bindings=0;
+		}
+	}
+	MaxLabel=Shards[0].MaxLabel;
+	return 0;
+}
+
+// the memory of the shadow memory and the bindings summed over the shards, a snapshot while the 
+// shard workers are running
+VOID ShardStatistics(UINT64 *shadowBytes, UINT64 *bindingBytes, UINT64 *unmaBytes, UINT64 *bindings, UINT64 *communications)
+{
+	*shadowBytes=*bindingBytes=*unmaBytes=*bindings=*communications=0;
+	for (unsigned int s=0; s<Num_Shards; s++)
+	{
+		*shadowBytes+=Shards[s].shadowBytes;
+		*bindingBytes+=Shards[s].bindingBytes;
+		*unmaBytes+=Shards[s].unmaBytes;
+		*bindings+=Shards[s].bindings;
+		*communications+=Shards[s].communications;
+	}
+}
+
+//------------------------------------------------------------------------------------------
+int RecordMemoryAccess(ADDRINT locAddr, UINT32 bytes, ADDRINT func, const class VariableSymbol *symbol, bool writeFlag)
+{
+	if (!Shard_Workers)
+		return RecordShardAccess(&Shards[0], locAddr, bytes, func, symbol, writeFlag);
+	
+	Shard *shard=ShardOf(locAddr);
+	
+	PIN_GetLock(&shard->fillLock, 1);
+	if (!shard->filling)
+		shard->filling=GetFreeChunk(shard);
+	
+	AccessRecord &rec=shard->filling->records[shard->filling->count++];
+	rec.addr=locAddr;
+	rec.bytes=bytes;
+	rec.func=func;
+	rec.symbol=symbol;
+	rec.write=writeFlag;
+	
+	if (shard->filling->count==SHARD_CHUNK_RECORDS)
+	{
+		QueueChunk(shard, shard->filling);
+		shard->filling=NULL;
+	}
+	PIN_ReleaseLock(&shard->fillLock);
 	return 0; /* successful trace */
 }